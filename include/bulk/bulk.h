@@ -0,0 +1,31 @@
+#pragma once
+#include "util/types.h"
+#include <cstddef>
+
+// Kernels for whole address spaces: clearing, page-wise comparison and
+// hashing of 64 KiB images. Each has SSE2, AVX2 and AVX-512 versions; the
+// widest one the host runs is picked by cpuid on first use. All versions
+// give the same results, so hashes can be compared across hosts.
+//
+// Sizes are multiples of 64 bytes (a page is 256).
+
+struct BulkKernels {
+    const char* name;
+    void (*clear)(void* dst, size_t n);
+    // Sets bit p of bits[] for every 256-byte page p where a and b differ;
+    // bits must hold (pages + 63) / 64 words, which are overwritten.
+    void (*diff_pages)(const u8* a, const u8* b, size_t pages, u64* bits);
+    u64 (*hash)(const void* data, size_t n, u64 seed);
+};
+
+// The version picked for this host.
+const BulkKernels& bulk();
+
+// Every version this host can run, scalar first, for benchmarks.
+const BulkKernels* bulk_variants(int* count);
+
+inline void bulk_clear(void* dst, size_t n) { bulk().clear(dst, n); }
+inline void bulk_diff_pages(const u8* a, const u8* b, size_t pages, u64* bits) {
+    bulk().diff_pages(a, b, pages, bits);
+}
+inline u64 bulk_hash(const void* data, size_t n, u64 seed = 0) { return bulk().hash(data, n, seed); }
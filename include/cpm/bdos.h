@@ -0,0 +1,60 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include <cstdio>
+#include <string>
+
+struct Bios;
+struct Recorder;
+struct Replayer;
+
+// CP/M entry points used by .COM programs
+constexpr u16 BDOS_ENTRY = 0x0005;
+constexpr u16 WARM_BOOT = 0x0000;
+
+struct Console {
+    FILE* out = stdout;             // nullptr discards program output
+    std::string* capture = nullptr; // collects output instead of out when set
+    const u8* input = nullptr;      // console input for BDOS 1/6/10/11
+    size_t input_len = 0;
+    size_t input_pos = 0;
+    Recorder* record = nullptr; // logs what the program read
+    Replayer* replay = nullptr; // input comes from the log instead
+
+    void put(char ch) {
+        if (capture)
+            *capture += ch;
+        else if (out)
+            fputc(ch, out);
+    }
+};
+
+// Console input as programs see it, going through record/replay.
+u8 console_read(Console& con, const CPU& cpu);  // 0x1A once input is used up
+bool console_ready(Console& con, const CPU& cpu);
+
+enum BdosStatus {
+    BDOS_CONTINUE,
+    BDOS_EXIT,
+};
+
+// Handles the BDOS function in C when cpu.pc == BDOS_ENTRY, then returns
+// to the caller like the RET at the real entry point would.
+BdosStatus bdos_call(CPU& cpu, Console& con);
+
+enum RunStatus {
+    RUN_EXIT,   // BDOS 0 or warm boot
+    RUN_BUDGET, // cycle budget used up
+    RUN_FAULT,  // unimplemented opcode
+    RUN_HALT,   // HLT with interrupts disabled, which nothing here can end
+};
+
+struct RunResult {
+    RunStatus status;
+    u64 instructions;
+    u64 cycles;
+};
+
+// Runs a loaded .COM program until it exits or max_cycles have elapsed.
+// With a Bios, calls to its jump table are serviced too.
+RunResult run_com(CPU& cpu, Console& con, u64 max_cycles, Bios* bios = nullptr);
@@ -0,0 +1,59 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include "cpm/disk.h"
+
+struct Console;
+
+// CP/M 2.2 BIOS serviced in C. bios_install() puts the standard jump table
+// at BIOS_BASE (every entry is trapped, so the JMPs are never executed),
+// the page-zero vectors, and a DPH/DPB per drive so a real BDOS can use it.
+
+constexpr u16 BIOS_BASE = 0xF200;
+constexpr int BIOS_DRIVES = 4;
+
+enum BiosEntry {
+    BIOS_BOOT,
+    BIOS_WBOOT,
+    BIOS_CONST,
+    BIOS_CONIN,
+    BIOS_CONOUT,
+    BIOS_LIST,
+    BIOS_PUNCH,
+    BIOS_READER,
+    BIOS_HOME,
+    BIOS_SELDSK,
+    BIOS_SETTRK,
+    BIOS_SETSEC,
+    BIOS_SETDMA,
+    BIOS_READ,
+    BIOS_WRITE,
+    BIOS_LISTST,
+    BIOS_SECTRAN,
+    BIOS_ENTRIES,
+};
+
+constexpr u16 bios_entry(BiosEntry e) {
+    return BIOS_BASE + 3 * e;
+}
+
+struct Bios {
+    DiskOverlay* drive[BIOS_DRIVES] = {};
+    u16 dph[BIOS_DRIVES] = {}; // set by bios_install
+    u8 disk = 0;
+    u16 track = 0, sector = 1, dma = 0x0080;
+
+    u64 reads = 0, writes = 0, errors = 0;
+};
+
+// Writes the jump table, page zero and disk parameter blocks into mem.
+// False if the parameter blocks do not fit below 0x10000.
+bool bios_install(Memory& mem, Bios& bios);
+
+inline bool is_bios_entry(u16 pc) {
+    return pc >= BIOS_BASE && pc < bios_entry(BIOS_ENTRIES) && (pc - BIOS_BASE) % 3 == 0;
+}
+
+// Handles the entry point at cpu.pc and returns to the caller. Returns
+// false for BOOT/WBOOT, which end the program.
+bool bios_call(CPU& cpu, Console& con, Bios& bios);
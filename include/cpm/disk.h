@@ -0,0 +1,67 @@
+#pragma once
+#include "util/types.h"
+#include <cstddef>
+#include <vector>
+
+// CP/M disk images. The image file is mapped read-only and shared by every
+// instance; each instance writes into its own copy-on-write overlay.
+
+constexpr u32 CPM_SECTOR = 128;
+
+struct DiskFormat {
+    const char* name;
+    u16 tracks;
+    u16 sectors;      // per track
+    u16 reserved;     // system tracks before the directory
+    u16 block_size;   // allocation block, bytes
+    u16 dir_entries;
+    const u8* skew;   // 1-based sector translation table, nullptr for none
+};
+
+extern const DiskFormat disk_formats[];
+extern const int disk_format_count;
+
+// Format with the given name, or the first whose size matches bytes.
+const DiskFormat* find_disk_format(const char* name, size_t bytes);
+
+inline size_t disk_bytes(const DiskFormat& f) {
+    return size_t(f.tracks) * f.sectors * CPM_SECTOR;
+}
+
+struct DiskImage {
+    const u8* base = nullptr; // mapping of the whole file
+    size_t size = 0;
+    const DiskFormat* format = nullptr;
+
+    // Maps path; fmt nullptr picks the format by file size.
+    bool open(const char* path, const char* fmt = nullptr);
+    void close();
+
+    DiskImage() = default;
+    DiskImage(const DiskImage&) = delete;
+    DiskImage& operator=(const DiskImage&) = delete;
+    ~DiskImage() { close(); }
+};
+
+// Per-instance view of a DiskImage. Sectors are read straight from the
+// mapping until their 4 KiB chunk is first written, which copies the chunk.
+struct DiskOverlay {
+    static constexpr u32 CHUNK = 4096;
+
+    const DiskImage* image = nullptr;
+    std::vector<u8*> chunks; // nullptr: chunk still shared with the image
+
+    void attach(const DiskImage& img);
+    void discard(); // drops all writes
+
+    DiskOverlay() = default;
+    DiskOverlay(const DiskOverlay&) = delete;
+    DiskOverlay& operator=(const DiskOverlay&) = delete;
+    ~DiskOverlay() { discard(); }
+
+    u32 sector_count() const { return u32(image->size / CPM_SECTOR); }
+    size_t private_bytes() const; // memory owned by this overlay
+
+    const u8* read_sector(u32 lsn) const;
+    void write_sector(u32 lsn, const u8* src);
+};
@@ -2,26 +2,62 @@
 #include "util/types.h"
 #include "memory/memory.h"
 #include "cpu/flags.h"
+#include <cstddef>
+#include <type_traits>
 
-struct CPU {
-    u8 a,b,c,d,e,h,l; //general purpose registers
-    u16 sp,pc; 
-    Flags flags;
+// Port handlers for IN/OUT; ctx is passed back unchanged.
+struct IOPorts {
+    u8 (*in)(void* ctx, u8 port);
+    void (*out)(void* ctx, u8 port, u8 value);
+    void* ctx;
+};
+
+// Register pair as a 16-bit value with byte views in host order, so pair
+// instructions (DAD, INX, LDAX, M operands) read and write it directly.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define CPU_PAIR(HT, hi, LT, lo, pair) union { struct { LT lo; HT hi; }; u16 pair; }
+#else
+#define CPU_PAIR(HT, hi, LT, lo, pair) union { struct { HT hi; LT lo; }; u16 pair; }
+#endif
+
+// The whole state fits one cache line and is trivially copyable; the
+// offsets below are fixed for code that addresses it directly (snapshots,
+// the wide engine, generated code).
+struct alignas(64) CPU {
+    CPU_PAIR(u8, b, u8, c, bc);
+    CPU_PAIR(u8, d, u8, e, de);
+    CPU_PAIR(u8, h, u8, l, hl);
+    CPU_PAIR(u8, a, Flags, flags, psw); // as PUSH PSW stores it
+    u16 sp,pc;
     bool inte;
     bool halted;
+    u64 cycles; // emulated cycles since reset
     Memory* mem;
+    IOPorts* io = nullptr; // unset: IN reads 0, OUT is ignored
 
     int step();
     void reset();
 
-    u16 BC();
-    u16 DE();
-    u16 HL();
+    // Services an interrupt by executing the given RST opcode if interrupts
+    // are enabled; returns the cycles used, 0 when it was not taken.
+    int interrupt(u8 rst);
 
-    void setBC(u16 v);
-    void setDE(u16 v);
-    void setHL(u16 v);
+    u16 BC() const { return bc; }
+    u16 DE() const { return de; }
+    u16 HL() const { return hl; }
+
+    void setBC(u16 v) { bc = v; }
+    void setDE(u16 v) { de = v; }
+    void setHL(u16 v) { hl = v; }
     u8 in(u8 port);
     void out(u8 port, u8 value);
 
-};
\ No newline at end of file
+};
+
+static_assert(sizeof(CPU) == 64, "CPU state is one cache line");
+static_assert(std::is_trivially_copyable_v<CPU>, "CPU state is copied with memcpy");
+static_assert(offsetof(CPU, bc) == 0 && offsetof(CPU, de) == 2 && offsetof(CPU, hl) == 4 &&
+                  offsetof(CPU, psw) == 6 && offsetof(CPU, sp) == 8 && offsetof(CPU, pc) == 10 &&
+                  offsetof(CPU, inte) == 12 && offsetof(CPU, halted) == 13 && offsetof(CPU, cycles) == 16 &&
+                  offsetof(CPU, mem) == 24 && offsetof(CPU, io) == 32,
+              "CPU layout is fixed");
\ No newline at end of file
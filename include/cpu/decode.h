@@ -0,0 +1,289 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/opcodes.h"
+#include <array>
+
+// Structured decoding shared by the disassembler, analysis tools and
+// alternative engines. The per-opcode part is computed at compile time from
+// opcode_table and the opcode bit patterns; decode() only adds operands.
+
+enum FlowKind : u8 {
+    FLOW_NONE,   // falls through
+    FLOW_JUMP,   // JMP adr
+    FLOW_BRANCH, // Jcc adr
+    FLOW_CALL,   // CALL adr
+    FLOW_CCALL,  // Ccc adr
+    FLOW_RET,    // RET
+    FLOW_CRET,   // Rcc
+    FLOW_RST,    // RST n
+    FLOW_PCHL,   // jump through HL, target unknown
+    FLOW_HALT,   // HLT
+};
+
+// register masks
+enum : u16 {
+    REG_B = 1 << 0,
+    REG_C = 1 << 1,
+    REG_D = 1 << 2,
+    REG_E = 1 << 3,
+    REG_H = 1 << 4,
+    REG_L = 1 << 5,
+    REG_A = 1 << 6,
+    REG_F = 1 << 7,
+    REG_SP = 1 << 8,
+    REG_PC = 1 << 9,
+    REG_INTE = 1 << 10,
+};
+
+// memory operand: address source in the low nibble, access direction bits
+enum : u8 {
+    MEM_NONE = 0,
+    MEM_HL = 1,     // M operand
+    MEM_BC = 2,     // LDAX/STAX B
+    MEM_DE = 3,     // LDAX/STAX D
+    MEM_DIRECT = 4, // adr operand (LDA/STA/LHLD/SHLD)
+    MEM_STACK = 5,  // push/pop/call/ret/xthl
+    MEM_PORT = 6,   // IN/OUT port space
+
+    MEM_READ = 0x10,
+    MEM_WRITE = 0x20,
+};
+
+struct DecodedInsn {
+    u16 addr;
+    u8 opcode;
+    u8 len;
+    u8 flow;         // FlowKind
+    u8 mem;          // MEM_* source | MEM_READ/MEM_WRITE
+    u8 cycles;       // not taken, or the only count
+    u8 cycles_taken; // conditional branch/call/return taken
+    u16 reads;       // REG_* read
+    u16 writes;      // REG_* written
+    u16 imm;         // d8/d16/adr operand
+    u16 target;      // branch/call/RST target when flow has one
+};
+
+static_assert(sizeof(DecodedInsn) == 16);
+
+constexpr bool flow_has_target(u8 f) {
+    return f == FLOW_JUMP || f == FLOW_BRANCH || f == FLOW_CALL || f == FLOW_CCALL || f == FLOW_RST;
+}
+
+namespace decode_detail {
+
+// register code (B,C,D,E,H,L,M,A) -> mask; M reads HL
+constexpr u16 reg_mask(u8 code) {
+    constexpr u16 m[8] = {REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, REG_H | REG_L, REG_A};
+    return m[code & 7];
+}
+
+// register pair (BC,DE,HL,SP) -> mask
+constexpr u16 pair_mask(u8 rp) {
+    constexpr u16 m[4] = {REG_B | REG_C, REG_D | REG_E, REG_H | REG_L, REG_SP};
+    return m[rp & 3];
+}
+
+constexpr DecodedInsn describe(u8 op) {
+    DecodedInsn d{};
+    d.opcode = op;
+    d.len = opcode_table[op].bytes;
+    d.cycles = timing_table[op].not_taken;
+    d.cycles_taken = timing_table[op].taken;
+
+    u8 x = op >> 6, y = (op >> 3) & 7, z = op & 7, rp = y >> 1;
+
+    if (op == 0x76) {
+        d.flow = FLOW_HALT;
+    } else if (x == 1) { // MOV
+        d.reads = reg_mask(z);
+        d.writes = y == 6 ? 0 : reg_mask(y);
+        if (y == 6) {
+            d.reads |= REG_H | REG_L;
+            d.mem = MEM_HL | MEM_WRITE;
+        } else if (z == 6)
+            d.mem = MEM_HL | MEM_READ;
+    } else if (x == 2) { // ALU A,r
+        d.reads = REG_A | reg_mask(z) | ((y == 1 || y == 3) ? REG_F : 0);
+        d.writes = REG_F | (y == 7 ? 0 : REG_A);
+        if (z == 6)
+            d.mem = MEM_HL | MEM_READ;
+    } else if (x == 0) {
+        switch (z) {
+        case 1:
+            if (y & 1) { // DAD
+                d.reads = REG_H | REG_L | pair_mask(rp);
+                d.writes = REG_H | REG_L | REG_F;
+            } else // LXI
+                d.writes = pair_mask(rp);
+            break;
+        case 2:
+            if (rp < 2) { // STAX/LDAX
+                d.mem = (rp == 0 ? MEM_BC : MEM_DE) | ((y & 1) ? MEM_READ : MEM_WRITE);
+                d.reads = pair_mask(rp) | ((y & 1) ? 0 : REG_A);
+                d.writes = (y & 1) ? REG_A : 0;
+            } else if (rp == 2) { // SHLD/LHLD
+                d.mem = MEM_DIRECT | ((y & 1) ? MEM_READ : MEM_WRITE);
+                d.reads = (y & 1) ? 0 : REG_H | REG_L;
+                d.writes = (y & 1) ? REG_H | REG_L : 0;
+            } else { // STA/LDA
+                d.mem = MEM_DIRECT | ((y & 1) ? MEM_READ : MEM_WRITE);
+                d.reads = (y & 1) ? 0 : REG_A;
+                d.writes = (y & 1) ? REG_A : 0;
+            }
+            break;
+        case 3: // INX/DCX
+            d.reads = d.writes = pair_mask(rp);
+            break;
+        case 4: // INR
+        case 5: // DCR
+            d.reads = reg_mask(y) | REG_F;
+            d.writes = (y == 6 ? 0 : reg_mask(y)) | REG_F;
+            if (y == 6)
+                d.mem = MEM_HL | MEM_READ | MEM_WRITE;
+            break;
+        case 6: // MVI
+            d.reads = y == 6 ? REG_H | REG_L : 0;
+            d.writes = y == 6 ? 0 : reg_mask(y);
+            if (y == 6)
+                d.mem = MEM_HL | MEM_WRITE;
+            break;
+        case 7:
+            if (y <= 4) { // RLC RRC RAL RAR DAA
+                d.reads = REG_A | REG_F;
+                d.writes = REG_A | REG_F;
+            } else if (y == 5) { // CMA
+                d.reads = d.writes = REG_A;
+            } else { // STC CMC
+                d.reads = d.writes = REG_F;
+            }
+            break;
+        }
+    } else { // x == 3
+        switch (z) {
+        case 0: // Rcc
+            d.flow = FLOW_CRET;
+            d.reads = REG_F | REG_SP;
+            d.writes = REG_SP | REG_PC;
+            d.mem = MEM_STACK | MEM_READ;
+            break;
+        case 1:
+            if (!(y & 1)) { // POP
+                d.reads = REG_SP;
+                d.writes = REG_SP | (rp == 3 ? REG_A | REG_F : pair_mask(rp));
+                d.mem = MEM_STACK | MEM_READ;
+            } else if (y == 1 || y == 3) { // RET (0xD9 is an undocumented alias)
+                d.flow = FLOW_RET;
+                d.reads = REG_SP;
+                d.writes = REG_SP | REG_PC;
+                d.mem = MEM_STACK | MEM_READ;
+            } else if (y == 5) { // PCHL
+                d.flow = FLOW_PCHL;
+                d.reads = REG_H | REG_L;
+                d.writes = REG_PC;
+            } else { // SPHL
+                d.reads = REG_H | REG_L;
+                d.writes = REG_SP;
+            }
+            break;
+        case 2: // Jcc
+            d.flow = FLOW_BRANCH;
+            d.reads = REG_F;
+            d.writes = REG_PC;
+            break;
+        case 3:
+            switch (y) {
+            case 0: // JMP
+            case 1: // 0xCB alias
+                d.flow = FLOW_JUMP;
+                d.writes = REG_PC;
+                break;
+            case 2: // OUT
+                d.reads = REG_A;
+                d.mem = MEM_PORT | MEM_WRITE;
+                break;
+            case 3: // IN
+                d.writes = REG_A;
+                d.mem = MEM_PORT | MEM_READ;
+                break;
+            case 4: // XTHL
+                d.reads = d.writes = REG_H | REG_L;
+                d.reads |= REG_SP;
+                d.mem = MEM_STACK | MEM_READ | MEM_WRITE;
+                break;
+            case 5: // XCHG
+                d.reads = d.writes = REG_D | REG_E | REG_H | REG_L;
+                break;
+            default: // DI / EI
+                d.writes = REG_INTE;
+                break;
+            }
+            break;
+        case 4: // Ccc
+            d.flow = FLOW_CCALL;
+            d.reads = REG_F | REG_SP | REG_PC;
+            d.writes = REG_SP | REG_PC;
+            d.mem = MEM_STACK | MEM_WRITE;
+            break;
+        case 5:
+            if (!(y & 1)) { // PUSH
+                d.reads = REG_SP | (rp == 3 ? REG_A | REG_F : pair_mask(rp));
+                d.writes = REG_SP;
+            } else { // CALL and its 0xDD/0xED/0xFD aliases
+                d.flow = FLOW_CALL;
+                d.reads = REG_SP | REG_PC;
+                d.writes = REG_SP | REG_PC;
+            }
+            d.mem = MEM_STACK | MEM_WRITE;
+            break;
+        case 6: // ALU A,d8
+            d.reads = REG_A | ((y == 1 || y == 3) ? REG_F : 0);
+            d.writes = REG_F | (y == 7 ? 0 : REG_A);
+            break;
+        case 7: // RST
+            d.flow = FLOW_RST;
+            d.reads = REG_SP | REG_PC;
+            d.writes = REG_SP | REG_PC;
+            d.mem = MEM_STACK | MEM_WRITE;
+            d.target = op & 0x38;
+            break;
+        }
+    }
+    return d;
+}
+
+} // namespace decode_detail
+
+// Operand-independent part of every opcode.
+inline constexpr std::array<DecodedInsn, 256> decode_table = [] {
+    std::array<DecodedInsn, 256> t{};
+    for (int op = 0; op < 256; op++)
+        t[op] = decode_detail::describe(op);
+    return t;
+}();
+
+// Decodes opcode op at pc given the two bytes that follow it.
+inline DecodedInsn decode(u8 op, u8 lo, u8 hi, u16 pc) {
+    DecodedInsn d = decode_table[op];
+    d.addr = pc;
+    if (d.len == 2)
+        d.imm = lo;
+    else if (d.len == 3)
+        d.imm = lo | (hi << 8);
+    if (d.flow != FLOW_RST && flow_has_target(d.flow))
+        d.target = d.imm;
+    return d;
+}
+
+// Decodes the instruction at pc of a 64 KiB address space.
+inline DecodedInsn decode(const u8* mem, u16 pc) {
+    return decode(mem[pc], mem[u16(pc + 1)], mem[u16(pc + 2)], pc);
+}
+
+// Linear batch decode of size bytes from start; returns the number of
+// instructions written to out (at most size).
+inline u32 decode_range(const u8* mem, u16 start, u32 size, DecodedInsn* out) {
+    u32 n = 0;
+    for (u32 off = 0; off < size; off += out[n++].len)
+        out[n] = decode(mem, u16(start + off));
+    return n;
+}
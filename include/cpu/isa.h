@@ -0,0 +1,233 @@
+#pragma once
+#include "util/types.h"
+#include <array>
+
+// The 8080 instruction set in one place. Each pattern gives the opcode
+// bits, the mnemonic, what the instruction does, its length and cycles;
+// everything per opcode is expanded from it at compile time: opcode_table
+// and timing_table (cpu/opcodes.h), the disassembler's mnemonics, the
+// decoder's lengths and timings, and the interpreter's handlers, which are
+// specialized per opcode (src/cpu/instructions.cpp).
+
+enum IsaOp : u8 {
+    ISA_NOP,
+    ISA_HLT,
+    ISA_MOV,     // MOV d,s
+    ISA_ALU,     // ADD..CMP s, operation in bits 5-3
+    ISA_ALU_IMM, // ADI..CPI d8
+    ISA_MVI,
+    ISA_INR,
+    ISA_DCR,
+    ISA_LXI,
+    ISA_INX,
+    ISA_DCX,
+    ISA_DAD,
+    ISA_STAX,
+    ISA_LDAX,
+    ISA_SHLD,
+    ISA_LHLD,
+    ISA_STA,
+    ISA_LDA,
+    ISA_RLC,
+    ISA_RRC,
+    ISA_RAL,
+    ISA_RAR,
+    ISA_DAA,
+    ISA_CMA,
+    ISA_STC,
+    ISA_CMC,
+    ISA_JMP,
+    ISA_JCC,
+    ISA_CALL,
+    ISA_CCC,
+    ISA_RET,
+    ISA_RCC,
+    ISA_RST,
+    ISA_PCHL,
+    ISA_PUSH,
+    ISA_POP,
+    ISA_XTHL,
+    ISA_XCHG,
+    ISA_SPHL,
+    ISA_IN,
+    ISA_OUT,
+    ISA_DI,
+    ISA_EI,
+};
+
+struct IsaPattern {
+    // Opcode bits from bit 7 down: 0 and 1 must match, d and s are the
+    // register fields (bits 5-3 and 2-0), p a register pair (bits 5-4),
+    // c a condition, n an RST number, a an ALU operation (bits 5-3).
+    const char* bits;
+    // {d} {s} registers, {p} pair, {q} PUSH/POP pair, {c} condition,
+    // {n} RST number, {a} ALU mnemonic, {i} ALU immediate mnemonic.
+    const char* mnemonic;
+    IsaOp op;
+    u8 bytes;
+    u8 cycles;       // or the not taken path
+    u8 cycles_taken; // conditional CALL/RET taken, 0 if one path
+    u8 cycles_m;     // when a d or s field is M, 0 if the same
+};
+
+// First match wins: special cases come before the general pattern, and
+// the undocumented aliases last.
+inline constexpr IsaPattern isa_patterns[] = {
+    {"01110110", "HLT", ISA_HLT, 1, 7, 0, 0},
+    {"01dddsss", "MOV {d},{s}", ISA_MOV, 1, 5, 0, 7},
+    {"10aaasss", "{a} {s}", ISA_ALU, 1, 4, 0, 7},
+    {"11aaa110", "{i} d8", ISA_ALU_IMM, 2, 7, 0, 0},
+    {"00ddd110", "MVI {d},d8", ISA_MVI, 2, 7, 0, 10},
+    {"00ddd100", "INR {d}", ISA_INR, 1, 5, 0, 10},
+    {"00ddd101", "DCR {d}", ISA_DCR, 1, 5, 0, 10},
+    {"00pp0001", "LXI {p},d16", ISA_LXI, 3, 10, 0, 0},
+    {"00pp0011", "INX {p}", ISA_INX, 1, 5, 0, 0},
+    {"00pp1011", "DCX {p}", ISA_DCX, 1, 5, 0, 0},
+    {"00pp1001", "DAD {p}", ISA_DAD, 1, 10, 0, 0},
+    {"00100010", "SHLD adr", ISA_SHLD, 3, 16, 0, 0},
+    {"00101010", "LHLD adr", ISA_LHLD, 3, 16, 0, 0},
+    {"00110010", "STA adr", ISA_STA, 3, 13, 0, 0},
+    {"00111010", "LDA adr", ISA_LDA, 3, 13, 0, 0},
+    {"00pp0010", "STAX {p}", ISA_STAX, 1, 7, 0, 0},
+    {"00pp1010", "LDAX {p}", ISA_LDAX, 1, 7, 0, 0},
+    {"00000111", "RLC", ISA_RLC, 1, 4, 0, 0},
+    {"00001111", "RRC", ISA_RRC, 1, 4, 0, 0},
+    {"00010111", "RAL", ISA_RAL, 1, 4, 0, 0},
+    {"00011111", "RAR", ISA_RAR, 1, 4, 0, 0},
+    {"00100111", "DAA", ISA_DAA, 1, 4, 0, 0},
+    {"00101111", "CMA", ISA_CMA, 1, 4, 0, 0},
+    {"00110111", "STC", ISA_STC, 1, 4, 0, 0},
+    {"00111111", "CMC", ISA_CMC, 1, 4, 0, 0},
+    {"11000011", "JMP adr", ISA_JMP, 3, 10, 0, 0},
+    {"11ccc010", "J{c} adr", ISA_JCC, 3, 10, 0, 0},
+    {"11001101", "CALL adr", ISA_CALL, 3, 17, 0, 0},
+    {"11ccc100", "C{c} adr", ISA_CCC, 3, 11, 17, 0},
+    {"11001001", "RET", ISA_RET, 1, 10, 0, 0},
+    {"11ccc000", "R{c}", ISA_RCC, 1, 5, 11, 0},
+    {"11nnn111", "RST {n}", ISA_RST, 1, 11, 0, 0},
+    {"11101001", "PCHL", ISA_PCHL, 1, 5, 0, 0},
+    {"11pp0101", "PUSH {q}", ISA_PUSH, 1, 11, 0, 0},
+    {"11pp0001", "POP {q}", ISA_POP, 1, 10, 0, 0},
+    {"11100011", "XTHL", ISA_XTHL, 1, 18, 0, 0},
+    {"11101011", "XCHG", ISA_XCHG, 1, 4, 0, 0},
+    {"11111001", "SPHL", ISA_SPHL, 1, 5, 0, 0},
+    {"11011011", "IN d8", ISA_IN, 2, 10, 0, 0},
+    {"11010011", "OUT d8", ISA_OUT, 2, 10, 0, 0},
+    {"11110011", "DI", ISA_DI, 1, 4, 0, 0},
+    {"11111011", "EI", ISA_EI, 1, 4, 0, 0},
+    {"00000000", "NOP", ISA_NOP, 1, 4, 0, 0},
+    // undocumented: NOP, JMP, RET and CALL at the unused encodings
+    {"00nnn000", "NOP", ISA_NOP, 1, 4, 0, 0},
+    {"11001011", "JMP adr", ISA_JMP, 3, 10, 0, 0},
+    {"11011001", "RET", ISA_RET, 1, 10, 0, 0},
+    {"11nn1101", "CALL adr", ISA_CALL, 3, 17, 0, 0},
+};
+
+inline constexpr int ISA_PATTERNS = int(sizeof(isa_patterns) / sizeof(isa_patterns[0]));
+
+// One opcode, expanded from its pattern.
+struct IsaInsn {
+    IsaOp op;
+    u8 pattern; // index in isa_patterns
+    u8 y, z;    // bits 5-3 and 2-0: registers, condition, ALU op, RST number
+    u8 rp;      // bits 5-4: register pair
+    u8 bytes;
+    u8 cycles;
+    u8 cycles_taken; // equal to cycles when there is one path
+};
+
+namespace isa_detail {
+
+constexpr bool matches(const char* bits, int op) {
+    for (int i = 0; i < 8; i++) {
+        int bit = op >> (7 - i) & 1;
+        if ((bits[i] == '0' && bit) || (bits[i] == '1' && !bit))
+            return false;
+    }
+    return true;
+}
+
+constexpr bool has_field(const char* bits, char f) {
+    for (int i = 0; i < 8; i++)
+        if (bits[i] == f)
+            return true;
+    return false;
+}
+
+constexpr IsaInsn expand(int op) {
+    for (int i = 0; i < ISA_PATTERNS; i++) {
+        const IsaPattern& p = isa_patterns[i];
+        if (!matches(p.bits, op))
+            continue;
+        IsaInsn d{};
+        d.op = p.op;
+        d.pattern = u8(i);
+        d.y = u8(op >> 3 & 7);
+        d.z = u8(op & 7);
+        d.rp = u8(op >> 4 & 3);
+        d.bytes = p.bytes;
+        bool m = (has_field(p.bits, 'd') && d.y == 6) || (has_field(p.bits, 's') && d.z == 6);
+        d.cycles = m && p.cycles_m ? p.cycles_m : p.cycles;
+        d.cycles_taken = p.cycles_taken ? p.cycles_taken : d.cycles;
+        return d;
+    }
+    throw "opcode matches no pattern"; // a compile error in constant evaluation
+}
+
+constexpr const char* field_name(char f, const IsaInsn& d) {
+    constexpr const char* regs[8] = {"B", "C", "D", "E", "H", "L", "M", "A"};
+    constexpr const char* pairs[4] = {"B", "D", "H", "SP"};
+    constexpr const char* stack_pairs[4] = {"B", "D", "H", "PSW"};
+    constexpr const char* conds[8] = {"NZ", "Z", "NC", "C", "PO", "PE", "P", "M"};
+    constexpr const char* nums[8] = {"0", "1", "2", "3", "4", "5", "6", "7"};
+    constexpr const char* alu[8] = {"ADD", "ADC", "SUB", "SBB", "ANA", "XRA", "ORA", "CMP"};
+    constexpr const char* alu_imm[8] = {"ADI", "ACI", "SUI", "SBI", "ANI", "XRI", "ORI", "CPI"};
+    switch (f) {
+    case 'd': return regs[d.y];
+    case 's': return regs[d.z];
+    case 'p': return pairs[d.rp];
+    case 'q': return stack_pairs[d.rp];
+    case 'c': return conds[d.y];
+    case 'n': return nums[d.y];
+    case 'a': return alu[d.y];
+    case 'i': return alu_imm[d.y];
+    }
+    return "?";
+}
+
+} // namespace isa_detail
+
+inline constexpr std::array<IsaInsn, 256> isa_table = [] {
+    std::array<IsaInsn, 256> t{};
+    for (int op = 0; op < 256; op++)
+        t[op] = isa_detail::expand(op);
+    return t;
+}();
+
+using IsaMnemonic = std::array<char, 12>;
+
+inline constexpr std::array<IsaMnemonic, 256> isa_mnemonics = [] {
+    std::array<IsaMnemonic, 256> t{};
+    for (int op = 0; op < 256; op++) {
+        const char* m = isa_patterns[isa_table[op].pattern].mnemonic;
+        int n = 0;
+        for (int i = 0; m[i]; i++) {
+            if (m[i] == '{') {
+                for (const char* s = isa_detail::field_name(m[i + 1], isa_table[op]); *s; s++)
+                    t[op][n++] = *s;
+                i += 2;
+            } else
+                t[op][n++] = m[i];
+        }
+    }
+    return t;
+}();
+
+// X(opcode) for every opcode, for switches over fully specialized handlers.
+#define ISA_X16(X, h)                                                                                          \
+    X(0x##h##0) X(0x##h##1) X(0x##h##2) X(0x##h##3) X(0x##h##4) X(0x##h##5) X(0x##h##6) X(0x##h##7)            \
+        X(0x##h##8) X(0x##h##9) X(0x##h##A) X(0x##h##B) X(0x##h##C) X(0x##h##D) X(0x##h##E) X(0x##h##F)
+#define ISA_OPCODES(X)                                                                                         \
+    ISA_X16(X, 0) ISA_X16(X, 1) ISA_X16(X, 2) ISA_X16(X, 3) ISA_X16(X, 4) ISA_X16(X, 5) ISA_X16(X, 6)          \
+        ISA_X16(X, 7) ISA_X16(X, 8) ISA_X16(X, 9) ISA_X16(X, A) ISA_X16(X, B) ISA_X16(X, C) ISA_X16(X, D)      \
+            ISA_X16(X, E) ISA_X16(X, F)
@@ -1,4 +1,8 @@
 #pragma once
 #include "cpu/cpu.h"
+#include <vector>
 
-bool loadROM(CPU* cpu, const char* path, u16 offset);
\ No newline at end of file
+bool loadROM(CPU* cpu, const char* path, u16 offset);
+
+// Reads a whole ROM file into bytes without touching any CPU.
+bool readROM(const char* path, std::vector<u8>& bytes);
@@ -1,10 +1,36 @@
 #pragma once
 #include "util/types.h"
+#include "cpu/isa.h"
+#include <array>
 
 struct Opcode{
     const char* mnemonic;
     u8 bytes;
     u8 cycles; // base cycles (not taken)
+    u8 cycles_taken = 0; // conditional CALL/RET when taken, 0 if there is one path
 };
 
-extern Opcode opcode_table[256];
\ No newline at end of file
+// Mnemonic, length and cycles of every opcode, expanded from the ISA
+// description in cpu/isa.h.
+inline constexpr std::array<Opcode, 256> opcode_table = [] {
+    std::array<Opcode, 256> t{};
+    for (int op = 0; op < 256; op++) {
+        const IsaInsn& d = isa_table[op];
+        t[op] = {isa_mnemonics[op].data(), d.bytes, d.cycles, u8(d.cycles_taken != d.cycles ? d.cycles_taken : 0)};
+    }
+    return t;
+}();
+
+struct Timing {
+    u8 not_taken; // unconditional instructions take this path
+    u8 taken;
+};
+
+// Cycles of both paths of every opcode, including the undocumented aliases
+// (0xCB JMP, 0xD9 RET, 0xDD/0xED/0xFD CALL).
+inline constexpr std::array<Timing, 256> timing_table = [] {
+    std::array<Timing, 256> t{};
+    for (int op = 0; op < 256; op++)
+        t[op] = {isa_table[op].cycles, isa_table[op].cycles_taken};
+    return t;
+}();
@@ -0,0 +1,61 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/decode.h"
+#include <bitset>
+#include <string>
+#include <vector>
+
+// Recursive-descent disassembly: instructions are decoded only where control
+// flow from the entry points can reach, so data stays data.
+
+struct BasicBlock {
+    u16 start;      // address of the first instruction
+    u32 first, end; // range in Program::insns
+    u16 succ[2];    // fall-through and/or branch target
+    u8 nsucc;
+};
+
+struct CallEdge {
+    u16 caller; // function entry
+    u16 callee;
+};
+
+// Bytes mapped at origin..origin+size-1 of the 64 KiB address space.
+struct Image {
+    const u8* bytes;
+    u16 origin;
+    u32 size;
+};
+
+struct Program {
+    std::vector<DecodedInsn> insns; // sorted by address
+    std::vector<BasicBlock> blocks; // sorted by address
+    std::vector<u16> functions;     // entry points and call targets, sorted
+    std::vector<CallEdge> calls;    // deduplicated call graph
+    std::vector<u16> labels;        // every branch/call target, sorted
+    std::bitset<0x10000> code;      // bytes decoded as instructions
+    u32 conflicts;                  // targets landing inside an instruction
+
+    void clear();
+};
+
+// Rebuilds out from the entry points; reuses out's storage.
+void analyze(const Image& img, const u16* entries, int nentries, Program& out);
+
+// Appends a labelled listing to out: decoded code as instructions, the
+// remaining bytes of the image as DB lines.
+void format_listing(const Image& img, const Program& prog, std::string& out);
+
+struct BatchStats {
+    u64 images;
+    u64 bytes;
+    u64 instructions;
+    u64 output_bytes;
+    double seconds;
+};
+
+// Analyzes and formats every image on `threads` worker threads. sink (if
+// set) receives each listing from the thread that produced it.
+BatchStats analyze_batch(const std::vector<Image>& images, u16 entry, int threads,
+                         void (*sink)(size_t index, const std::string& listing, void* ctx) = nullptr,
+                         void* ctx = nullptr);
@@ -1,5 +1,11 @@
 #pragma once
 #include "util/types.h"
+#include "cpu/decode.h"
+#include <cstddef>
+
+// Formats one decoded instruction as a listing line into buf and returns its
+// length.
+int format_insn(const DecodedInsn& d, char* buf, size_t size);
 
 int disasm(const u8* code,u16 pc);
-void disasm_all(const u8* code, u16 start, u16 size);
\ No newline at end of file
+void disasm_all(const u8* code, u16 start, u16 size);
@@ -0,0 +1,63 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include <string>
+#include <vector>
+
+struct Rewind;
+
+// GDB remote serial protocol server for one CPU, on a TCP port (localhost)
+// or a Unix socket. Registers use GDB's z80 layout: af bc de hl sp pc, then
+// ix iy af' bc' de' hl' ir, which read as 0 here.
+//
+// Nothing is checked per instruction for breakpoints: a software breakpoint
+// replaces the opcode with HLT, so the core runs unmodified until the CPU
+// halts on one. Write watchpoints set the page bit in Memory::watched and
+// are matched against the logged hits only when a watched page is written.
+// Reads of memory through the stub show the original bytes.
+//
+// With a Rewind attached, execution goes through its history and the
+// debugger may also step and continue backwards (bs/bc). Breakpoints are
+// then matched on pc after each instruction instead, since a patched
+// opcode would be recorded in the history's pages.
+
+struct GdbBreakpoint {
+    u16 addr;
+    u8 saved; // the opcode the HLT replaced
+};
+
+struct GdbWatch {
+    u16 addr;
+    u16 len;
+};
+
+struct GdbStub {
+    CPU* cpu = nullptr;
+
+    // Runs one instruction with any traps (BDOS, BIOS); defaults to
+    // cpu.step(). Returns 0 when the program has ended.
+    int (*exec)(void* ctx, CPU& cpu) = nullptr;
+    void* exec_ctx = nullptr;
+    Rewind* rewind = nullptr; // attached to cpu, with exec as its hook
+
+    int listen_fd = -1;
+    int fd = -1;
+    std::string unix_path; // unlinked on close
+    bool no_ack = false;
+
+    std::vector<GdbBreakpoint> breakpoints;
+    std::vector<GdbWatch> watches;
+
+    u64 packets = 0;
+    u64 stops = 0;
+};
+
+// "PORT" or "HOST:PORT" listens on TCP; anything else is a socket path.
+bool gdb_listen(GdbStub& g, const char* where);
+
+// Waits for the debugger, then serves it until it detaches or kills the
+// program. Returns false if the program ended or was killed, true after a
+// detach (the caller then keeps running it).
+bool gdb_serve(GdbStub& g);
+
+void gdb_close(GdbStub& g);
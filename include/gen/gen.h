@@ -0,0 +1,54 @@
+#pragma once
+#include "util/types.h"
+#include <vector>
+
+// Synthetic benchmark programs: .COM images that run a chosen instruction
+// mix in a loop and exit through BDOS function 0, for the emulator and the
+// bench harness. Encoding lengths and cycle estimates come from
+// opcode_table.
+//
+// Register roles keep every program valid: A, C, D and E hold data, B
+// counts the short loops, HL points into the data area (only LXI H,
+// INX H and DCX H move it) and SP is only moved by balanced pairs.
+
+enum GenClass {
+    GEN_MOV,    // MOV between data registers and M
+    GEN_ALU,    // ADD..CMP with a register or M
+    GEN_IMM,    // MVI, LXI D and the ALU immediates
+    GEN_INCDEC, // INR/DCR, INX/DCX
+    GEN_ROTATE, // RLC..RAR, CMA, STC, CMC, DAA
+    GEN_MEMORY, // LDA/STA, LDAX/STAX, SHLD and moving HL in the data area
+    GEN_STACK,  // PUSH/POP pairs
+    GEN_BRANCH, // conditional forward jumps over a few instructions
+    GEN_LOOP,   // short counted loops on B
+    GEN_CALL,   // a chain of call_depth nested subroutines
+    GEN_CLASSES,
+};
+
+const char* gen_class_name(int c);
+
+struct GenProfile {
+    const char* name;
+    u16 weight[GEN_CLASSES];
+    double taken_rate;      // share of flag-decided branches that are taken
+    double data_branches;   // share of branches decided by data instead
+    u32 footprint;          // data bytes touched, a power of two, 16..16384
+    int call_depth;         // subroutines per call chain, 1..8
+    double smc_rate;        // per slot: a store into the next instruction's operand
+    int body;               // instruction slots in the main loop, 1..2000
+    u64 cycles;             // approximate length of the run
+};
+
+// Built-in profiles: typical code and mixes that stress one thing each.
+const GenProfile* gen_presets(int* count);
+const GenProfile* gen_preset(const char* name); // null if unknown
+
+// Applies "key=value,key=value" overrides (class names for weights, and
+// taken, data, footprint, depth, smc, body, cycles); false on a bad key
+// or value.
+bool gen_parse(GenProfile& p, const char* spec);
+
+// Builds the image, loaded at 0x100; the same profile and seed always give
+// the same bytes. Empty if the profile is out of range or the code would
+// not fit below the data area.
+std::vector<u8> gen_rom(const GenProfile& p, u64 seed);
@@ -0,0 +1,80 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include <memory>
+#include <vector>
+
+// High-level emulation of known subroutines. When a CALL lands on code
+// whose bytes match a registered signature, a native version runs the
+// routine through its RET instead of the interpreter. Natives reproduce
+// the interpreter exactly: registers, flags, every memory write (stack
+// included, in the same order) and the cycle count of the path taken.
+//
+// Signatures are the routine's code bytes with absolute address operands
+// left out, so a relocated copy matches too; the native reads the
+// addresses from the code and declines the call if they are inconsistent.
+// Each call target is fingerprinted once (a hash of its bytes under each
+// signature's mask); later calls compare the code with the copy taken
+// then, so patched code (a debugger breakpoint, say) is looked at again.
+
+struct HleRoutine {
+    const char* name;
+    const char* pattern; // code bytes in hex from the entry, "??" for address bytes
+    // Runs the routine on cpu, which is at the entry with the return
+    // address pushed, through its RET. Returns the cycles it took, or 0
+    // to leave the call to the interpreter.
+    u32 (*run)(CPU& cpu);
+};
+
+// Every registered routine; count may be null.
+const HleRoutine* hle_registry(int* count);
+
+// Whether the code at addr matches routine r's signature, for natives that
+// call other registered routines.
+bool hle_matches(const u8* mem, u16 addr, int r);
+
+struct HleStats {
+    u64 calls = 0;
+    u64 cycles = 0; // emulated natively
+    u64 verified = 0;
+    u64 mismatches = 0;
+};
+
+struct HleMatch {
+    int routine;
+    std::vector<u8> code; // as fingerprinted
+};
+
+struct Hle {
+    // Verification: the first verify_limit calls of each routine are run
+    // natively and again by the interpreter from the same state, and the
+    // results compared. The interpreter's result is kept.
+    bool verify = false;
+    u64 verify_limit = 10000;
+
+    std::unique_ptr<HleStats[]> stats; // per registry entry
+    u64 declined = 0;                  // matched but left to the interpreter
+
+    Hle();
+
+    // Call with cpu just after a CALL to its pc. Runs a matching routine
+    // and returns its cycles, or 0 if there is none.
+    u32 call(CPU& cpu);
+
+  private:
+    std::unique_ptr<u8[]> target; // per address: 0 unseen, 1 no match, 2 + index in matches
+    std::vector<HleMatch> matches;
+    std::unique_ptr<u8[]> scratch;
+    u32 verify_call(CPU& cpu, int r);
+};
+
+// cpu.step() with matching CALLs run natively; returns the cycles used.
+inline int hle_step(Hle& hle, CPU& cpu) {
+    u16 pc = cpu.pc;
+    u8 op = cpu.mem->data[pc];
+    int n = cpu.step();
+    bool call = op == 0xCD || op == 0xDD || op == 0xED || op == 0xFD || (op & 0xC7) == 0xC4;
+    if (n && call && cpu.pc != u16(pc + 3))
+        n += int(hle.call(cpu));
+    return n;
+}
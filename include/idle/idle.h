@@ -0,0 +1,60 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+
+// Fast-forward through loops that only burn time: delay countdowns
+// (DCR r / JNZ, and DCX rp / MOV A,hi / ORA lo / JNZ), loops polling a
+// port or a memory flag that nothing changes until the next device event,
+// JMP $, and HLT. The result is exactly what stepping would give, cycle
+// count included; the loop just is not executed instruction by instruction.
+//
+// A loop qualifies when its body is straight-line code (exit branches
+// allowed) ending in a jump back to its head that writes no memory, does
+// not use the stack, and reads only ports marked pure. Countdowns are
+// computed; other loops run two iterations and are skipped when the
+// second left every register as the first did.
+//
+// Memory may only change through the CPU between events, and a pure port
+// only at events, so the run loop must stop at every event (interrupt,
+// input change) and pass its cycle as the target.
+
+constexpr int IDLE_MAX_BODY = 16; // bytes of loop body
+
+enum IdleKind : u8 {
+    IDLE_NONE,
+    IDLE_SPIN,    // candidate fixed point, checked on every entry
+    IDLE_COUNT8,  // DCR r / JNZ head
+    IDLE_COUNT16, // DCX rp / MOV A,x / ORA y / JNZ head
+};
+
+struct IdleLoop {
+    u16 head;
+    u8 len; // body bytes in code; 0 for an empty slot
+    u8 kind;
+    u8 reg; // counter register code (B=0 .. A=7) or pair (BC=0 .. HL=2)
+    u8 code[IDLE_MAX_BODY]; // body when analysed, to notice changed code
+};
+
+struct IdleSkip {
+    bool enabled = true;
+    u64 pure_in[4] = {}; // ports whose IN has no side effects
+
+    u64 spins = 0;      // polling loops and JMP $ skipped
+    u64 countdowns = 0; // delay loops computed
+    u64 halts = 0;      // HLTs skipped
+    u64 saved = 0;      // cycles not executed
+
+    IdleLoop cache[256] = {}; // direct-mapped by head address
+
+    void set_pure_in(u8 port) { pure_in[port >> 6] |= 1ull << (port & 63); }
+    u64 hits() const { return spins + countdowns + halts; }
+
+    // Call with cpu at the start of a possible loop, i.e. after a jump to
+    // an address at or below the jump. Skips as far towards target as the
+    // loop allows without passing it; returns the cycles skipped.
+    u64 skip(CPU& cpu, u64 target);
+};
+
+// Like `while (cpu.cycles < target) cpu.step();` with spin loops skipped.
+// False when a step returned 0.
+bool idle_run(IdleSkip& idle, CPU& cpu, u64 target);
@@ -0,0 +1,71 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include "memory/memory.h"
+#include "replay/replay.h"
+#include "idle/idle.h"
+
+// Taito Space Invaders board: 8 KiB ROM at 0x0000, RAM at 0x2000, a 1bpp
+// framebuffer at 0x2400, the hardware shift register on ports 2/3/4, and
+// RST 1 / RST 2 raised at mid-frame and at vblank.
+
+constexpr u16 INVADERS_VRAM = 0x2400;
+constexpr int INVADERS_ROWS = 224;     // VRAM rows, one per scanline
+constexpr int INVADERS_ROW_BYTES = 32; // 256 pixels per row, LSB first
+constexpr int INVADERS_WIDTH = INVADERS_ROW_BYTES * 8;
+constexpr u32 INVADERS_CLOCK = 1996800;
+constexpr u32 INVADERS_FRAME_CYCLES = INVADERS_CLOCK / 60;
+
+// input port 1 bits
+enum : u8 {
+    INV_COIN = 1 << 0,
+    INV_P2_START = 1 << 1,
+    INV_P1_START = 1 << 2,
+    INV_P1_SHOT = 1 << 4,
+    INV_P1_LEFT = 1 << 5,
+    INV_P1_RIGHT = 1 << 6,
+};
+
+struct Invaders {
+    CPU cpu;
+    Memory mem;
+    IOPorts io;
+
+    u16 shift;    // shift register contents
+    u8 shift_off; // port 2: read offset, 0-7
+    u8 port1;     // INV_* bits currently pressed
+    u8 port2;     // dip switches and player 2 controls
+    u8 sound[2];  // last writes to ports 3 and 5
+    u64 frames;
+    u64 frame_start; // cpu.cycles at the start of the current frame
+
+    // record/replay of port input and interrupt timing
+    PortTap tap;
+    Recorder* record = nullptr;
+    Replayer* replay = nullptr;
+
+    // Spin loops between interrupts are skipped unless recording or
+    // replaying (skipped loops would leave their INs out of the log).
+    IdleSkip idle;
+
+    // Framebuffer in VRAM orientation (row = scanline, 256 pixels wide);
+    // the cabinet monitor shows it rotated 90 degrees counter-clockwise.
+    u32 rgba[INVADERS_ROWS * INVADERS_WIDTH];
+    u8 shadow[INVADERS_ROWS * INVADERS_ROW_BYTES]; // VRAM as last rendered
+
+    void reset();
+
+    // Records into rec, or replays rep (one of them, or neither). Call
+    // after reset().
+    void trace(Recorder* rec, Replayer* rep);
+
+    // Loads an 8 KiB image, or invaders.h/.g/.f/.e from a directory.
+    bool load(const char* path);
+
+    // Runs one video frame including both interrupts; false on a fault.
+    bool run_frame();
+
+    // Converts the VRAM rows that changed since the last call into rgba
+    // and returns how many there were.
+    int render();
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include <cstddef>
+#include <string>
+
+// Results of batch runs remembered on disk, so a repeated job is answered
+// without emulating it. A run is decided by its program image, where it
+// is loaded and entered, its console input and its cycle budget; those
+// are hashed into a 128-bit key. The cache is a memory-mapped file that
+// outlives the process: a fixed table of slots plus an append-only area
+// for console output. When either fills, it starts over empty.
+//
+// One process may have the file open at a time (flock); within it, any
+// thread may look up and store.
+
+struct MemoKey {
+    u64 lo, hi;
+    bool operator==(const MemoKey& o) const { return lo == o.lo && hi == o.hi; }
+};
+
+// 128-bit digest of n bytes of any length.
+MemoKey memo_digest(const void* data, size_t n);
+
+// Key of a run of the image whose digest is rom.
+MemoKey memo_key(const MemoKey& rom, u16 load, u16 entry, const void* input, size_t input_len, u64 max_cycles);
+
+// Registers and the memory root hash of a machine after its run.
+u64 memo_state_digest(CPU& cpu);
+
+struct MemoResult {
+    u8 status; // RunStatus
+    u64 instructions;
+    u64 cycles;
+    u64 state; // memo_state_digest() at the end
+    std::string output;
+
+    bool operator==(const MemoResult& o) const {
+        return status == o.status && instructions == o.instructions && cycles == o.cycles && state == o.state &&
+               output == o.output;
+    }
+};
+
+struct MemoStats {
+    u64 entries;
+    u64 output_bytes;
+    u64 hits, misses, stored; // since memo_open()
+    u64 resets;               // times the file filled up and started over
+};
+
+struct MemoCache;
+
+// Opens or creates the cache file at path, bytes long in all. An existing
+// file of another size or format, or written by another build of the
+// program, is started over. Null, with a message, if it cannot be opened,
+// mapped or locked.
+MemoCache* memo_open(const char* path, size_t bytes);
+void memo_close(MemoCache* c);
+
+bool memo_lookup(MemoCache* c, const MemoKey& key, MemoResult& out);
+
+// Adds the result, or replaces the one stored under key.
+void memo_store(MemoCache* c, const MemoKey& key, const MemoResult& r);
+
+MemoStats memo_stats(MemoCache* c);
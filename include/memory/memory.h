@@ -1,10 +1,83 @@
 #pragma once
 #include "util/types.h"
+#include "util/isa.h"
 
 struct Memory {
     u8 data[0x10000];
 
-    u8 read(u16 addr);
-    void write(u16 addr,u8 value);
+    // One bit per 256-byte page written since the last clear_dirty():
+    // through write(), or directly to data[] and then passed to
+    // mark_written(). hash() moves the bits it has consumed to dirty_held,
+    // where they still count: read them through is_dirty() or dirty_bits().
+    u64 dirty[4];
+
+    // Write watch: a write() to a page with its bit set here is logged in
+    // hits (nhits keeps counting; the last 4 are kept, and an instruction
+    // writes at most 2 bytes). Unwatched pages cost one bit test.
+    u64 watched[4] = {};
+    u16 hits[4];
+    u32 nhits = 0;
+
+    // Inline everywhere, the per-ISA clones included.
+    HOT_INLINE u8 read(u16 addr) { return data[addr]; }
+    HOT_INLINE void write(u16 addr, u8 value) {
+        data[addr] = value;
+        dirty[addr >> 14] |= 1ull << ((addr >> 8) & 63);
+        if (watched[addr >> 14] >> ((addr >> 8) & 63) & 1)
+            hits[nhits++ & 3] = addr;
+    }
     void reset();
-};
\ No newline at end of file
+
+    // Merkle tree over the pages, brought up to date by hash(): node
+    // 256 + p is the hash of page p's bytes alone (equal pages hash equal
+    // wherever they are), node i combines nodes 2i and 2i+1, and node 1 is
+    // the root. write() adds nothing for it: pages come back through the
+    // dirty bits, so only pages written since the last hash() are hashed
+    // again.
+    u64 tree[512];
+    u64 dirty_held[4] = {}; // kept off the cache line write() uses
+    u64 unhashed[4] = {~0ull, ~0ull, ~0ull, ~0ull};
+
+    u64 hash(); // the root
+    u64 page_hash(int page) {
+        hash();
+        return tree[256 + page];
+    }
+    void mark_written(u32 addr, u32 n) {
+        for (u32 p = addr >> 8; n && p <= (addr + n - 1) >> 8 && p < 256; p++)
+            dirty[p >> 6] |= 1ull << (p & 63);
+    }
+
+    u64 dirty_bits(int w) const { return dirty[w] | dirty_held[w]; }
+    bool is_dirty(int page) const { return dirty_bits(page >> 6) >> (page & 63) & 1; }
+    // Callers tend to rewrite dirty pages (restores, recycling) before or
+    // after clearing, so every dirty page is hashed again.
+    void clear_dirty() {
+        for (int w = 0; w < 4; w++) {
+            unhashed[w] |= dirty[w] | dirty_held[w];
+            dirty[w] = dirty_held[w] = 0;
+        }
+    }
+
+    void watch_page(int page, bool on) {
+        if (on)
+            watched[page >> 6] |= 1ull << (page & 63);
+        else
+            watched[page >> 6] &= ~(1ull << (page & 63));
+    }
+    // Whether addr is among the logged hits.
+    bool was_written(u16 addr) const {
+        for (u32 i = 0; i < nhits && i < 4; i++)
+            if (hits[i] == addr)
+                return true;
+        return false;
+    }
+};
+
+// Equal up to a 64-bit hash collision: two roots compared.
+inline bool memory_equal(Memory& a, Memory& b) { return a.hash() == b.hash(); }
+
+// Sets bit p of bits[4] for every page p whose hash differs between a and
+// b, descending only into subtrees whose hashes differ, so the cost is in
+// the number of changed pages. Returns that number.
+int memory_diff(Memory& a, Memory& b, u64 bits[4]);
\ No newline at end of file
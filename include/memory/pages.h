@@ -0,0 +1,49 @@
+#pragma once
+#include "util/types.h"
+#include "memory/memory.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Content-addressed store of 256-byte pages for keeping many snapshots of
+// many machines: a page is held once however many snapshots share it.
+// Pages are looked up by their Merkle leaf (Memory::tree), so a snapshot
+// of a hashed machine hashes nothing, and confirmed with memcmp, so a hash
+// collision costs a second copy, never a wrong page. Comparing a machine
+// with a snapshot (snapshot_restore) trusts hashes instead, as
+// memory_equal() and memory_diff() do. Not thread-safe.
+struct PageStore {
+    // Id of the stored copy of page (whose leaf hash is h), adding it if
+    // new; each put takes a reference.
+    u32 put(const u8* page, u64 h);
+    void release(u32 id);
+
+    const u8* get(u32 id) const { return blocks[id / BLOCK].get() + id % BLOCK * 256; }
+    u64 hash_of(u32 id) const { return hashes[id]; }
+
+    size_t pages() const { return hashes.size() - free.size(); } // distinct pages held
+    size_t bytes() const; // page copies plus bookkeeping
+
+    static constexpr u32 BLOCK = 256; // pages per allocation, which never move
+    std::vector<std::unique_ptr<u8[]>> blocks;
+    std::vector<u64> hashes; // by id
+    std::vector<u32> refs;   // by id; 0 for a free id
+    std::vector<u32> free;
+    std::vector<u32> table; // id + 1, open addressing on the hash; 0 is empty
+    size_t used = 0;        // table slots taken
+};
+
+// A whole address space as page ids in a store: 1 KiB each, plus the
+// pages no other snapshot already holds.
+struct MemorySnapshot {
+    u64 root;
+    u32 page[256];
+};
+
+void snapshot_take(PageStore& s, Memory& mem, MemorySnapshot& snap);
+
+// Copies back the pages whose leaf hash differs from snap, marking them
+// written. Returns how many; the cost is in the number of changed pages.
+int snapshot_restore(const PageStore& s, const MemorySnapshot& snap, Memory& mem);
+
+void snapshot_release(PageStore& s, MemorySnapshot& snap);
@@ -0,0 +1,73 @@
+#pragma once
+#include "util/types.h"
+#include <atomic>
+#include <string>
+
+// Process-wide counters for long-running emulators, exported in the
+// Prometheus text format. Each thread counts into its own shard and is the
+// only writer of it (a plain load and store, no locked instruction);
+// readers sum the shards without taking a lock, so a scrape never stalls
+// the emulation.
+//
+// Nothing is added to the per-instruction path: runners add instructions
+// and cycles once per batch or run, and the rest is counted where the
+// emulator already left it (traps, IN/OUT, HLT, faults).
+
+struct MetricsShard {
+    std::atomic<u64> instructions{0};
+    std::atomic<u64> cycles{0};
+    std::atomic<u64> halt_cycles{0}; // stepped while halted
+    std::atomic<u64> faults{0};      // opcodes without a handler
+    std::atomic<u64> bdos[64] = {};  // BDOS traps by function, 63 and up together
+    std::atomic<u64> bios{0};        // BIOS jump table traps
+    std::atomic<u64> port_in[256] = {};
+    std::atomic<u64> port_out[256] = {};
+    MetricsShard* next = nullptr;
+};
+
+// The calling thread's shard, registered on first use and kept after the
+// thread exits, so totals never go down. __thread rather than thread_local:
+// no dynamic initializer, so reading it is one load with no TLS wrapper
+// call, cheap enough for IN/OUT.
+extern __thread MetricsShard* metrics_shard;
+__attribute__((cold, noinline)) MetricsShard& metrics_register();
+
+inline MetricsShard& metrics_local() {
+    MetricsShard* s = metrics_shard;
+    return __builtin_expect(s != nullptr, 1) ? *s : metrics_register();
+}
+
+// Owner-only update.
+inline void metrics_add(std::atomic<u64>& c, u64 n = 1) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+inline void metrics_add_run(u64 instructions, u64 cycles) {
+    MetricsShard& s = metrics_local();
+    metrics_add(s.instructions, instructions);
+    metrics_add(s.cycles, cycles);
+}
+
+struct MetricsTotals {
+    u64 instructions, cycles, halt_cycles, faults;
+    u64 bdos[64], bios;
+    u64 port_in[256], port_out[256];
+};
+
+// Sum over every shard; each counter is read once, not all at one instant.
+void metrics_sum(MetricsTotals& t);
+
+// Text exposition of t, with mips (emulated, over the caller's interval)
+// and the process uptime as gauges. Ports and BDOS functions that were
+// never used are left out.
+void metrics_format(const MetricsTotals& t, double mips, double uptime, std::string& out);
+
+struct MetricsExporter;
+
+// Serves GET /metrics on 127.0.0.1:port (0: no endpoint) and rewrites file
+// (null: none) every interval seconds, through a rename so a textfile
+// collector never reads half of it. Null if the port could not be bound.
+MetricsExporter* metrics_export_start(const char* file, int port, double interval = 5);
+
+// Writes the file a last time and stops the thread.
+void metrics_export_stop(MetricsExporter* e);
@@ -0,0 +1,44 @@
+#pragma once
+#include "util/types.h"
+
+// Real-time pacing: the core runs one frame's worth of emulated cycles at a
+// time, then sleeps until that frame's wall-clock deadline.
+
+struct PaceConfig {
+    u64 clock_hz = 2000000; // emulated CPU clock
+    u32 frame_hz = 60;      // batches per second of wall time
+    double speed = 1.0;     // N x real time; 0 runs unthrottled
+    u32 max_lag_frames = 6; // further behind than this, drop the backlog
+};
+
+struct PaceStats {
+    u64 frames;
+    u64 overruns;       // frames that finished after their deadline
+    u64 resyncs;        // times the backlog was dropped
+    u64 max_lag_ns;     // worst lateness seen at a deadline
+    double busy_seconds; // time spent emulating
+    double wall_seconds;
+};
+
+// Deadlines are absolute (start + n * period), so sleep jitter and the
+// instruction overshoot at the end of a frame do not accumulate.
+struct Pacer {
+    PaceConfig cfg;
+    PaceStats stats = {};
+
+    u64 begin_ns = 0;   // wall time of start()
+    u64 start_ns = 0;   // wall time of frame 0
+    u64 base_cycle = 0; // emulated cycle count at frame 0
+    u64 frame = 0;      // frames since start/resync
+    u64 busy_from = 0;  // wall time the current frame started
+
+    void start(u64 cycles);
+
+    // Cycle count the core should reach before end_frame().
+    u64 frame_target() const;
+
+    // Sleeps until the current frame's deadline and starts the next one.
+    void end_frame(u64 cycles);
+};
+
+u64 monotonic_ns();
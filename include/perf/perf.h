@@ -0,0 +1,121 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include "cpu/isa.h"
+#include <cstdio>
+
+// Host performance counters around the execution loop, from Linux
+// perf_event_open. Each event opens on its own, so a host (or VM, or
+// perf_event_paranoid setting) that offers only some of them still reports
+// those. Host cycles fall back to the time stamp counter, so a profile
+// always has at least one column.
+
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES, // the portable stand-in for L2: the last level cache
+    PERF_EVENTS,
+};
+
+const char* perf_event_name(int e);
+
+struct PerfCounters {
+    int fd[PERF_EVENTS];
+    void* page[PERF_EVENTS]; // mmapped control page, for rdpmc
+    bool rdpmc = false;      // every open counter readable from user space
+    bool tsc_cycles = false; // PERF_CYCLES comes from the TSC
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Opens what the host allows; false when no event could be opened.
+    bool open();
+    void close();
+    bool available(int e) const { return fd[e] >= 0 || (e == PERF_CYCLES && tsc_cycles); }
+
+    // Running totals since open(), unavailable events read 0. read() is a
+    // system call per event; read_fast() uses rdpmc when it can and only
+    // the TSC otherwise, for reading around single instructions.
+    void read(u64 out[PERF_EVENTS]) const;
+    void read_fast(u64 out[PERF_EVENTS]) const;
+};
+
+// Opcode classes by the kind of work their handler does, from the ISA
+// description. Every opcode dispatches the same way, to its own handler,
+// so classes differ only in that work.
+enum OpClass {
+    OPC_MOVE,   // MOV, MVI, LXI, XCHG, SPHL
+    OPC_ALU,    // arithmetic, logic, INR/DCR, INX/DCX, DAD, rotates and flags
+    OPC_MEMORY, // LDA/STA, LDAX/STAX, LHLD/SHLD
+    OPC_STACK,  // PUSH, POP, XTHL
+    OPC_BRANCH, // jumps, calls, returns, RST, PCHL
+    OPC_OTHER,  // NOP, HLT, IN, OUT, DI, EI
+    OPC_CLASSES
+};
+
+inline constexpr int op_class_of(IsaOp op) {
+    switch (op) {
+    case ISA_MOV: case ISA_MVI: case ISA_LXI: case ISA_XCHG: case ISA_SPHL:
+        return OPC_MOVE;
+    case ISA_ALU: case ISA_ALU_IMM: case ISA_INR: case ISA_DCR: case ISA_INX: case ISA_DCX: case ISA_DAD:
+    case ISA_RLC: case ISA_RRC: case ISA_RAL: case ISA_RAR: case ISA_DAA: case ISA_CMA: case ISA_STC: case ISA_CMC:
+        return OPC_ALU;
+    case ISA_STAX: case ISA_LDAX: case ISA_SHLD: case ISA_LHLD: case ISA_STA: case ISA_LDA:
+        return OPC_MEMORY;
+    case ISA_PUSH: case ISA_POP: case ISA_XTHL:
+        return OPC_STACK;
+    case ISA_JMP: case ISA_JCC: case ISA_CALL: case ISA_CCC: case ISA_RET: case ISA_RCC: case ISA_RST: case ISA_PCHL:
+        return OPC_BRANCH;
+    default:
+        return OPC_OTHER;
+    }
+}
+
+inline int op_class(u8 op) {
+    return op_class_of(isa_table[op].op);
+}
+
+const char* op_class_name(int c);
+
+// Counters over a run, normalized per emulated instruction. With
+// per_class set they are also read around every instruction and charged
+// to its class, less the cost of an empty read; that slows the run and
+// perturbs the totals, so use it to compare classes, not for totals.
+struct PerfProfile {
+    PerfCounters counters;
+    bool per_class = false;
+    u64 insns[OPC_CLASSES] = {};
+    u64 by_class[OPC_CLASSES][PERF_EVENTS] = {};
+    u64 total[PERF_EVENTS] = {};
+    u64 overhead[PERF_EVENTS] = {}; // of one read_fast() pair
+    u64 started[PERF_EVENTS] = {};
+
+    // Opens the counters and starts counting.
+    void begin();
+    void end();
+
+    // Runs one step through step_fn (the core's step, or HLE's) and
+    // counts it; returns what step_fn returned.
+    template <class StepFn> int step(CPU& cpu, StepFn&& step_fn) {
+        int c = op_class(cpu.mem->data[cpu.pc]);
+        insns[c]++;
+        if (!per_class)
+            return step_fn();
+        u64 before[PERF_EVENTS], after[PERF_EVENTS];
+        counters.read_fast(before);
+        int n = step_fn();
+        counters.read_fast(after);
+        for (int e = 0; e < PERF_EVENTS; e++) {
+            u64 d = after[e] - before[e];
+            by_class[c][e] += d > overhead[e] ? d - overhead[e] : 0;
+        }
+        return n;
+    }
+};
+
+// Prints the totals and, if measured, the per-class table.
+void perf_report(const PerfProfile& p, FILE* out);
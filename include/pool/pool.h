@@ -0,0 +1,62 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include "memory/memory.h"
+#include <cstddef>
+
+// Machine instances for worker threads on multi-socket hosts. Every NUMA
+// node has its own arena and free list: an instance taken for a node has
+// its CPU and memory in pages bound to that node, and when it is released
+// it keeps those pages, with only the 256-byte pages the run wrote zeroed.
+// Pages no run touched are never faulted in.
+//
+// The topology comes from /sys/devices/system/node, limited to the CPUs
+// this process may run on. Without it there is one node, and so there is
+// with placement off: pages land wherever the kernel first touches them.
+
+struct Instance {
+    CPU cpu;
+    Memory mem;
+    int node; // whose free list it goes back to, -1 without placement
+};
+
+struct InstancePool;
+
+// Nodes with usable CPUs, at least 1.
+int pool_nodes();
+
+// Pins the calling thread to one CPU for worker number `worker`, spreading
+// workers over the nodes round robin. Returns the node, -1 if the thread
+// could not be pinned.
+int pool_pin_worker(int worker);
+
+// numa=false ignores nodes: one free list, no binding.
+InstancePool* pool_create(bool numa);
+void pool_destroy(InstancePool* p); // after every instance is released
+
+// A reset instance with zeroed memory, cpu.mem set; node is where it should
+// live (from pool_pin_worker, or -1 for anywhere). Thread-safe.
+Instance* pool_acquire(InstancePool* p, int node);
+
+// Copies a program into memory and marks its pages dirty, so that
+// recycling clears them.
+void pool_load(Instance* inst, u16 addr, const u8* bytes, size_t n);
+
+// Zeroes the dirty pages and resets the CPU, in place. Stores that bypass
+// Memory::write() must go through pool_load(), and a caller that clears
+// the dirty bits itself must Memory::reset() instead. Returns the pages
+// cleared.
+int pool_recycle(Instance* inst);
+
+// Recycles the instance onto its node's free list. Thread-safe.
+void pool_release(InstancePool* p, Instance* inst);
+
+struct PoolStats {
+    u64 created;
+    u64 reused;
+    u64 pages_cleared; // by pool_release
+    u64 bytes_mapped;
+    u64 bound;         // instances whose pages mbind() placed
+};
+
+PoolStats pool_stats(InstancePool* p);
@@ -0,0 +1,103 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include <cstddef>
+#include <vector>
+
+// Record/replay of everything that can make two runs of the same program
+// differ: IN values, console input and its availability, and when
+// interrupts were taken. Each event is stored with the cycle count at which
+// it happened, delta-encoded as a varint, so the log stays a few bytes per
+// event. Replaying feeds the same values back at the same cycles.
+
+enum ReplayEvent : u8 {
+    EV_END = 0,
+    EV_IN = 1,          // port, value
+    EV_CONSOLE = 2,     // byte read from the console
+    EV_CONSOLE_RDY = 3, // console status answer
+    EV_IRQ = 4,         // RST opcode taken
+};
+
+struct Recorder {
+    std::vector<u8> log;
+    u64 last_cycle = 0;
+    u64 events = 0;
+
+    void begin();
+    void in(u64 cycle, u8 port, u8 value) { put(EV_IN, cycle, port, value, 2); }
+    void console(u64 cycle, u8 value) { put(EV_CONSOLE, cycle, value, 0, 1); }
+    void console_ready(u64 cycle, u8 ready) { put(EV_CONSOLE_RDY, cycle, ready, 0, 1); }
+    void interrupt(u64 cycle, u8 rst) { put(EV_IRQ, cycle, rst, 0, 1); }
+    bool save(const char* path);
+
+    void put(u8 kind, u64 cycle, u8 a, u8 b, int n) {
+        u64 d = cycle - last_cycle;
+        last_cycle = cycle;
+        log.push_back(kind);
+        for (; d >= 0x80; d >>= 7)
+            log.push_back(u8(d) | 0x80);
+        log.push_back(u8(d));
+        log.push_back(a);
+        if (n == 2)
+            log.push_back(b);
+        events++;
+    }
+};
+
+struct Replayer {
+    std::vector<u8> log;
+    size_t pos = 0;
+    u64 events = 0; // replayed so far
+
+    // next event, decoded ahead
+    u8 kind = EV_END;
+    u64 cycle = 0;
+    u8 a = 0, b = 0;
+
+    bool diverged = false; // the run asked for something the log lacks
+    u64 diverged_at = 0;
+
+    bool load(const char* path);
+    bool start(std::vector<u8> bytes);
+    bool done() const { return kind == EV_END; }
+
+    // Logged results; on a mismatch they mark the replay diverged.
+    u8 in(u64 now, u8 port);
+    u8 console(u64 now);
+    u8 console_ready(u64 now);
+
+    // RST opcode of an interrupt due at or before now, or 0.
+    u8 interrupt_due(u64 now) const { return kind == EV_IRQ && cycle <= now ? a : 0; }
+    void next();
+
+  private:
+    bool expect(u8 k, u64 now);
+};
+
+// Sits between a CPU and its IOPorts: records IN results, or answers INs
+// from the log while still passing OUTs to the devices.
+struct PortTap {
+    IOPorts io;
+    IOPorts* inner = nullptr;
+    CPU* cpu = nullptr;
+    Recorder* record = nullptr;
+    Replayer* replay = nullptr;
+
+    void attach(CPU& c, Recorder* rec, Replayer* rep);
+    void detach();
+};
+
+// Raises an interrupt and logs it if it was taken.
+int raise_interrupt(CPU& cpu, u8 rst, Recorder* rec);
+
+// Takes the interrupt the log has due at this cycle, if any. Call before
+// every step while replaying, instead of raising interrupts.
+inline void replay_interrupts(CPU& cpu, Replayer& rep) {
+    if (u8 rst = rep.interrupt_due(cpu.cycles)) {
+        if (rep.cycle != cpu.cycles || !cpu.interrupt(rst)) {
+            rep.diverged = true;
+            rep.diverged_at = cpu.cycles;
+        }
+        rep.next();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Time travel by checkpoint and re-execution. Every `interval` cycles the
+// CPU registers are saved together with the old contents of the pages
+// written since the previous checkpoint (an undo record), so a checkpoint
+// costs only what the program touched. Going back restores the nearest
+// earlier checkpoint and runs forward to the exact cycle.
+//
+// Only CPU and memory are checkpointed, plus one device position if
+// `cursor` is set (how much console input was read): re-execution must not
+// depend on other device state, and memory must change through
+// Memory::write(). Instructions run again are marked by replaying(), so an
+// exec hook can keep their side effects (console output) from repeating.
+
+struct Checkpoint {
+    CPU regs;
+    // pages written between this checkpoint and the next, as they were here
+    std::vector<u8> pages;
+    std::vector<u8> undo; // pages.size() * 256 bytes
+    size_t cursor;        // *Rewind::cursor here
+};
+
+struct Rewind {
+    CPU* cpu = nullptr;
+    Memory* mem = nullptr;
+    u64 interval = 1000000; // cycles between checkpoints
+    size_t budget = 64 << 20; // checkpoint bytes kept; the oldest go first
+
+    // Runs one instruction; defaults to cpu.step(). Lets traps such as the
+    // BDOS run during re-execution too. Returns 0 to stop.
+    int (*exec)(void* ctx, CPU& cpu) = nullptr;
+    void* exec_ctx = nullptr;
+    size_t* cursor = nullptr; // saved and restored with the registers
+
+    std::deque<Checkpoint> checkpoints; // oldest first
+    u8 shadow[0x10000]; // memory as of the newest checkpoint
+    size_t bytes = 0;
+    u64 frontier = 0; // furthest cycle reached before going back
+    bool in_scratch = false; // reverse_to_write() is running a copy
+
+    u64 restores = 0;
+    u64 replayed_cycles = 0;
+
+    // Starts history at the current state.
+    void attach(CPU& c);
+
+    // One instruction, checkpointing when due. Returns its cycles, 0 on stop.
+    int step();
+    void checkpoint();
+
+    // Whether the instruction about to run has run before.
+    bool replaying() const { return in_scratch || cpu->cycles < frontier; }
+
+    u64 oldest() const { return checkpoints.empty() ? 0 : checkpoints.front().regs.cycles; }
+
+    // Runs forward, or back through the history, to the first instruction
+    // boundary at or after `cycle`. False if that is before the history.
+    bool run_to(u64 cycle);
+
+    // Back to the start of the previous instruction.
+    bool step_back();
+
+    // Back to the most recent earlier instruction that wrote addr, stopped
+    // before it executes. Returns false, with the state unchanged, when the
+    // history has no such write.
+    bool reverse_to_write(u16 addr);
+
+    // Back to the latest earlier instruction for which hit(ctx, pc) is
+    // true, called after it runs with the pc it started at (Memory::nhits
+    // then holds its watched writes); stopped before it executes. Without
+    // one, goes back to the oldest checkpoint and returns false.
+    bool reverse_until(bool (*hit)(void* ctx, u16 pc), void* ctx);
+
+  private:
+    int exec_one();
+    void restore(size_t index);
+    bool run_forward(u64 cycle);
+};
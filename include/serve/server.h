@@ -0,0 +1,69 @@
+#pragma once
+#include "util/types.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Long-running emulator service on a Unix domain socket. ROM images are
+// loaded once; every worker thread owns a CPU+Memory instance from an
+// InstancePool that is recycled right after each run (only the pages the
+// run wrote are cleared), so a request only copies its image and executes.
+//
+// One request per line; each connection gets its responses in order.
+//   RUN <rom> [max_cycles] [input-hex]
+//       -> OK <len> <exit|budget|fault|halt> <instructions> <cycles> <run_us>
+//          followed by <len> bytes of console output; run_us is 0 when
+//          the result came from the memo cache
+//   LIST  -> OK <len>, then one ROM name per line
+//   STATS -> OK <len>, then the latency histograms as text
+// Malformed requests get "ERR <reason>".
+
+struct RomImage {
+    std::string name;
+    std::vector<u8> bytes; // .COM image, loaded at 0x100
+};
+
+struct ServeConfig {
+    std::string socket_path;
+    int workers = 1;
+    bool numa = false; // pin workers; each instance lives on its worker's node
+    u64 default_cycles = 10000000;
+    u64 max_cycles = 2000000000; // upper bound a request may ask for
+    size_t max_input = 64 << 10; // console input bytes a request may carry
+
+    // Result cache file (memo/memo.h); empty for none. A repeated RUN is
+    // answered from it, except for a memo_verify fraction of hits, which
+    // are run again and replace the entry if it no longer matches.
+    std::string memo_path;
+    size_t memo_bytes = 64 << 20;
+    double memo_verify = 0;
+};
+
+// Power-of-two buckets of nanoseconds; safe to update from any thread.
+struct LatencyHistogram {
+    static constexpr int BUCKETS = 40;
+    std::atomic<u64> bucket[BUCKETS] = {};
+
+    void add(u64 ns);
+    u64 count() const;
+    u64 percentile_ns(double p) const; // upper bound of the matching bucket
+    void format(const char* name, std::string& out) const;
+};
+
+struct Server;
+
+Server* server_create(const ServeConfig& cfg, std::vector<RomImage> roms);
+
+// Runs the event loop on the calling thread until server_stop(). Returns 0,
+// or -1 if the socket, the memo cache or the workers' instances could not
+// be set up.
+int server_run(Server* s);
+
+// Thread- and signal-safe.
+void server_stop(Server* s);
+
+void server_destroy(Server* s);
+
+// Turnaround (request parsed -> response queued) and emulation time.
+const LatencyHistogram& server_latency(const Server* s);
+const LatencyHistogram& server_run_time(const Server* s);
@@ -0,0 +1,69 @@
+#pragma once
+#include "util/types.h"
+#include <coroutine>
+#include <deque>
+#include <exception>
+
+// Single-threaded cooperative runtime: every emulated machine is a C++20
+// coroutine, and a Scheduler resumes whichever are ready on its thread.
+
+struct Scheduler {
+    std::deque<std::coroutine_handle<>> ready;
+    u64 quantum = 20000; // cycles a machine runs before yielding
+    u64 resumes = 0;
+
+    void wake(std::coroutine_handle<> h) { ready.push_back(h); }
+
+    // Resumes ready coroutines until none is left; anything still
+    // suspended then waits on an event that can no longer happen.
+    void run() {
+        while (!ready.empty()) {
+            std::coroutine_handle<> h = ready.front();
+            ready.pop_front();
+            resumes++;
+            h.resume();
+        }
+    }
+
+    // co_await sched.yield(): go to the back of the ready queue.
+    struct Yield {
+        Scheduler* s;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { s->wake(h); }
+        void await_resume() const noexcept {}
+    };
+    Yield yield() { return Yield{this}; }
+};
+
+// Coroutine return type for a machine. Starts suspended, so the caller
+// schedules it; the frame lives until the task is destroyed.
+struct MachineTask {
+    struct promise_type {
+        MachineTask get_return_object() {
+            return MachineTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> h;
+
+    MachineTask() = default;
+    explicit MachineTask(std::coroutine_handle<promise_type> h) : h(h) {}
+    MachineTask(MachineTask&& o) noexcept : h(o.h) { o.h = nullptr; }
+    MachineTask& operator=(MachineTask&& o) noexcept {
+        if (h)
+            h.destroy();
+        h = o.h;
+        o.h = nullptr;
+        return *this;
+    }
+    ~MachineTask() {
+        if (h)
+            h.destroy();
+    }
+
+    bool done() const { return !h || h.done(); }
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include <atomic>
+
+// Serial link between two CPUs running on different host threads. Bytes go
+// through a bounded single-producer/single-consumer ring stamped with the
+// emulated cycle at which they arrive (send cycle + latency).
+//
+// Results do not depend on host timing: a receiver at cycle t only sees a
+// byte whose arrival is <= t, and when none is queued it waits until the
+// sender's published clock proves no such byte can still come. The latency
+// is the lookahead that keeps two waiting sides from deadlocking. A full
+// ring only stalls the host thread; the emulated transmitter is never busy.
+
+struct SerialLink {
+    static constexpr u32 SIZE = 4096; // power of two
+
+    struct Entry {
+        u64 arrival; // receiver cycle at which the byte is available
+        u8 value;
+    };
+
+    u64 latency = 1; // emulated cycles in flight, at least 1
+
+    // producer side
+    alignas(64) std::atomic<u32> tail{0};
+    u32 head_cache = 0;
+    std::atomic<u64> clock{0};       // no future send departs before this
+    std::atomic<bool> closed{false}; // sender finished
+
+    // consumer side
+    alignas(64) std::atomic<u32> head{0};
+    u32 tail_cache = 0;
+
+    alignas(64) Entry ring[SIZE];
+};
+
+// Port device attaching a CPU to one link in each direction: data on
+// data_port, status (bit 0 receive ready, bit 1 transmit ready) on
+// data_port + 1. IN on the data port idles the CPU until a byte arrives.
+struct SerialPort {
+    CPU* cpu = nullptr;
+    SerialLink* rx = nullptr;
+    SerialLink* tx = nullptr;
+    IOPorts io;
+    u8 data_port = 0x10;
+
+    u64 sent = 0, received = 0;
+    u64 idle_cycles = 0; // emulated cycles spent waiting in IN
+    u64 host_waits = 0;  // times the host thread had to back off
+    bool eof = false;    // IN found the link closed and empty
+
+    void attach(CPU& c, SerialLink* receive, SerialLink* transmit);
+
+    // Tells the receiver how far this CPU has got; run_linked calls it.
+    void publish();
+
+    // No more sends: releases a receiver waiting on this side.
+    void close();
+};
+
+// Steps cpu until max_cycles, a fault, or EOF on the port, publishing its
+// clock as it goes, then closes the transmit side. Returns instructions.
+u64 run_linked(CPU& cpu, SerialPort& port, u64 max_cycles);
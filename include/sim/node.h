@@ -0,0 +1,63 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include "memory/memory.h"
+#include "sim/coro.h"
+
+// Machines of a simulated network, each with up to NODE_LINKS serial links.
+// Link i is on ports NODE_PORT_BASE + 2i (data) and NODE_PORT_BASE + 2i + 1
+// (status: bit 0 receive ready, bit 1 transmit ready). IN from an empty
+// data port or OUT to a full one suspends the machine until its peer acts;
+// HLT suspends until any link receives, which then raises RST 7.
+
+constexpr int NODE_LINKS = 4;
+constexpr u8 NODE_PORT_BASE = 0x10;
+constexpr u8 LINK_RX_READY = 0x01;
+constexpr u8 LINK_TX_READY = 0x02;
+
+struct Node;
+
+// One direction of a link: a small byte FIFO plus the machines waiting on it.
+struct Pipe {
+    static constexpr u32 SIZE = 16;
+    u8 buf[SIZE];
+    u32 head = 0, tail = 0; // free-running read and write counts
+    Node* reader = nullptr; // receiving end
+    Node* writer = nullptr; // sending end
+
+    bool can_read() const { return tail != head; }
+    bool can_write() const { return tail - head < SIZE; }
+};
+
+enum NodeWait : u8 {
+    WAIT_NONE,
+    WAIT_READ,  // IN on an empty link
+    WAIT_WRITE, // OUT on a full link
+    WAIT_HALT,  // HLT, any link receiving wakes it
+};
+
+struct Node {
+    CPU cpu;
+    Memory mem;
+    IOPorts io;
+    Pipe* rx[NODE_LINKS] = {};
+    Pipe* tx[NODE_LINKS] = {};
+
+    Scheduler* sched = nullptr;
+    std::coroutine_handle<> handle; // set while suspended on a pipe
+    u8 wait = WAIT_NONE;
+
+    u64 sent = 0, received = 0;
+    u64 blocks = 0; // times the machine suspended on a link or HLT
+    bool fault = false;
+
+    // Clears memory and state and hooks the link ports.
+    void reset(Scheduler& s);
+};
+
+// Joins link la of a and link lb of b through the two pipes.
+void connect(Node& a, int la, Node& b, int lb, Pipe& a_to_b, Pipe& b_to_a);
+
+// Runs node until it has used max_cycles, faults, or halts with interrupts
+// disabled. Resume it through Scheduler::wake after creating it.
+MachineTask run_node(Node& node, u64 max_cycles);
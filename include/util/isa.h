@@ -0,0 +1,27 @@
+#pragma once
+
+// Hot interpreter loops are compiled for several x86-64 levels and the
+// loader picks one per process through an ifunc (EMU_ISA_CLONES in CMake).
+#if defined(EMU_ISA_CLONES)
+#define ISA_CLONES __attribute__((target_clones("arch=x86-64-v3", "arch=x86-64-v2", "default")))
+#else
+#define ISA_CLONES
+#endif
+
+// For small functions the clones must inline: GCC will not inline a
+// baseline function into a clone built for a different -march.
+#define HOT_INLINE inline __attribute__((always_inline))
+
+// Name of the clone the loader picks on this host.
+inline const char* isa_level() {
+#if defined(EMU_ISA_CLONES)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("x86-64-v3"))
+        return "x86-64-v3";
+    if (__builtin_cpu_supports("x86-64-v2"))
+        return "x86-64-v2";
+    return "x86-64";
+#else
+    return "single";
+#endif
+}
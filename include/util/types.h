@@ -3,4 +3,5 @@
 
 using u8 = uint8_t;
 using u16 = uint16_t;
-using u32 = uint32_t;
\ No newline at end of file
+using u32 = uint32_t;
+using u64 = uint64_t;
\ No newline at end of file
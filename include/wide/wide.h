@@ -0,0 +1,67 @@
+#pragma once
+#include "util/types.h"
+#include "cpu/cpu.h"
+#include "cpm/bdos.h"
+
+// Number of 8080 instances kept in vector lanes. Override with
+// -DWIDE_LANES=8/16/32; the vector width follows from it.
+#ifndef WIDE_LANES
+#define WIDE_LANES 16
+#endif
+
+static_assert(WIDE_LANES >= 8 && WIDE_LANES <= 32 && (WIDE_LANES & (WIDE_LANES - 1)) == 0,
+              "WIDE_LANES must be 8, 16 or 32");
+
+// GCC/Clang vector extensions: lowered to AVX-512/AVX2/SSE2 depending on the
+// target ISA, or to scalar code when none is available.
+typedef u8 lane_u8 __attribute__((vector_size(WIDE_LANES)));
+typedef u16 lane_u16 __attribute__((vector_size(WIDE_LANES * 2)));
+typedef u64 lane_u64 __attribute__((vector_size(WIDE_LANES * 8)));
+typedef u32 lane_mask; // one bit per lane
+
+// Structure-of-arrays engine running WIDE_LANES independent CPUs in lockstep.
+// Each step picks the lowest PC among live lanes and executes the opcode found
+// there for every lane sharing that PC and opcode; the other lanes are masked
+// off until their PC comes up again (min-PC reconvergence).
+struct WideCPU {
+    lane_u8 a, b, c, d, e, h, l;
+    lane_u8 f; // flags byte, same layout as Flags::f
+    lane_u8 inte, halted;
+    lane_u16 sp, pc;
+
+    lane_u64 cycles;
+    Memory* mem[WIDE_LANES]; // every lane owns its memory
+
+    lane_mask live;  // lanes still executing
+    lane_mask fault; // lanes stopped on an unimplemented opcode
+    lane_mask hang;  // lanes stopped on HLT with interrupts disabled
+    lane_mask sleep; // lanes with halted set, updated by load()
+    lane_mask group; // lanes known to share a PC after the last step
+
+    // Pages whose bytes are identical in every live lane. Fetches from them
+    // skip the per-lane opcode gather; any write through the engine clears
+    // the page, and it is compared again after 256 gathered fetches.
+    u8 shared[256];
+    u8 stale[256];
+
+    u64 steps;      // vector steps issued
+    u64 lane_steps; // instructions retired over all lanes
+
+    void load(int lane, const CPU& cpu);
+    void store(int lane, CPU& cpu) const;
+
+    // Recomputes shared[]; call after lane memory was changed outside step().
+    void share_pages();
+    void share_page(u8 page);
+
+    // Executes one instruction for the reconverged lane group and returns
+    // the mask of lanes that ran it, plus the halted lanes that idled for
+    // 4 cycles (0 when no lane is live). Reads go straight to Memory::data,
+    // writes through Memory::write.
+    lane_mask step();
+};
+
+// Runs a .COM program on all live lanes until each exits, halts with
+// interrupts disabled (see hang) or has used max_cycles. BDOS calls are
+// serviced per lane through the scalar trap.
+void run_com(WideCPU& w, Console& con, u64 max_cycles);
@@ -0,0 +1,40 @@
+#pragma once
+#include "util/types.h"
+#include "memory/memory.h"
+#include "cpu/cpu.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Benchmark modes. Each parses its own arguments (argv[0] is the mode name)
+// and prints a report; the return value is the process exit code.
+int bench_wide(int argc, char** argv);
+int bench_cycles(int argc, char** argv);
+int bench_invaders(int argc, char** argv);
+int bench_daemon(int argc, char** argv);
+int bench_coro(int argc, char** argv);
+int bench_link(int argc, char** argv);
+int bench_disk(int argc, char** argv);
+int bench_replay(int argc, char** argv);
+int bench_rewind(int argc, char** argv);
+int bench_bulk(int argc, char** argv);
+int bench_idle(int argc, char** argv);
+int bench_hle(int argc, char** argv);
+int bench_perf(int argc, char** argv);
+int bench_gen(int argc, char** argv);
+int bench_pool(int argc, char** argv);
+int bench_metrics(int argc, char** argv);
+int bench_merkle(int argc, char** argv);
+int bench_memo(int argc, char** argv);
+
+// Resets mem/cpu and places a .COM image at 0x100 ready to run.
+void boot_com(CPU& cpu, Memory& mem, const std::vector<u8>& image);
+
+inline double seconds_since(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Client side of emud (daemon.cpp): connects, retrying while the server
+// starts, or returns -1; reads one "OK <len> ..." reply and its payload.
+int daemon_connect(const std::string& path);
+bool daemon_reply(int fd, std::string& buf, std::string& head, std::string& payload);
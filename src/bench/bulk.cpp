@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "bench/bench.h"
+#include "bulk/bulk.h"
+
+static constexpr size_t SPACE = 0x10000;
+static constexpr size_t PAGES = SPACE / 256;
+
+// Best of 5 runs of reps calls, in GB/s over `bytes` per call.
+template <class F> static double rate(int reps, size_t bytes, F f) {
+    double best = 1e30;
+    for (int k = 0; k < 5; k++) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < reps; i++)
+            f();
+        best = std::min(best, seconds_since(t0));
+    }
+    return double(bytes) * reps / best / 1e9;
+}
+
+// What the kernels replace: memset, a memcmp per page, byte-wise FNV-1a.
+static void diff_memcmp(const u8* a, const u8* b, size_t pages, u64* bits) {
+    memset(bits, 0, (pages + 63) / 64 * 8);
+    for (size_t p = 0; p < pages; p++)
+        if (memcmp(a + p * 256, b + p * 256, 256) != 0)
+            bits[p / 64] |= 1ull << (p % 64);
+}
+
+static u64 hash_fnv(const void* data, size_t n) {
+    const u8* p = (const u8*)data;
+    u64 h = 1469598103934665603ull;
+    for (size_t i = 0; i < n; i++)
+        h = (h ^ p[i]) * 1099511628211ull;
+    return h;
+}
+
+// Times every kernel version this host runs on 64 KiB images and checks
+// that each agrees with the scalar one.
+int bench_bulk(int argc, char** argv) {
+    int reps = 2000;
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], "--reps") && i + 1 < argc)
+            reps = atoi(argv[++i]);
+
+    std::vector<u8> a(SPACE), b(SPACE), scratch(SPACE);
+    std::mt19937 rng(40);
+    for (u8& v : a)
+        v = u8(rng());
+    b = a;
+    // one byte off in a quarter of the pages, at either end or inside
+    for (size_t p = 0; p < PAGES; p += 4)
+        b[p * 256 + (p % 3 == 0 ? 0 : p % 3 == 1 ? 255 : rng() % 256)] ^= 0x10;
+
+    int n;
+    const BulkKernels* v = bulk_variants(&n);
+    const BulkKernels& ref = v[0];
+    u64 want_bits[PAGES / 64];
+    ref.diff_pages(a.data(), b.data(), PAGES, want_bits);
+
+    printf("kernels: %s picked, %d available\n", bulk().name, n);
+    printf("  %-8s %10s %10s %10s   (GB/s on 64 KiB)\n", "", "clear", "diff", "hash");
+
+    volatile u64 sink = 0;
+    int wrong = 0;
+    for (int k = 0; k < n; k++) {
+        const BulkKernels& kv = v[k];
+
+        // agreement with the scalar version, sizes from one stripe up
+        u64 bits[PAGES / 64];
+        kv.diff_pages(a.data(), b.data(), PAGES, bits);
+        if (memcmp(bits, want_bits, sizeof(bits)) != 0)
+            printf("  %s diff_pages disagrees\n", kv.name), wrong++;
+        for (size_t len = 64; len <= SPACE; len *= 4)
+            if (kv.hash(a.data(), len, 7) != ref.hash(a.data(), len, 7))
+                printf("  %s hash of %zu bytes disagrees\n", kv.name, len), wrong++;
+        memset(scratch.data(), 0xff, SPACE);
+        kv.clear(scratch.data() + 64, SPACE - 128);
+        if (scratch[63] != 0xff || scratch[64] || scratch[SPACE - 65] || scratch[SPACE - 64] != 0xff)
+            printf("  %s clear wrote the wrong bytes\n", kv.name), wrong++;
+
+        double c = rate(reps, SPACE, [&] { kv.clear(scratch.data(), SPACE); });
+        double d = rate(reps, 2 * SPACE, [&] { kv.diff_pages(a.data(), b.data(), PAGES, bits); });
+        double h = rate(reps, SPACE, [&] { sink = sink + kv.hash(a.data(), SPACE, 0); });
+        printf("  %-8s %10.1f %10.1f %10.1f\n", kv.name, c, d, h);
+    }
+
+    u64 bits[PAGES / 64];
+    double c = rate(reps, SPACE, [&] { memset(scratch.data(), 0, SPACE); sink = sink + scratch[reps & 0xff]; });
+    double d = rate(reps, 2 * SPACE, [&] { diff_memcmp(a.data(), b.data(), PAGES, bits); });
+    double h = rate(reps / 16 + 1, SPACE, [&] { sink = sink + hash_fnv(a.data(), SPACE); });
+    printf("  %-8s %10.1f %10.1f %10.1f   (memset, memcmp per page, FNV-1a)\n", "libc", c, d, h);
+    if (memcmp(bits, want_bits, sizeof(bits)) != 0)
+        printf("  memcmp diff disagrees\n"), wrong++;
+
+    // position matters: swapping two stripes changes the hash
+    u64 before = bulk_hash(a.data(), SPACE);
+    std::swap_ranges(a.begin(), a.begin() + 64, a.begin() + 4096);
+    if (bulk_hash(a.data(), SPACE) == before)
+        printf("  hash ignores stripe order\n"), wrong++;
+
+    printf("  %d disagreements\n", wrong);
+    return wrong ? 1 : 0;
+}
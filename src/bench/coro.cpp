@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "bench/bench.h"
+#include "sim/node.h"
+
+// Every node sends a counter to the next node of a ring and adds one to
+// what it receives from the previous one.
+static const u8 ring_program[] = {
+    0x3E, 0x00,       // MVI A,0
+    0xD3, 0x10,       // loop: OUT 10h   link 0 -> next
+    0xDB, 0x12,       // IN 12h          link 1 <- previous
+    0x3C,             // INR A
+    0xC3, 0x02, 0x00, // JMP loop
+};
+
+// Drives a ring of machines from one thread with the coroutine scheduler.
+int bench_coro(int argc, char** argv) {
+    int nodes = 1024;
+    u64 cycles = 2000000;
+    Scheduler sched;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--nodes") && i + 1 < argc)
+            nodes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--quantum") && i + 1 < argc)
+            sched.quantum = strtoull(argv[++i], nullptr, 0);
+    }
+    if (nodes < 2)
+        nodes = 2;
+
+    std::unique_ptr<Node[]> ring(new Node[nodes]);
+    std::unique_ptr<Pipe[]> pipes(new Pipe[2 * nodes]);
+    for (int i = 0; i < nodes; i++) {
+        ring[i].reset(sched);
+        std::memcpy(ring[i].mem.data, ring_program, sizeof(ring_program));
+    }
+    for (int i = 0; i < nodes; i++)
+        connect(ring[i], 0, ring[(i + 1) % nodes], 1, pipes[2 * i], pipes[2 * i + 1]);
+
+    std::vector<MachineTask> tasks;
+    tasks.reserve(nodes);
+    for (int i = 0; i < nodes; i++) {
+        tasks.push_back(run_node(ring[i], cycles));
+        sched.wake(tasks.back().h);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    sched.run();
+    double s = seconds_since(t0);
+
+    u64 total_cycles = 0, sent = 0, blocks = 0;
+    int finished = 0;
+    for (int i = 0; i < nodes; i++) {
+        total_cycles += ring[i].cpu.cycles;
+        sent += ring[i].sent;
+        blocks += ring[i].blocks;
+        finished += tasks[i].done();
+    }
+
+    printf("%d nodes x %llu cycles, quantum %llu, 1 thread: %.3f s\n", nodes, (unsigned long long)cycles,
+           (unsigned long long)sched.quantum, s);
+    printf("  %.1f M emulated cycles/s  %.2f M bytes/s over links  %.2f M resumes/s\n",
+           total_cycles / s / 1e6, sent / s / 1e6, sched.resumes / s / 1e6);
+    printf("  %llu link waits, %d of %d machines finished, %.0f MiB of machine state\n",
+           (unsigned long long)blocks, finished, nodes, nodes * sizeof(Node) / 1048576.0);
+    return finished == nodes ? 0 : 1;
+}
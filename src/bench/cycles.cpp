@@ -0,0 +1,80 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "util/isa.h"
+
+// Published totals for the bundled test ROMs, measured with a harness that
+// services BDOS with OUT + RET at 0x0005 and stops on OUT at 0x0000. Our
+// trap executes neither, so those cycles are added back before comparing.
+struct Reference {
+    const char* rom;
+    u64 cycles;
+};
+
+static const Reference references[] = {
+    {"roms/testing/TST8080.COM", 4924},
+    {"roms/testing/CPUTEST.COM", 255653383},
+};
+
+static constexpr u64 BDOS_TRAP_CYCLES = 10 + 10; // OUT + RET
+static constexpr u64 EXIT_TRAP_CYCLES = 10;      // OUT
+
+// Runs each bundled ROM to completion and compares its emulated cycle total
+// against the reference.
+int bench_cycles(int argc, char** argv) {
+    u64 max_cycles = 1ull << 34;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            max_cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "-v"))
+            verbose = true;
+    }
+
+    std::unique_ptr<Memory> mem(new Memory);
+    Console con{verbose ? stdout : nullptr};
+    int failures = 0;
+    printf("interpreter build: %s\n", isa_level());
+
+    for (const Reference& ref : references) {
+        std::vector<u8> image;
+        if (!readROM(ref.rom, image))
+            return 1;
+
+        CPU cpu;
+        boot_com(cpu, *mem, image);
+        u64 instructions = 0, bdos_calls = 0;
+        bool exited = false;
+        auto t0 = std::chrono::steady_clock::now();
+        while (cpu.cycles < max_cycles) {
+            if (cpu.step() == 0)
+                break;
+            instructions++;
+            if (cpu.pc == BDOS_ENTRY) {
+                bdos_calls++;
+                if (bdos_call(cpu, con) == BDOS_EXIT) {
+                    exited = true;
+                    break;
+                }
+            }
+            if (cpu.pc == WARM_BOOT) {
+                exited = true;
+                break;
+            }
+        }
+        double s = seconds_since(t0);
+
+        u64 total = cpu.cycles + bdos_calls * BDOS_TRAP_CYCLES + EXIT_TRAP_CYCLES;
+        bool ok = exited && total == ref.cycles;
+        failures += !ok;
+        printf("%-28s %12llu insns %14llu cycles  ref %14llu  %s (%.2f s, %.0f MHz)\n", ref.rom,
+               (unsigned long long)instructions, (unsigned long long)total,
+               (unsigned long long)ref.cycles, ok ? "ok" : exited ? "MISMATCH" : "DID NOT EXIT", s,
+               s > 0 ? cpu.cycles / s / 1e6 : 0.0);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "serve/server.h"
+
+int daemon_connect(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    for (int tries = 0; tries < 1000; tries++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+        usleep(1000); // server still starting
+    }
+    return -1;
+}
+
+// Reads one "OK <len> ..." response and its payload.
+bool daemon_reply(int fd, std::string& buf, std::string& head, std::string& payload) {
+    char tmp[65536];
+    size_t eol;
+    while ((eol = buf.find('\n')) == std::string::npos) {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0)
+            return false;
+        buf.append(tmp, n);
+    }
+    head = buf.substr(0, eol);
+    buf.erase(0, eol + 1);
+    size_t len = 0;
+    if (sscanf(head.c_str(), "OK %zu", &len) != 1)
+        return false;
+    while (buf.size() < len) {
+        ssize_t n = recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0)
+            return false;
+        buf.append(tmp, n);
+    }
+    payload = buf.substr(0, len);
+    buf.erase(0, len);
+    return true;
+}
+
+static double percentile(std::vector<double>& v, double p) {
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[std::min(v.size() - 1, size_t(p * v.size()))];
+}
+
+// Sends requests for a short program to an in-process emud and compares the
+// round trip with loading and running the program from scratch each time.
+int bench_daemon(int argc, char** argv) {
+    const char* rom = "roms/testing/TST8080.COM";
+    int requests = 2000, workers = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--requests") && i + 1 < argc)
+            requests = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else
+            rom = argv[i];
+    }
+
+    RomImage image;
+    image.name = "bench";
+    if (!readROM(rom, image.bytes) || image.bytes.size() > 0x10000 - 0x100)
+        return 1;
+
+    // what a process per request does once it is running
+    std::vector<double> cold;
+    for (int i = 0; i < std::min(requests, 200); i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<u8> bytes;
+        readROM(rom, bytes);
+        std::unique_ptr<Memory> mem(new Memory);
+        CPU cpu;
+        boot_com(cpu, *mem, bytes);
+        std::string out;
+        Console con{nullptr, &out};
+        run_com(cpu, con, 10000000);
+        cold.push_back(seconds_since(t0) * 1e6);
+    }
+
+    ServeConfig cfg;
+    cfg.socket_path = "/tmp/emud-bench-" + std::to_string(getpid()) + ".sock";
+    cfg.workers = workers;
+    Server* s = server_create(cfg, {image});
+    std::thread loop([s] { server_run(s); });
+
+    int fd = daemon_connect(cfg.socket_path);
+    if (fd < 0) {
+        printf("cannot connect to %s\n", cfg.socket_path.c_str());
+        server_stop(s);
+        loop.join();
+        server_destroy(s);
+        return 1;
+    }
+
+    std::vector<double> warm;
+    std::string buf, head, payload, first;
+    const char req[] = "RUN bench\n";
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; i++) {
+        auto r0 = std::chrono::steady_clock::now();
+        if (send(fd, req, sizeof(req) - 1, 0) < 0 || !daemon_reply(fd, buf, head, payload))
+            break;
+        warm.push_back(seconds_since(r0) * 1e6);
+        if (i == 0)
+            first = head;
+    }
+    double total = seconds_since(t0);
+
+    send(fd, "STATS\n", 6, 0);
+    daemon_reply(fd, buf, head, payload);
+    close(fd);
+    server_stop(s);
+    loop.join();
+    server_destroy(s);
+
+    printf("%s: first reply \"%s\"\n", rom, first.c_str());
+    printf("in-process load+run p50 %8.1f us  p99 %8.1f us\n", percentile(cold, 0.5), percentile(cold, 0.99));
+    printf("emud round trip     p50 %8.1f us  p99 %8.1f us  (%zu requests, %.0f req/s)\n", percentile(warm, 0.5),
+           percentile(warm, 0.99), warm.size(), warm.size() / total);
+    printf("%s", payload.c_str());
+    return warm.size() == size_t(requests) ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "cpm/bios.h"
+
+// Reads every sector of drive A through the BIOS entry points, forever.
+static std::vector<u8> sweep_program(const DiskFormat& f) {
+    auto lo = [](BiosEntry e) { return u8(bios_entry(e) & 0xFF); };
+    auto hi = [](BiosEntry e) { return u8(bios_entry(e) >> 8); };
+    return {
+        0x31, 0x00, u8(BIOS_BASE >> 8),                  // 0100 LXI SP,BIOS_BASE
+        0x0E, 0x00,                                      // 0103 MVI C,0
+        0xCD, lo(BIOS_SELDSK), hi(BIOS_SELDSK),          // 0105 CALL SELDSK
+        0x01, 0x80, 0x00,                                // 0108 LXI B,0080
+        0xCD, lo(BIOS_SETDMA), hi(BIOS_SETDMA),          // 010B CALL SETDMA
+        0x21, 0x00, 0x00,                                // 010E LXI H,0
+        0xE5,                                            // 0111 trk: PUSH H
+        0x44, 0x4D,                                      // 0112 MOV B,H / MOV C,L
+        0xCD, lo(BIOS_SETTRK), hi(BIOS_SETTRK),          // 0114 CALL SETTRK
+        0x01, 0x01, 0x00,                                // 0117 LXI B,1
+        0xC5,                                            // 011A sec: PUSH B
+        0xCD, lo(BIOS_SETSEC), hi(BIOS_SETSEC),          // 011B CALL SETSEC
+        0xCD, lo(BIOS_READ), hi(BIOS_READ),              // 011E CALL READ
+        0xC1, 0x03, 0x79,                                // 0121 POP B / INX B / MOV A,C
+        0xFE, u8(f.sectors + 1),                         // 0124 CPI sectors+1
+        0xC2, 0x1A, 0x01,                                // 0126 JNZ sec
+        0xE1, 0x23, 0x7D,                                // 0129 POP H / INX H / MOV A,L
+        0xFE, u8(f.tracks),                              // 012C CPI tracks
+        0xC2, 0x11, 0x01,                                // 012E JNZ trk
+        0xC3, 0x0E, 0x01,                                // 0131 JMP 010E
+    };
+}
+
+static long rss_bytes() {
+    long pages = 0, resident = 0;
+    if (FILE* f = fopen("/proc/self/statm", "r")) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Blank IBM 3740 image whose sectors start with their track and sector.
+static bool make_image(const char* path) {
+    const DiskFormat& f = *find_disk_format("ibm-3740", 0);
+    FILE* out = fopen(path, "wb");
+    if (!out)
+        return false;
+    u8 sector[CPM_SECTOR];
+    for (int t = 0; t < f.tracks; t++)
+        for (int s = 1; s <= f.sectors; s++) {
+            std::memset(sector, 0xE5, sizeof(sector));
+            sector[0] = t;
+            sector[1] = s;
+            fwrite(sector, 1, sizeof(sector), out);
+        }
+    fclose(out);
+    return true;
+}
+
+struct DiskInstance {
+    Memory mem;
+    DiskOverlay disk;
+    Bios bios;
+};
+
+// Sector access through the BIOS traps and the overlay, and the memory
+// cost of many instances sharing one mapped image.
+int bench_disk(int argc, char** argv) {
+    std::string path;
+    int instances = 2000, dirty = 8;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--instances") && i + 1 < argc)
+            instances = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--dirty") && i + 1 < argc)
+            dirty = atoi(argv[++i]);
+        else
+            path = argv[i];
+    }
+
+    bool temp = path.empty();
+    if (temp) {
+        path = "/tmp/cpm-bench-" + std::to_string(getpid()) + ".img";
+        if (!make_image(path.c_str()))
+            return 1;
+    }
+    DiskImage image;
+    bool ok = image.open(path.c_str());
+    if (temp)
+        unlink(path.c_str()); // the mapping stays valid
+    if (!ok)
+        return 1;
+    const DiskFormat& f = *image.format;
+    u32 sectors = u32(image.size / CPM_SECTOR);
+    printf("%s: %s, %u tracks x %u sectors, %zu KiB mapped\n", temp ? "generated image" : path.c_str(), f.name,
+           f.tracks, f.sectors, image.size / 1024);
+
+    // 8080 program sweeping the disk through SETTRK/SETSEC/READ
+    {
+        std::unique_ptr<DiskInstance> in(new DiskInstance);
+        in->mem.reset();
+        in->disk.attach(image);
+        in->bios.drive[0] = &in->disk;
+        bios_install(in->mem, in->bios);
+        std::vector<u8> prog = sweep_program(f);
+        std::memcpy(in->mem.data + 0x100, prog.data(), prog.size());
+        CPU cpu;
+        cpu.mem = &in->mem;
+        cpu.reset();
+        cpu.pc = 0x100;
+        Console quiet{nullptr};
+
+        auto t0 = std::chrono::steady_clock::now();
+        run_com(cpu, quiet, 200000000, &in->bios);
+        double s = seconds_since(t0);
+        // generated sectors name their own position; check the last one read
+        const u8* dma = in->mem.data + 0x80;
+        bool match = !temp || (dma[0] < f.tracks && dma[1] >= 1 && dma[1] <= f.sectors &&
+                               std::memcmp(dma, in->disk.read_sector(dma[0] * f.sectors + dma[1] - 1),
+                                           CPM_SECTOR) == 0);
+        printf("BIOS READ from 8080 code: %llu sectors, %.0f ns/sector (incl. emulated loop), data %s\n",
+               (unsigned long long)in->bios.reads, s / in->bios.reads * 1e9, match ? "ok" : "WRONG");
+    }
+
+    // overlay access from C
+    {
+        DiskOverlay disk;
+        disk.attach(image);
+        std::mt19937 rng(1);
+        std::vector<u32> order(1 << 20);
+        for (u32& x : order)
+            x = rng() % sectors;
+        u8 buf[CPM_SECTOR] = {};
+        u64 sum = 0;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (u32 lsn : order)
+            sum += disk.read_sector(lsn)[0];
+        double rd = seconds_since(t0) / order.size();
+
+        t0 = std::chrono::steady_clock::now();
+        for (u32 i = 0; i < sectors; i++)
+            disk.write_sector(i, buf);
+        double first = seconds_since(t0) / sectors;
+
+        t0 = std::chrono::steady_clock::now();
+        for (u32 lsn : order)
+            disk.write_sector(lsn, buf);
+        double again = seconds_since(t0) / order.size();
+        printf("random read %.1f ns, first write (copies chunk) %.1f ns, later write %.1f ns  [%llu]\n", rd * 1e9,
+               first * 1e9, again * 1e9, (unsigned long long)(sum & 1));
+    }
+
+    // many instances on one image
+    {
+        long before = rss_bytes();
+        std::vector<std::unique_ptr<DiskInstance>> pool;
+        size_t owned = 0;
+        u8 buf[CPM_SECTOR];
+        std::memset(buf, 0x5A, sizeof(buf));
+        for (int i = 0; i < instances; i++) {
+            pool.emplace_back(new DiskInstance);
+            DiskInstance& in = *pool.back();
+            in.mem.reset();
+            in.disk.attach(image);
+            in.bios.drive[0] = &in.disk;
+            bios_install(in.mem, in.bios);
+            for (int d = 0; d < dirty; d++)
+                in.disk.write_sector((u32(i) * 7 + d * 37) % sectors, buf);
+            owned += sizeof(DiskInstance) + in.disk.private_bytes();
+        }
+        long grown = rss_bytes() - before;
+        double per = double(grown > 0 ? grown : owned) / instances;
+        printf("%d instances, %d sectors written each: %.1f KiB/instance resident, %.0f instances/GB "
+               "(private copies: %.0f)\n",
+               instances, dirty, per / 1024, 1e9 / per, 1e9 / (sizeof(Memory) + image.size));
+    }
+    return 0;
+}
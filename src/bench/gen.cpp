@@ -0,0 +1,63 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "gen/gen.h"
+#include "perf/perf.h"
+
+// Generates every preset and runs it on the core to its BDOS exit: the
+// cycles against the profile's estimate, the opcode class mix and the speed.
+int bench_gen(int argc, char** argv) {
+    u64 cycles = 50000000;
+    u64 seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 0);
+    }
+
+    std::unique_ptr<Memory> mem(new Memory);
+    int n, failures = 0;
+    const GenProfile* presets = gen_presets(&n);
+    printf("%-12s %6s %10s %7s", "preset", "bytes", "insns", "cycles");
+    for (int c = 0; c < OPC_CLASSES; c++)
+        printf(" %6s", op_class_name(c));
+    printf(" %8s\n", "MHz");
+    for (int k = 0; k < n; k++) {
+        GenProfile p = presets[k];
+        p.cycles = cycles;
+        std::vector<u8> image = gen_rom(p, seed);
+        if (image.empty()) {
+            printf("%-12s does not generate\n", p.name);
+            failures++;
+            continue;
+        }
+        CPU cpu;
+        boot_com(cpu, *mem, image);
+        Console con{nullptr};
+        u64 mix[OPC_CLASSES] = {}, insns = 0;
+        bool exited = false;
+        auto t0 = std::chrono::steady_clock::now();
+        while (cpu.cycles < cycles * 4) {
+            mix[op_class(mem->data[cpu.pc])]++;
+            if (cpu.step() == 0)
+                break;
+            insns++;
+            if ((cpu.pc == BDOS_ENTRY && bdos_call(cpu, con) == BDOS_EXIT) || cpu.pc == WARM_BOOT) {
+                exited = true;
+                break;
+            }
+        }
+        double s = seconds_since(t0);
+        failures += !exited;
+        printf("%-12s %6zu %10llu %6.2fx", p.name, image.size(), (unsigned long long)insns,
+               double(cpu.cycles) / cycles);
+        for (int c = 0; c < OPC_CLASSES; c++)
+            printf(" %5.1f%%", 100.0 * mix[c] / insns);
+        printf(" %8.0f%s\n", cpu.cycles / s / 1e6, exited ? "" : "  DID NOT EXIT");
+    }
+    return failures ? 1 : 0;
+}
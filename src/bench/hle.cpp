@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "bench/bench.h"
+#include "bulk/bulk.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "hle/hle.h"
+
+// Machine state at a BDOS call, where all three runs must agree.
+struct SyncPoint {
+    u64 cycles;
+    u64 regs;
+    u64 mem;
+};
+
+static SyncPoint sync_point(const CPU& cpu) {
+    u8 r[12] = {cpu.a, cpu.b, cpu.c, cpu.d, cpu.e, cpu.h, cpu.l, cpu.flags.f, u8(cpu.sp), u8(cpu.sp >> 8),
+                u8(cpu.pc), u8(cpu.pc >> 8)};
+    u64 regs = 0;
+    for (u8 v : r)
+        regs = (regs ^ v) * 1099511628211ull;
+    return {cpu.cycles, regs, bulk_hash(cpu.mem->data, 0x10000)};
+}
+
+struct Outcome {
+    std::vector<SyncPoint> syncs;
+    std::string output;
+    double seconds;
+};
+
+static Outcome run(const std::vector<u8>& image, u64 max_cycles, Hle* hle) {
+    std::unique_ptr<Memory> mem(new Memory);
+    CPU cpu;
+    boot_com(cpu, *mem, image);
+    Outcome o;
+    Console con;
+    con.capture = &o.output;
+    auto t0 = std::chrono::steady_clock::now();
+    while (cpu.cycles < max_cycles) {
+        if ((hle ? hle_step(*hle, cpu) : cpu.step()) == 0)
+            break;
+        if (cpu.pc == BDOS_ENTRY) {
+            o.syncs.push_back(sync_point(cpu));
+            if (bdos_call(cpu, con) == BDOS_EXIT)
+                break;
+        }
+        if (cpu.pc == WARM_BOOT)
+            break;
+    }
+    o.seconds = seconds_since(t0);
+    o.syncs.push_back(sync_point(cpu)); // the end, if the program finished
+    if (cpu.cycles >= max_cycles)
+        o.syncs.pop_back();
+    return o;
+}
+
+// Whether b saw the same sync points as a, up to where the shorter run
+// stopped.
+static bool agree(const Outcome& a, const Outcome& b) {
+    size_t n = std::min(a.syncs.size(), b.syncs.size());
+    for (size_t i = 0; i < n; i++)
+        if (memcmp(&a.syncs[i], &b.syncs[i], sizeof(SyncPoint)) != 0)
+            return false;
+    return a.syncs.size() - n <= 1 && b.syncs.size() - n <= 1;
+}
+
+// Runs a .COM program (8080EXER by default) plain, with native subroutines
+// and with verification, and checks the three agree at every BDOS call.
+int bench_hle(int argc, char** argv) {
+    const char* rom = "roms/testing/8080EXER.COM";
+    u64 max_cycles = 3000000000ull;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            max_cycles = strtoull(argv[++i], nullptr, 0);
+        else
+            rom = argv[i];
+    }
+    std::vector<u8> image;
+    if (!readROM(rom, image))
+        return 1;
+
+    Outcome plain = run(image, max_cycles, nullptr);
+    Hle fast;
+    Outcome native = run(image, max_cycles, &fast);
+    Hle checked;
+    checked.verify = true;
+    Outcome verified = run(image, max_cycles, &checked);
+
+    printf("%s: %zu BDOS calls in %.1fM cycles\n", rom, plain.syncs.size(), max_cycles / 1e6);
+    int n;
+    const HleRoutine* routines = hle_registry(&n);
+    u64 mismatches = 0;
+    for (int i = 0; i < n; i++) {
+        const HleStats& s = fast.stats[i];
+        const HleStats& v = checked.stats[i];
+        mismatches += v.mismatches;
+        printf("  %-26s %10llu calls %5.1f%% of cycles, %llu verified, %llu mismatches\n", routines[i].name,
+               (unsigned long long)s.calls, 100.0 * s.cycles / max_cycles, (unsigned long long)v.verified,
+               (unsigned long long)v.mismatches);
+    }
+    bool same = agree(plain, native) && agree(plain, verified) && plain.output == native.output &&
+                plain.output == verified.output;
+    printf("  interpreter %.2f s, native %.2f s (%.2fx), verifying %.2f s\n", plain.seconds, native.seconds,
+           plain.seconds / native.seconds, verified.seconds);
+    printf("  state at every BDOS call %s\n", same ? "matches" : "DIFFERS");
+    return same && mismatches == 0 ? 0 : 1;
+}
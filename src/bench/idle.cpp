@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "bench/bench.h"
+#include "bulk/bulk.h"
+#include "idle/idle.h"
+#include "machine/invaders.h"
+
+// Invaders-style firmware that idles the way real games do: the main loop
+// waits for the vblank handler to set a flag in RAM, draws a byte, runs an
+// 8-bit and a 16-bit delay loop and then polls the coin input.
+static const u8 idle_rom[] = {
+    /* 0000 */ 0xC3, 0x40, 0x00, 0, 0, 0, 0, 0,                            // JMP start
+    /* 0008 */ 0xC3, 0x20, 0x00, 0, 0, 0, 0, 0,                            // RST 1: JMP 0020
+    /* 0010 */ 0xC3, 0x30, 0x00, 0, 0, 0, 0, 0,                            // RST 2: JMP 0030
+    /* 0018 */ 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0020 */ 0xF5, 0xE5, 0x21, 0xC0, 0x20, 0x34, 0xE1, 0xF1, 0xFB, 0xC9, // INR (20C0)
+    /* 002A */ 0, 0, 0, 0, 0, 0,
+    /* 0030 */ 0xF5, 0x3E, 0x01, 0x32, 0xC2, 0x20, 0xF1, 0xFB, 0xC9,       // (20C2) = 1
+};
+
+static const u8 idle_main[] = {
+    /* 0040 */ 0x31, 0x00, 0x24, // LXI SP,2400
+    /* 0043 */ 0xFB,             // EI
+    /* 0044 */ 0x3A, 0xC2, 0x20, // wait: LDA 20C2
+    /* 0047 */ 0xB7,             // ORA A
+    /* 0048 */ 0xCA, 0x44, 0x00, // JZ wait
+    /* 004B */ 0xAF,             // XRA A
+    /* 004C */ 0x32, 0xC2, 0x20, // STA 20C2
+    /* 004F */ 0x2A, 0xC4, 0x20, // LHLD 20C4
+    /* 0052 */ 0x3A, 0xC0, 0x20, // LDA 20C0
+    /* 0055 */ 0x77,             // MOV M,A
+    /* 0056 */ 0x23,             // INX H
+    /* 0057 */ 0x7C,             // MOV A,H
+    /* 0058 */ 0xE6, 0x1F,       // ANI 1F
+    /* 005A */ 0xF6, 0x24,       // ORI 24
+    /* 005C */ 0x67,             // MOV H,A
+    /* 005D */ 0x22, 0xC4, 0x20, // SHLD 20C4
+    /* 0060 */ 0x06, 0xC8,       // MVI B,200
+    /* 0062 */ 0x05,             // d1: DCR B
+    /* 0063 */ 0xC2, 0x62, 0x00, // JNZ d1
+    /* 0066 */ 0x11, 0xE8, 0x03, // LXI D,1000
+    /* 0069 */ 0x1B,             // d2: DCX D
+    /* 006A */ 0x7A,             // MOV A,D
+    /* 006B */ 0xB3,             // ORA E
+    /* 006C */ 0xC2, 0x69, 0x00, // JNZ d2
+    /* 006F */ 0xDB, 0x01,       // coin: IN 1
+    /* 0071 */ 0xE6, 0x01,       // ANI 01
+    /* 0073 */ 0xCA, 0x6F, 0x00, // JZ coin
+    /* 0076 */ 0xC3, 0x44, 0x00, // JMP wait
+};
+
+static bool boot(Invaders& m, const char* rom) {
+    if (rom) {
+        if (!m.load(rom))
+            return false;
+    } else {
+        m.mem.reset();
+        std::memcpy(m.mem.data, idle_rom, sizeof(idle_rom));
+        std::memcpy(m.mem.data + 0x40, idle_main, sizeof(idle_main));
+        m.mem.data[0x20C5] = 0x24; // draw pointer 2400
+    }
+    m.reset();
+    return true;
+}
+
+// the coin is held every third frame
+static u8 input(int frame) { return frame % 3 == 0 ? INV_COIN : 0; }
+
+static bool same_state(const Invaders& a, const Invaders& b) {
+    const CPU& x = a.cpu;
+    const CPU& y = b.cpu;
+    return x.cycles == y.cycles && x.pc == y.pc && x.sp == y.sp && x.a == y.a && x.b == y.b && x.c == y.c &&
+           x.d == y.d && x.e == y.e && x.h == y.h && x.l == y.l && x.flags.f == y.flags.f && x.inte == y.inte &&
+           x.halted == y.halted && bulk_hash(a.mem.data, 0x10000) == bulk_hash(b.mem.data, 0x10000);
+}
+
+static double timed_run(Invaders& m, int frames, bool idle) {
+    m.idle.enabled = idle;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        m.port1 = input(f);
+        if (!m.run_frame())
+            return -1;
+    }
+    return seconds_since(t0);
+}
+
+// A flag poll entered with A holding something else: the first pass
+// loads A, and only from the second is the loop a fixed point. Run alone
+// against plain stepping, then released by setting the flag.
+static bool poll_entered_dirty() {
+    static const u8 code[] = {
+        /* 0000 */ 0x3A, 0x00, 0x30, // poll: LDA 3000
+        /* 0003 */ 0xB7,             // ORA A
+        /* 0004 */ 0xCA, 0x00, 0x00, // JZ poll
+        /* 0007 */ 0x76,             // HLT
+        /* 0008 */ 0x3E, 0x55,       // start: MVI A,55
+        /* 000A */ 0xC3, 0x00, 0x00, // JMP poll
+    };
+    std::unique_ptr<Memory> ma(new Memory), mb(new Memory);
+    CPU a, b;
+    a.mem = ma.get();
+    b.mem = mb.get();
+    for (CPU* c : {&a, &b}) {
+        c->mem->reset();
+        std::memcpy(c->mem->data, code, sizeof(code));
+        c->reset();
+        c->pc = 0x0008;
+    }
+    IdleSkip idle, off;
+    off.enabled = false;
+    bool same = true;
+    for (u64 target : {100000ull, 200000ull}) {
+        idle_run(idle, a, target);
+        idle_run(off, b, target);
+        same &= a.cycles == b.cycles && a.pc == b.pc && a.a == b.a && a.flags.f == b.flags.f && a.halted == b.halted;
+        ma->data[0x3000] = mb->data[0x3000] = 1; // the event ending the wait
+    }
+    bool skipped = idle.spins > 0 && idle.saved > 50000;
+    printf("poll entered with A=55: %.1f%% of %.1fk cycles skipped, %s\n", 100.0 * idle.saved / a.cycles,
+           a.cycles / 1e3, !skipped ? "NOT SKIPPED" : same && a.halted ? "matches stepping" : "DIFFERS FROM STEPPING");
+    return skipped && same && a.halted;
+}
+
+// Runs the board with and without idle-loop skipping: in lockstep to check
+// that every frame ends in the same state, then each alone for speed.
+int bench_idle(int argc, char** argv) {
+    const char* rom = nullptr;
+    int frames = 3600;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else
+            rom = argv[i];
+    }
+
+    bool poll_ok = poll_entered_dirty();
+
+    std::unique_ptr<Invaders> plain(new Invaders), fast(new Invaders);
+    if (!boot(*plain, rom) || !boot(*fast, rom)) {
+        printf("cannot load Space Invaders ROM from %s\n", rom);
+        return 1;
+    }
+    plain->idle.enabled = false;
+    int bad_frame = -1;
+    for (int f = 0; f < frames && bad_frame < 0; f++) {
+        plain->port1 = fast->port1 = input(f);
+        if (!plain->run_frame() || !fast->run_frame() || !same_state(*plain, *fast))
+            bad_frame = f;
+    }
+    const IdleSkip& s = fast->idle;
+    printf("%s: %d frames, %.1fM cycles\n", rom ? rom : "synthetic ROM", frames, fast->cpu.cycles / 1e6);
+    printf("  %llu spins, %llu countdowns, %llu halts skipped; %.1fM cycles (%.1f%%) not executed\n",
+           (unsigned long long)s.spins, (unsigned long long)s.countdowns, (unsigned long long)s.halts,
+           s.saved / 1e6, 100.0 * s.saved / fast->cpu.cycles);
+    if (bad_frame >= 0)
+        printf("  state differs from stepping after frame %d\n", bad_frame);
+    else
+        printf("  every frame matches stepping\n");
+
+    double best[2] = {1e30, 1e30};
+    for (int k = 0; k < 3; k++) {
+        for (int idle = 0; idle < 2; idle++) {
+            boot(*fast, rom);
+            double t = timed_run(*fast, frames, idle);
+            if (t < 0) {
+                printf("  fault at PC=%04X\n", fast->cpu.pc);
+                return 1;
+            }
+            best[idle] = std::min(best[idle], t);
+        }
+    }
+    printf("  stepping  %8.0f frames/s\n", frames / best[0]);
+    printf("  skipping  %8.0f frames/s (%.1fx)\n", frames / best[1], best[0] / best[1]);
+    return bad_frame >= 0 || !poll_ok ? 1 : 0;
+}
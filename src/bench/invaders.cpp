@@ -0,0 +1,100 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "bench/bench.h"
+#include "machine/invaders.h"
+
+// Stand-in for the game ROM, which is not distributed with the emulator:
+// both interrupt handlers count frames, and the main loop keeps rewriting
+// VRAM through the shift register.
+static const u8 synthetic_rom[] = {
+    /* 0000 */ 0xC3, 0x40, 0x00, 0, 0, 0, 0, 0,                            // JMP start
+    /* 0008 */ 0xC3, 0x20, 0x00, 0, 0, 0, 0, 0,                            // RST 1: JMP 0020
+    /* 0010 */ 0xC3, 0x30, 0x00, 0, 0, 0, 0, 0,                            // RST 2: JMP 0030
+    /* 0018 */ 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0020 */ 0xF5, 0xE5, 0x21, 0xC0, 0x20, 0x34, 0xE1, 0xF1, 0xFB, 0xC9, // INR (20C0)
+    /* 002A */ 0, 0, 0, 0, 0, 0,
+    /* 0030 */ 0xF5, 0xE5, 0x21, 0xC1, 0x20, 0x34, 0xE1, 0xF1, 0xFB, 0xC9, // INR (20C1)
+};
+
+static const u8 synthetic_main[] = {
+    /* 0040 */ 0x31, 0x00, 0x24, // LXI SP,2400
+    /* 0043 */ 0xFB,             // EI
+    /* 0044 */ 0x21, 0x00, 0x24, // loop: LXI H,2400
+    /* 0047 */ 0x3A, 0xC1, 0x20, // inner: LDA 20C1
+    /* 004A */ 0x47,             // MOV B,A
+    /* 004B */ 0xD3, 0x04,       // OUT 4
+    /* 004D */ 0x7D,             // MOV A,L
+    /* 004E */ 0xD3, 0x04,       // OUT 4
+    /* 0050 */ 0x3E, 0x03,       // MVI A,3
+    /* 0052 */ 0xD3, 0x02,       // OUT 2
+    /* 0054 */ 0xDB, 0x03,       // IN 3
+    /* 0056 */ 0xA8,             // XRA B
+    /* 0057 */ 0x77,             // MOV M,A
+    /* 0058 */ 0x23,             // INX H
+    /* 0059 */ 0x7C,             // MOV A,H
+    /* 005A */ 0xFE, 0x40,       // CPI 40
+    /* 005C */ 0xC2, 0x47, 0x00, // JNZ inner
+    /* 005F */ 0xC3, 0x44, 0x00, // JMP loop
+};
+
+// Runs the Space Invaders board headless and reports emulated frames per
+// second with and without the lazy renderer.
+int bench_invaders(int argc, char** argv) {
+    const char* rom = nullptr;
+    int frames = 3600;
+    bool render = true;
+    bool idle = true;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--no-render"))
+            render = false;
+        else if (!strcmp(argv[i], "--no-idle"))
+            idle = false;
+        else
+            rom = argv[i];
+    }
+
+    std::unique_ptr<Invaders> m(new Invaders);
+    if (rom) {
+        if (!m->load(rom)) {
+            printf("cannot load Space Invaders ROM from %s\n", rom);
+            return 1;
+        }
+    } else {
+        m->mem.reset();
+        std::memcpy(m->mem.data, synthetic_rom, sizeof(synthetic_rom));
+        std::memcpy(m->mem.data + 0x40, synthetic_main, sizeof(synthetic_main));
+    }
+    m->reset();
+    m->idle.enabled = idle;
+
+    u64 rows = 0;
+    double render_s = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        if (!m->run_frame()) {
+            printf("fault at PC=%04X, opcode %02X\n", m->cpu.pc, m->mem.data[m->cpu.pc]);
+            return 1;
+        }
+        if (render) {
+            auto r0 = std::chrono::steady_clock::now();
+            rows += m->render();
+            render_s += seconds_since(r0);
+        }
+    }
+    double s = seconds_since(t0);
+
+    printf("%s: %d frames in %.3f s\n", rom ? rom : "synthetic ROM", frames, s);
+    printf("  %.0f frames/s (%.1fx real time)  %.1f MHz emulated\n", frames / s, frames / s / 60,
+           m->cpu.cycles / s / 1e6);
+    if (render)
+        printf("  render %.1f%% of run time, %.1f dirty rows/frame, %.2f us/row\n", 100 * render_s / s,
+               double(rows) / frames, rows ? render_s / rows * 1e6 : 0.0);
+    if (idle)
+        printf("  idle loops: %llu skipped, %.1f%% of cycles\n", (unsigned long long)m->idle.hits(),
+               100.0 * m->idle.saved / m->cpu.cycles);
+    return 0;
+}
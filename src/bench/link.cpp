@@ -0,0 +1,93 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include "bench/bench.h"
+#include "sim/link.h"
+
+// Sends bursts of 128 bytes and adds up the echoes in D.
+static const u8 ping_program[] = {
+    0x0E, 0x80,       // burst: MVI C,80h
+    0x79,             // send: MOV A,C
+    0xD3, 0x10,       // OUT 10h
+    0x0D,             // DCR C
+    0xC2, 0x02, 0x00, // JNZ send
+    0x0E, 0x80,       // MVI C,80h
+    0xDB, 0x10,       // recv: IN 10h
+    0x82,             // ADD D
+    0x57,             // MOV D,A
+    0x0D,             // DCR C
+    0xC2, 0x0B, 0x00, // JNZ recv
+    0xC3, 0x00, 0x00, // JMP burst
+};
+
+// Returns every byte plus one.
+static const u8 pong_program[] = {
+    0xDB, 0x10,       // loop: IN 10h
+    0x3C,             // INR A
+    0xD3, 0x10,       // OUT 10h
+    0xC3, 0x00, 0x00, // JMP loop
+};
+
+struct PairResult {
+    u64 bytes;
+    u64 ping_cycles, pong_cycles;
+    u8 checksum;
+    u64 host_waits;
+    double seconds;
+};
+
+static PairResult run_pair(u64 cycles, u64 latency) {
+    std::unique_ptr<Memory> mem_a(new Memory), mem_b(new Memory);
+    std::unique_ptr<SerialLink> a_to_b(new SerialLink), b_to_a(new SerialLink);
+    a_to_b->latency = b_to_a->latency = latency;
+
+    CPU a, b;
+    mem_a->reset();
+    mem_b->reset();
+    std::memcpy(mem_a->data, ping_program, sizeof(ping_program));
+    std::memcpy(mem_b->data, pong_program, sizeof(pong_program));
+    a.mem = mem_a.get();
+    b.mem = mem_b.get();
+    a.reset();
+    b.reset();
+
+    SerialPort pa, pb;
+    pa.attach(a, b_to_a.get(), a_to_b.get());
+    pb.attach(b, a_to_b.get(), b_to_a.get());
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread pong([&] { run_linked(b, pb, ~0ull); });
+    run_linked(a, pa, cycles);
+    pong.join();
+
+    return PairResult{pa.sent + pb.sent, a.cycles, b.cycles, a.d, pa.host_waits + pb.host_waits,
+                      seconds_since(t0)};
+}
+
+// Ping-pong between two machines on separate host threads through the
+// cycle-stamped SPSC links; runs twice to check the outcome is repeatable.
+int bench_link(int argc, char** argv) {
+    u64 cycles = 200000000, latency = 100;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--latency") && i + 1 < argc)
+            latency = strtoull(argv[++i], nullptr, 0);
+    }
+    if (latency == 0)
+        latency = 1;
+
+    PairResult r[2];
+    for (PairResult& x : r) {
+        x = run_pair(cycles, latency);
+        printf("%llu bytes in %.3f s: %.2f M bytes/s, %llu host waits\n", (unsigned long long)x.bytes,
+               x.seconds, x.bytes / x.seconds / 1e6, (unsigned long long)x.host_waits);
+    }
+    bool same = r[0].bytes == r[1].bytes && r[0].ping_cycles == r[1].ping_cycles &&
+                r[0].pong_cycles == r[1].pong_cycles && r[0].checksum == r[1].checksum;
+    printf("ping %llu cycles, pong %llu cycles, checksum %02X: %s\n", (unsigned long long)r[0].ping_cycles,
+           (unsigned long long)r[0].pong_cycles, r[0].checksum, same ? "repeatable" : "DIFFERS BETWEEN RUNS");
+    return same ? 0 : 1;
+}
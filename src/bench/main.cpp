@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <cstring>
+#include "bench/bench.h"
+
+struct Mode {
+    const char* name;
+    int (*run)(int argc, char** argv);
+    const char* help;
+};
+
+static const Mode modes[] = {
+    {"cycles", bench_cycles, "[--cycles N] [-v]  total cycles of the bundled test ROMs vs reference"},
+    {"coro", bench_coro, "[--nodes N] [--cycles N] [--quantum N]  ring of coroutine machines on one thread"},
+    {"link", bench_link, "[--cycles N] [--latency N]  ping-pong pair over SPSC serial links"},
+    {"disk", bench_disk, "[image] [--instances N] [--dirty N]  BIOS sector access and COW overlay cost"},
+    {"rewind", bench_rewind, "[--cycles N] [--interval N] [--budget MB] [--steps N]  time travel by checkpoints"},
+    {"replay", bench_replay, "[--frames N]  record/replay overhead and fidelity on the Invaders board"},
+    {"bulk", bench_bulk, "[--reps N]  clear/diff/hash kernels per ISA on 64 KiB images"},
+    {"idle", bench_idle, "[rom|dir] [--frames N]  spin-loop skipping vs stepping on the Invaders board"},
+    {"hle", bench_hle, "[program.com] [--cycles N]  native subroutines vs the interpreter"},
+    {"perf", bench_perf, "[program.com] [--cycles N]  host performance counters per emulated instruction"},
+    {"gen", bench_gen, "[--cycles N] [--seed N]  generated workloads: every preset run to its exit"},
+    {"pool", bench_pool, "[program.com] [-j N] [--runs N] [--cycles N]  batch runs: heap vs pooled vs NUMA-placed instances"},
+    {"metrics", bench_metrics, "[-j N] [--runs N]  per-thread counters: totals under concurrent scrapes, cost per event"},
+    {"merkle", bench_merkle, "[program.com...] [--instances N] [--every CYCLES] [--cycles N]  page hash trees: compares, snapshot dedupe"},
+    {"memo", bench_memo, "[program.com...] [--repeats N]  emud result cache: repeats, restart, stale entry sampling"},
+    {"daemon", bench_daemon, "[rom] [--requests N] [-j N]  emud round trip vs loading per request"},
+    {"invaders", bench_invaders, "[rom|dir] [--frames N] [--no-render] [--no-idle]  headless Space Invaders board"},
+    {"wide", bench_wide, "[rom] [--instances N] [--cycles N] [--poke ADDR]  scalar core vs WideCPU lanes"},
+};
+
+void boot_com(CPU& cpu, Memory& mem, const std::vector<u8>& image) {
+    mem.reset();
+    std::memcpy(mem.data + 0x100, image.data(), image.size());
+    cpu.mem = &mem;
+    cpu.reset();
+    cpu.pc = 0x100;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2)
+        for (const Mode& m : modes)
+            if (std::strcmp(argv[1], m.name) == 0)
+                return m.run(argc - 1, argv + 1);
+
+    printf("Usage: %s <mode> [options]\n", argv[0]);
+    for (const Mode& m : modes)
+        printf("  %-8s %s\n", m.name, m.help);
+    return 1;
+}
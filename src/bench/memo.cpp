@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "memo/memo.h"
+#include "serve/server.h"
+
+// An in-process emud with the cache at path, and one connection to it.
+struct Daemon {
+    Server* server = nullptr;
+    std::thread loop;
+    int fd = -1;
+    std::string buf;
+
+    bool start(const std::vector<RomImage>& roms, const std::string& socket, const std::string& path, double verify) {
+        ServeConfig cfg;
+        cfg.socket_path = socket;
+        cfg.memo_path = path;
+        cfg.memo_bytes = 16 << 20;
+        cfg.memo_verify = verify;
+        cfg.max_cycles = 1ull << 34;
+        server = server_create(cfg, roms);
+        loop = std::thread([this] { server_run(server); });
+        fd = daemon_connect(socket);
+        return fd >= 0;
+    }
+
+    // Reply head with its run_us field dropped, and the output.
+    bool run(const char* req, std::string& head, std::string& payload, double* us = nullptr) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (send(fd, req, strlen(req), 0) < 0 || !daemon_reply(fd, buf, head, payload))
+            return false;
+        if (us)
+            *us = seconds_since(t0) * 1e6;
+        head.erase(head.find_last_of(' '));
+        return true;
+    }
+
+    std::string stats() {
+        std::string head, payload;
+        send(fd, "STATS\n", 6, 0);
+        daemon_reply(fd, buf, head, payload);
+        size_t at = payload.find("memo ");
+        return at == std::string::npos ? "" : payload.substr(at, payload.find('\n', at) - at);
+    }
+
+    void stop() {
+        if (fd >= 0)
+            close(fd);
+        server_stop(server);
+        loop.join();
+        server_destroy(server);
+    }
+};
+
+static double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v.empty() ? 0 : v[v.size() / 2];
+}
+
+// Repeated RUN requests answered from the cache against running them, a
+// restart that keeps the cache, a planted stale entry caught by sampling,
+// and the cost of the key and the lookup themselves.
+int bench_memo(int argc, char** argv) {
+    std::vector<const char*> paths;
+    int repeats = 2000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--repeats") && i + 1 < argc)
+            repeats = atoi(argv[++i]);
+        else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty())
+        paths = {"roms/testing/TST8080.COM", "roms/testing/CPUTEST.COM"};
+    std::vector<RomImage> roms;
+    for (const char* p : paths) {
+        RomImage r;
+        r.name = "rom" + std::to_string(roms.size());
+        if (!readROM(p, r.bytes) || r.bytes.size() > 0x10000 - 0x100)
+            return 1;
+        roms.push_back(std::move(r));
+    }
+
+    std::string tag = std::to_string(getpid());
+    std::string socket = "/tmp/emud-memo-" + tag + ".sock", path = "/tmp/emud-memo-" + tag + ".cache";
+    unlink(path.c_str());
+    int wrong = 0;
+
+    // a cold cache: the first request runs, the rest are hits
+    Daemon d;
+    if (!d.start(roms, socket, path, 0)) {
+        printf("cannot connect to %s\n", socket.c_str());
+        d.stop();
+        return 1;
+    }
+    std::vector<std::string> want(roms.size());
+    printf("%-28s %12s %12s %10s\n", "", "run (us)", "cached (us)", "speedup");
+    for (size_t r = 0; r < roms.size(); r++) {
+        std::string req = "RUN " + roms[r].name + " 17179869184\n", head, payload;
+        double run_us, us;
+        if (!d.run(req.c_str(), head, payload, &run_us)) {
+            wrong++;
+            continue;
+        }
+        want[r] = head + "\n" + payload;
+        std::vector<double> hits;
+        for (int i = 0; i < repeats; i++) {
+            if (!d.run(req.c_str(), head, payload, &us))
+                break;
+            hits.push_back(us);
+            wrong += head + "\n" + payload != want[r];
+        }
+        printf("%-28s %12.1f %12.2f %9.0fx\n", paths[r], run_us, median(hits), run_us / median(hits));
+    }
+    // another budget is another job
+    std::string head, payload;
+    d.run(("RUN " + roms[0].name + " 1000\n").c_str(), head, payload);
+    printf("after %d repeats each: %s\n", repeats, d.stats().c_str());
+    d.stop();
+
+    // a restart finds the results; one of them is then made stale, and a
+    // server checking every hit must catch and replace it
+    MemoCache* c = memo_open(path.c_str(), 16 << 20);
+    MemoKey key = memo_key(memo_digest(roms[0].bytes.data(), roms[0].bytes.size()), 0x100, 0x100, "", 0, 1ull << 34);
+    MemoResult bad;
+    if (!c || !memo_lookup(c, key, bad)) {
+        printf("entry for %s not found after restart\n", paths[0]);
+        memo_close(c);
+        unlink(path.c_str());
+        return 1;
+    }
+    bad.cycles++;
+    bad.output += "?";
+    memo_store(c, key, bad);
+    memo_close(c);
+
+    if (!d.start(roms, socket, path, 1.0)) {
+        d.stop();
+        return 1;
+    }
+    for (size_t r = 0; r < roms.size(); r++) {
+        d.run(("RUN " + roms[r].name + " 17179869184\n").c_str(), head, payload);
+        wrong += head + "\n" + payload != want[r];
+    }
+    std::string verified = d.stats();
+    d.stop();
+    bool caught = verified.find(" stale=1 ") != std::string::npos;
+    printf("restart, every hit re-run:  %s\n", verified.c_str());
+    printf("  planted stale entry %s\n", caught ? "caught and replaced" : "NOT CAUGHT");
+
+    // a 1% sample: what checking costs on the hit path
+    if (!d.start(roms, socket, path, 0.01)) {
+        d.stop();
+        return 1;
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeats; i++) {
+        d.run(("RUN " + roms[0].name + " 17179869184\n").c_str(), head, payload);
+        wrong += head + "\n" + payload != want[0];
+    }
+    double s = seconds_since(t0);
+    printf("1%% sampled: %.0f req/s  %s\n", repeats / s, d.stats().c_str());
+    d.stop();
+
+    // key and lookup alone, against a table a third full
+    c = memo_open(path.c_str(), 16 << 20);
+    std::mt19937_64 rng(1);
+    std::vector<MemoKey> keys(10000);
+    MemoResult res{RUN_EXIT, 1, 4, 0, std::string(200, 'x')};
+    for (MemoKey& k : keys) {
+        k = MemoKey{rng(), rng()};
+        memo_store(c, k, res);
+    }
+    MemoKey rom_key = memo_digest(roms.back().bytes.data(), roms.back().bytes.size());
+    const int reps = 200000;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        key = memo_key(rom_key, 0x100, 0x100, "", 0, u64(i));
+    double key_ns = seconds_since(t0) / reps * 1e9;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        wrong += !memo_lookup(c, keys[i % keys.size()], res);
+    double lookup_ns = seconds_since(t0) / reps * 1e9;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100; i++)
+        rom_key = memo_digest(roms.back().bytes.data(), roms.back().bytes.size());
+    double digest_us = seconds_since(t0) / 100 * 1e6;
+    printf("key %.0f ns (+%.2f us per image digest, once per ROM), lookup %.0f ns with a 200-byte output\n", key_ns,
+           digest_us, lookup_ns);
+    memo_close(c);
+    unlink(path.c_str());
+
+    if (wrong)
+        printf("%d WRONG REPLIES\n", wrong);
+    return wrong == 0 && caught ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "bench/bench.h"
+#include "bulk/bulk.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "memory/pages.h"
+
+// The root of mem, computed from scratch on a copy.
+static u64 full_root(const Memory& mem) {
+    std::unique_ptr<Memory> m(new Memory);
+    memcpy(m->data, mem.data, sizeof(m->data));
+    m->clear_dirty();
+    return m->hash();
+}
+
+struct Taken {
+    MemorySnapshot snap;
+    u64 content; // bulk_hash of the whole image, to check restores
+};
+
+// Instance i of the program takes a snapshot every `every` cycles, offset
+// by i * every / instances, so no two share a moment; pages still match
+// wherever the program left them alone. Every snapshot is checked against
+// a full rehash, then every one is restored and checked again.
+static bool snapshots(const char* rom, const std::vector<u8>& image, int instances, u64 every, u64 max_cycles) {
+    PageStore store;
+    std::vector<Taken> taken;
+    std::unique_ptr<Memory> mem(new Memory);
+    CPU cpu;
+    int wrong = 0;
+    double hash_s = 0;
+    u64 pages_hashed = 0;
+
+    for (int i = 0; i < instances; i++) {
+        boot_com(cpu, *mem, image);
+        Console con{nullptr};
+        u64 next = every * i / instances + 1, at = 0;
+        RunResult r{RUN_BUDGET, 0, 0};
+        while (r.status == RUN_BUDGET && at < max_cycles) {
+            r = run_com(cpu, con, next - at);
+            at += r.cycles;
+            if (at < next && r.status == RUN_BUDGET)
+                continue;
+            for (int w = 0; w < 4; w++)
+                pages_hashed += __builtin_popcountll(mem->dirty[w] | mem->unhashed[w]);
+            auto t0 = std::chrono::steady_clock::now();
+            u64 root = mem->hash();
+            hash_s += seconds_since(t0);
+            wrong += root != full_root(*mem);
+
+            taken.push_back(Taken{{}, bulk_hash(mem->data, sizeof(mem->data))});
+            snapshot_take(store, *mem, taken.back().snap);
+            next += every;
+        }
+    }
+
+    // restored newest first into one machine, which then differs from each
+    // snapshot by only what changed in between
+    int copied = 0;
+    for (size_t k = taken.size(); k-- > 0;) {
+        copied += snapshot_restore(store, taken[k].snap, *mem);
+        wrong += bulk_hash(mem->data, sizeof(mem->data)) != taken[k].content || mem->hash() != taken[k].snap.root;
+    }
+
+    size_t flat = taken.size() * sizeof(mem->data);
+    size_t kept = store.bytes() + taken.size() * sizeof(MemorySnapshot);
+    printf("%s: %d instances, %zu snapshots, %zu distinct pages of %zu\n", rom, instances, taken.size(),
+           store.pages(), taken.size() * 256);
+    printf("  flat copies %8.1f MiB   page store %7.2f MiB   %.1fx smaller\n", flat / 1048576.0,
+           kept / 1048576.0, double(flat) / kept);
+    printf("  hashing at snapshots: %.1f pages each, %.2f us each (%.0f ns/page)\n",
+           double(pages_hashed) / taken.size(), hash_s / taken.size() * 1e6,
+           pages_hashed ? hash_s / pages_hashed * 1e9 : 0.0);
+    printf("  restores: %.1f pages copied each   %s\n", double(copied) / taken.size(),
+           wrong ? "HASH OR RESTORE WRONG" : "roots and contents match");
+
+    for (Taken& t : taken)
+        snapshot_release(store, t.snap);
+    if (store.pages() != 0) {
+        printf("  %zu pages left after releasing everything\n", store.pages());
+        wrong++;
+    }
+    return wrong == 0;
+}
+
+template <typename F>
+static double ns_per(int reps, F f) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        f();
+    return seconds_since(t0) / reps * 1e9;
+}
+
+// Two copies of a program's final memory with k pages changed in one,
+// compared in full, page by page, and through the trees.
+static bool compares(const std::vector<u8>& image, int reps) {
+    std::unique_ptr<Memory> a(new Memory), b(new Memory);
+    CPU cpu;
+    boot_com(cpu, *a, image);
+    Console con{nullptr};
+    run_com(cpu, con, 1ull << 32);
+    for (int p = 0; p < 256; p++) // no zero pages, so no page hashes equal another by accident
+        a->write(u16(p * 256 + 255), u8(p | 1));
+    std::mt19937 rng(7);
+    int wrong = 0;
+
+    printf("compare two 64 KiB memories, k pages differ        (ns per compare)\n");
+    printf("      k     memcmp  diff_pages   rehash   root  tree diff\n");
+    for (int k : {0, 1, 4, 16, 64, 256}) {
+        b->reset();
+        memcpy(b->data, a->data, sizeof(b->data));
+        std::vector<int> pages(256);
+        for (int p = 0; p < 256; p++)
+            pages[p] = p;
+        std::shuffle(pages.begin(), pages.end(), rng);
+        pages.resize(k);
+        for (int p : pages)
+            b->write(u16(p * 256 + 17), u8(b->data[p * 256 + 17] ^ 0x5A));
+        a->hash();
+        b->hash();
+
+        u64 bits[4], want[4];
+        bulk_diff_pages(a->data, b->data, 256, want);
+        int found = memory_diff(*a, *b, bits);
+        wrong += found != k || memcmp(bits, want, sizeof(bits)) != 0 || memory_equal(*a, *b) != (k == 0);
+
+        volatile int sink = 0;
+        double t_memcmp = ns_per(reps, [&] { sink = sink + memcmp(a->data, b->data, sizeof(a->data)); });
+        double t_pages = ns_per(reps, [&] { bulk_diff_pages(a->data, b->data, 256, bits); });
+        // the same pages written again each time, then brought up to date
+        double t_rehash = ns_per(reps, [&] {
+            for (int p : pages)
+                b->write(u16(p * 256 + 17), b->data[p * 256 + 17]);
+            b->hash();
+        });
+        double t_root = ns_per(reps * 10, [&] { sink = sink + memory_equal(*a, *b); });
+        double t_tree = ns_per(reps, [&] { sink = sink + memory_diff(*a, *b, bits); });
+        printf("  %5d %10.1f %11.1f %8.1f %6.1f %10.1f\n", k, t_memcmp, t_pages, t_rehash, t_root, t_tree);
+    }
+    printf("  (memcmp stops at the first difference; rehash is what tree compares\n"
+           "   pay first, once per write burst, for k written pages)\n");
+    if (wrong)
+        printf("  TREE DIFF DISAGREES WITH diff_pages\n");
+    return wrong == 0;
+}
+
+// Root compares and tree diffs against memcmp and the page-diff kernel,
+// incremental rehash cost, and what a content-addressed page store saves
+// over flat copies for snapshots taken through runs of several instances.
+int bench_merkle(int argc, char** argv) {
+    std::vector<const char*> roms;
+    int instances = 8, reps = 20000;
+    u64 every = 1000000, max_cycles = 1ull << 32;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--instances") && i + 1 < argc)
+            instances = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--every") && i + 1 < argc)
+            every = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            max_cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--reps") && i + 1 < argc)
+            reps = atoi(argv[++i]);
+        else
+            roms.push_back(argv[i]);
+    }
+    if (roms.empty())
+        roms = {"roms/testing/CPUTEST.COM"};
+    if (instances < 1)
+        instances = 1;
+    if (every < 1)
+        every = 1;
+
+    bool ok = true;
+    std::vector<u8> image;
+    for (size_t i = 0; i < roms.size(); i++) {
+        if (!readROM(roms[i], image) || image.size() > 0x10000 - 0x100)
+            return 1;
+        if (i == 0)
+            ok &= compares(image, reps);
+        ok &= snapshots(roms[i], image, instances, every, max_cycles);
+    }
+    return ok ? 0 : 1;
+}
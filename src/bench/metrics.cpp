@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "metrics/metrics.h"
+
+static RunResult run(Memory& mem, CPU& cpu, const std::vector<u8>& image, u64 max_cycles) {
+    mem.reset();
+    std::memcpy(mem.data + 0x100, image.data(), image.size());
+    cpu.mem = &mem;
+    cpu.reset();
+    cpu.pc = 0x100;
+    Console con{nullptr};
+    return run_com(cpu, con, max_cycles);
+}
+
+static u64 events(const MetricsTotals& t) {
+    u64 n = t.faults + t.bios;
+    for (u64 c : t.bdos)
+        n += c;
+    for (int p = 0; p < 256; p++)
+        n += t.port_in[p] + t.port_out[p];
+    return n;
+}
+
+// Worker threads run a program through run_com() while another thread
+// keeps summing the shards; the totals must then match the runs exactly.
+// Then the cost of one counted event, and what counting adds to a long
+// program.
+int bench_metrics(int argc, char** argv) {
+    const char* rom = "roms/testing/TST8080.COM";
+    const char* long_rom = "roms/testing/CPUTEST.COM";
+    int workers = 4, runs = 2000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+            runs = atoi(argv[++i]);
+    }
+    std::vector<u8> image, long_image;
+    if (!readROM(rom, image) || !readROM(long_rom, long_image))
+        return 1;
+
+    // what one run adds
+    std::unique_ptr<Memory> mem(new Memory);
+    CPU cpu;
+    MetricsTotals t0, t1;
+    metrics_sum(t0);
+    RunResult one = run(*mem, cpu, image, 1ull << 32);
+    metrics_sum(t1);
+    u64 one_events = events(t1) - events(t0);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> backwards{0};
+    u64 scrapes = 0;
+    std::thread scraper([&] {
+        MetricsTotals t;
+        u64 last = 0;
+        while (!done) {
+            metrics_sum(t);
+            if (t.instructions < last)
+                backwards++;
+            last = t.instructions;
+            scrapes++;
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; w++)
+        threads.emplace_back([&] {
+            std::unique_ptr<Memory> m(new Memory);
+            CPU c;
+            for (int i = 0; i < runs; i++)
+                run(*m, c, image, 1ull << 32);
+        });
+    for (std::thread& t : threads)
+        t.join();
+    done = true;
+    scraper.join();
+
+    MetricsTotals t2;
+    metrics_sum(t2);
+    u64 n = u64(workers) * runs;
+    bool ok = t2.instructions - t1.instructions == n * one.instructions &&
+              t2.cycles - t1.cycles == n * one.cycles && events(t2) - events(t1) == n * one_events &&
+              backwards == 0;
+    printf("%s: %d threads x %d runs, %llu scrapes while running: %s\n", rom, workers, runs,
+           (unsigned long long)scrapes, ok ? "totals match" : "TOTALS WRONG");
+
+    // one counted event, against the same loop without it
+    const int reps = 100000000;
+    auto ta = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        asm volatile("" : : "r"(i));
+    double empty = seconds_since(ta);
+    ta = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++)
+        metrics_add(metrics_local().port_in[i & 255]);
+    double counted = seconds_since(ta);
+    double ns = std::max(0.0, counted - empty) / reps * 1e9;
+    printf("one counted event (IN/OUT, HLT step, trap): %.2f ns\n", ns);
+
+    // the per-event cost over a whole run of the long program
+    metrics_sum(t1);
+    ta = std::chrono::steady_clock::now();
+    RunResult r = run(*mem, cpu, long_image, 1ull << 34);
+    double s = seconds_since(ta);
+    metrics_sum(t2);
+    u64 ev = events(t2) - events(t1) + (t2.halt_cycles - t1.halt_cycles) / 4 + 1; // + the run itself
+    printf("%s: %llu instructions in %.3f s, %llu counted events, about %.5f%% of the run\n", long_rom,
+           (unsigned long long)r.instructions, s, (unsigned long long)ev, 100.0 * ev * ns * 1e-9 / s);
+    printf("worst case, IN or OUT every instruction: about %.1f%%\n",
+           100.0 * ns * 1e-9 * r.instructions / s);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "perf/perf.h"
+#include "util/isa.h"
+
+static double run(const std::vector<u8>& image, u64 max_cycles, PerfProfile& prof) {
+    std::unique_ptr<Memory> mem(new Memory);
+    CPU cpu;
+    boot_com(cpu, *mem, image);
+    Console con{nullptr};
+    auto t0 = std::chrono::steady_clock::now();
+    prof.begin();
+    while (cpu.cycles < max_cycles) {
+        if (prof.step(cpu, [&] { return cpu.step(); }) == 0)
+            break;
+        if (cpu.pc == BDOS_ENTRY && bdos_call(cpu, con) == BDOS_EXIT)
+            break;
+        if (cpu.pc == WARM_BOOT)
+            break;
+    }
+    prof.end();
+    return cpu.cycles / seconds_since(t0) / 1e6;
+}
+
+// Host counters for a .COM program (CPUTEST by default): totals per
+// emulated instruction from a plain run, then a run read around every
+// instruction and split by how execute_instruction() dispatches it.
+int bench_perf(int argc, char** argv) {
+    const char* rom = "roms/testing/CPUTEST.COM";
+    u64 max_cycles = 1ull << 34;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            max_cycles = strtoull(argv[++i], nullptr, 0);
+        else
+            rom = argv[i];
+    }
+    std::vector<u8> image;
+    if (!readROM(rom, image))
+        return 1;
+
+    printf("%s, interpreter build %s\n", rom, isa_level());
+    PerfProfile totals;
+    double mhz = run(image, max_cycles, totals);
+    printf("totals (%.0f MHz emulated):\n", mhz);
+    perf_report(totals, stdout);
+
+    PerfProfile classes;
+    classes.per_class = true;
+    mhz = run(image, max_cycles, classes);
+    printf("per class (%.0f MHz emulated while sampling):\n", mhz);
+    perf_report(classes, stdout);
+    return 0;
+}
@@ -0,0 +1,138 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench/bench.h"
+#include "cpm/bdos.h"
+#include "cpu/load.h"
+#include "pool/pool.h"
+
+enum PoolMode { MODE_HEAP, MODE_POOL, MODE_NUMA };
+
+struct Batch {
+    const std::vector<u8>* image;
+    u64 max_cycles;
+    int runs = 0;
+    std::atomic<int> next{0};
+    std::atomic<u64> instructions{0};
+    std::atomic<int> wrong{0};
+    u64 want_cycles = 0; // from a reference run
+    std::string want_output = {};
+};
+
+static u64 run_one(Instance* inst, const Batch& b, std::string& output, u64* cycles) {
+    CPU& cpu = inst->cpu;
+    cpu.pc = 0x100;
+    output.clear();
+    Console con{nullptr, &output};
+    RunResult r = run_com(cpu, con, b.max_cycles);
+    *cycles = r.cycles;
+    return r.instructions;
+}
+
+static void check(Batch& b, const std::string& output, u64 cycles) {
+    if (cycles != b.want_cycles || output != b.want_output)
+        b.wrong++;
+}
+
+static void worker(Batch& b, PoolMode mode, InstancePool* pool, int index) {
+    std::string output;
+    u64 instructions = 0, cycles;
+    if (mode == MODE_HEAP) {
+        // an instance wherever new puts it, fully cleared after every run
+        std::unique_ptr<Instance> inst(new Instance);
+        inst->mem.reset();
+        inst->cpu.mem = &inst->mem;
+        while (b.next++ < b.runs) {
+            memcpy(inst->mem.data + 0x100, b.image->data(), b.image->size());
+            inst->cpu.reset();
+            instructions += run_one(inst.get(), b, output, &cycles);
+            check(b, output, cycles);
+            inst->mem.reset();
+        }
+    } else {
+        int node = mode == MODE_NUMA ? pool_pin_worker(index) : -1;
+        while (b.next++ < b.runs) {
+            Instance* inst = pool_acquire(pool, node);
+            pool_load(inst, 0x100, b.image->data(), b.image->size());
+            instructions += run_one(inst, b, output, &cycles);
+            check(b, output, cycles);
+            pool_release(pool, inst);
+        }
+    }
+    b.instructions += instructions;
+}
+
+// Many short runs of one program spread over worker threads, with a heap
+// instance per worker cleared in full after each run, with pool instances
+// recycled page by page, and with those placed on the NUMA node of a
+// pinned worker.
+int bench_pool(int argc, char** argv) {
+    const char* rom = "roms/testing/TST8080.COM";
+    int workers = int(std::thread::hardware_concurrency());
+    int runs = 50000;
+    u64 max_cycles = 10000000;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--runs") && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            max_cycles = strtoull(argv[++i], nullptr, 0);
+        else
+            rom = argv[i];
+    }
+    if (workers < 1)
+        workers = 1;
+    std::vector<u8> image;
+    if (!readROM(rom, image) || image.size() > 0x10000 - 0x100)
+        return 1;
+
+    // reference result every run must reproduce
+    InstancePool* ref = pool_create(false);
+    Instance* inst = pool_acquire(ref, -1);
+    pool_load(inst, 0x100, image.data(), image.size());
+    std::string output;
+    u64 want_cycles;
+    u64 insns = run_one(inst, Batch{&image, max_cycles}, output, &want_cycles);
+    pool_release(ref, inst);
+    pool_destroy(ref);
+
+    printf("%s: %d runs of %llu instructions, %d workers, %d NUMA node%s\n", rom, runs,
+           (unsigned long long)insns, workers, pool_nodes(), pool_nodes() == 1 ? "" : "s");
+    if (pool_nodes() == 1)
+        printf("  (one node here: placement cannot change anything, pinning still applies)\n");
+
+    const char* names[] = {"heap", "pool", "numa"};
+    int wrong = 0;
+    for (PoolMode mode : {MODE_HEAP, MODE_POOL, MODE_NUMA}) {
+        Batch b{&image, max_cycles, runs};
+        b.want_cycles = want_cycles;
+        b.want_output = output;
+        InstancePool* pool = mode == MODE_HEAP ? nullptr : pool_create(mode == MODE_NUMA);
+
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int w = 0; w < workers; w++)
+            threads.emplace_back(worker, std::ref(b), mode, pool, w);
+        for (std::thread& t : threads)
+            t.join();
+        double s = seconds_since(t0);
+
+        printf("  %-5s %8.3f s %10.0f runs/s %8.1f MIPS", names[mode], s, runs / s, b.instructions / s / 1e6);
+        if (pool) {
+            PoolStats st = pool_stats(pool);
+            printf("  %llu instances (%llu on a node), %.1f pages cleared/run",
+                   (unsigned long long)st.created, (unsigned long long)st.bound,
+                   double(st.pages_cleared) / runs);
+            pool_destroy(pool);
+        }
+        printf("%s\n", b.wrong ? "  WRONG RESULTS" : "");
+        wrong += b.wrong;
+    }
+    return wrong ? 1 : 0;
+}
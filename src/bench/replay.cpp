@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include "bench/bench.h"
+#include "machine/invaders.h"
+
+// Polls the input port into VRAM and reads the shift register, so every
+// frame depends on the (random) player input and on interrupt timing. An IN
+// every ~20 cycles makes it a worst case for the recorder.
+static const u8 input_program[] = {
+    0x31, 0x00, 0x24, // 0040 LXI SP,2400
+    0xFB,             // 0043 EI
+    0x21, 0x00, 0x24, // 0044 loop: LXI H,2400
+    0xDB, 0x01,       // 0047 inner: IN 1
+    0xD3, 0x04,       // 0049 OUT 4
+    0xDB, 0x03,       // 004B IN 3
+    0x86,             // 004D ADD M
+    0x77,             // 004E MOV M,A
+    0x23,             // 004F INX H
+    0x7C,             // 0050 MOV A,H
+    0xFE, 0x40,       // 0051 CPI 40
+    0xC2, 0x47, 0x00, // 0053 JNZ inner
+    0xC3, 0x44, 0x00, // 0056 JMP loop
+};
+
+// RST 1 and RST 2 handlers bump counters in RAM
+static const u8 handlers[] = {
+    0xF5, 0xE5, 0x21, 0xC0, 0x20, 0x34, 0xE1, 0xF1, 0xFB, 0xC9,
+};
+
+static void boot(Invaders& m) {
+    m.mem.reset();
+    std::memcpy(m.mem.data + 0x40, input_program, sizeof(input_program));
+    m.mem.data[0] = 0xC3, m.mem.data[1] = 0x40;
+    m.mem.data[8] = 0xC3, m.mem.data[9] = 0x20;   // RST 1
+    m.mem.data[16] = 0xC3, m.mem.data[17] = 0x20; // RST 2
+    std::memcpy(m.mem.data + 0x20, handlers, sizeof(handlers));
+    m.reset();
+}
+
+static double run(Invaders& m, int frames, std::mt19937* joystick) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        if (joystick)
+            m.port1 = (*joystick)() & 0x77;
+        if (!m.run_frame())
+            break;
+    }
+    return seconds_since(t0);
+}
+
+static bool same_state(const Invaders& a, const Invaders& b) {
+    return a.cpu.cycles == b.cpu.cycles && a.cpu.pc == b.cpu.pc && a.cpu.sp == b.cpu.sp && a.cpu.a == b.cpu.a &&
+           a.cpu.flags.f == b.cpu.flags.f && a.cpu.h == b.cpu.h && a.cpu.l == b.cpu.l && a.cpu.inte == b.cpu.inte &&
+           memcmp(a.mem.data, b.mem.data, sizeof(a.mem.data)) == 0;
+}
+
+// Records a run with random player input, replays it without any input
+// source, and compares the final states and the cost of each mode.
+int bench_replay(int argc, char** argv) {
+    int frames = 3000;
+    for (int i = 1; i < argc; i++)
+        if (!strcmp(argv[i], "--frames") && i + 1 < argc)
+            frames = atoi(argv[++i]);
+
+    std::unique_ptr<Invaders> plain(new Invaders), recorded(new Invaders), replayed(new Invaders);
+    std::mt19937 rng_a(42), rng_b(42);
+
+    boot(*plain);
+    double plain_s = run(*plain, frames, &rng_a);
+
+    Recorder rec;
+    rec.begin();
+    boot(*recorded);
+    recorded->trace(&rec, nullptr);
+    double record_s = run(*recorded, frames, &rng_b);
+
+    Replayer rep;
+    rep.start(rec.log);
+    boot(*replayed);
+    replayed->trace(nullptr, &rep);
+    double replay_s = run(*replayed, frames, nullptr);
+
+    bool ok = same_state(*recorded, *replayed) && same_state(*plain, *recorded) && !rep.diverged;
+    printf("%d frames, %llu events logged in %zu bytes (%.2f bytes/event)\n", frames,
+           (unsigned long long)rec.events, rec.log.size(), double(rec.log.size()) / rec.events);
+    printf("  plain   %.3f s\n", plain_s);
+    printf("  record  %.3f s  (%+.1f%%)\n", record_s, 100 * (record_s / plain_s - 1));
+    printf("  replay  %.3f s  (%.0fx real time)\n", replay_s, frames / 60.0 / replay_s);
+    printf("  replayed state %s\n", ok ? "matches bit for bit" : rep.diverged ? "DIVERGED" : "DIFFERS");
+    return ok ? 0 : 1;
+}
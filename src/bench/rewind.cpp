@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "bench/bench.h"
+#include "rewind/rewind.h"
+#include "bulk/bulk.h"
+
+// HL steps through an LCG (HL = 5*HL + 1, full period); each step bumps a
+// byte at a pseudo-random address in 4000-7FFF and a counter at 3000.
+static const std::vector<u8> lcg_program = {
+    0x31, 0x00, 0x00, // 0100 LXI SP,0000
+    0x21, 0x34, 0x12, // 0103 LXI H,1234
+    0x54, 0x5D,       // 0106 loop: MOV D,H / MOV E,L
+    0x29, 0x29, 0x19, // 0108 DAD H / DAD H / DAD D
+    0x23, 0xE5,       // 010B INX H / PUSH H
+    0x7C, 0xE6, 0x3F, // 010D MOV A,H / ANI 3F
+    0xF6, 0x40, 0x67, // 0110 ORI 40 / MOV H,A
+    0x7E, 0x3C, 0x77, // 0113 MOV A,M / INR A / MOV M,A
+    0x01, 0x00, 0x30, // 0116 LXI B,3000
+    0x0A, 0x3C, 0x02, // 0119 LDAX B / INR A / STAX B
+    0xE1,             // 011C POP H
+    0xC3, 0x06, 0x01, // 011D JMP loop
+};
+
+static u64 state_hash(const CPU& cpu) {
+    u64 h = bulk_hash(cpu.mem->data, sizeof(cpu.mem->data));
+    auto mix = [&](u64 v) { h = (h ^ v) * 1099511628211ull; };
+    mix(cpu.a), mix(cpu.b), mix(cpu.c), mix(cpu.d), mix(cpu.e), mix(cpu.h), mix(cpu.l);
+    mix(cpu.sp), mix(cpu.pc), mix(cpu.flags.f), mix(cpu.cycles);
+    return h;
+}
+
+struct Seen {
+    u64 cycle;
+    u64 hash;
+};
+
+// Whether the instruction at cpu's state writes addr and nothing up to
+// `until` writes it again; runs on a copy.
+static bool last_write_was(const CPU& at, u16 addr, u64 until) {
+    std::unique_ptr<Memory> m(new Memory(*at.mem));
+    CPU c = at;
+    c.mem = m.get();
+    m->watch_page(addr >> 8, true);
+    m->nhits = 0;
+    c.step();
+    if (!m->was_written(addr))
+        return false;
+    while (c.cycles < until) {
+        m->nhits = 0;
+        c.step();
+        if (m->was_written(addr))
+            return false;
+    }
+    return true;
+}
+
+static double ms(double s) { return s * 1e3; }
+
+// Runs the LCG loop under a Rewind, jumps around in its history, and
+// checks every visited state against a straight run from reset.
+int bench_rewind(int argc, char** argv) {
+    u64 cycles = 200000000;
+    u64 interval = 1000000;
+    size_t budget = 16 << 20;
+    int steps = 200;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--interval") && i + 1 < argc)
+            interval = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--budget") && i + 1 < argc)
+            budget = size_t(strtoull(argv[++i], nullptr, 0)) << 20;
+        else if (!strcmp(argv[i], "--steps") && i + 1 < argc)
+            steps = atoi(argv[++i]);
+    }
+
+    std::unique_ptr<Memory> mem(new Memory);
+    CPU cpu;
+    boot_com(cpu, *mem, lcg_program);
+
+    // plain run for the overhead figure
+    auto t0 = std::chrono::steady_clock::now();
+    while (cpu.cycles < cycles)
+        cpu.step();
+    double plain_s = seconds_since(t0);
+
+    boot_com(cpu, *mem, lcg_program);
+    std::unique_ptr<Rewind> rw(new Rewind);
+    rw->interval = interval;
+    rw->budget = budget;
+    rw->attach(cpu);
+    t0 = std::chrono::steady_clock::now();
+    while (cpu.cycles < cycles)
+        rw->step();
+    double record_s = seconds_since(t0);
+    u64 now = cpu.cycles;
+    u64 now_hash = state_hash(cpu);
+
+    printf("%llu cycles, checkpoint every %llu: %zu checkpoints, %.1f MB, history from cycle %llu\n",
+           (unsigned long long)now, (unsigned long long)interval, rw->checkpoints.size(), rw->bytes / 1048576.0,
+           (unsigned long long)rw->oldest());
+    printf("  forward   plain %.3f s, checkpointing %.3f s (%+.1f%%)\n", plain_s, record_s,
+           100 * (record_s / plain_s - 1));
+
+    std::vector<Seen> seen;
+    std::vector<double> t_back, t_write, t_run;
+
+    for (int i = 0; i < steps; i++) {
+        t0 = std::chrono::steady_clock::now();
+        if (!rw->step_back())
+            break;
+        t_back.push_back(seconds_since(t0));
+        seen.push_back({cpu.cycles, state_hash(cpu)});
+    }
+
+    // the counter (written every loop), a random byte of the buffer, and an
+    // address nothing writes
+    std::mt19937 rng(7);
+    u16 targets[] = {0x3000, u16(0x4000 + rng() % 0x4000), u16(0x4000 + rng() % 0x4000), 0x9000};
+    int wrong_writes = 0;
+    for (u16 addr : targets) {
+        u64 before = cpu.cycles;
+        u64 before_hash = state_hash(cpu);
+        t0 = std::chrono::steady_clock::now();
+        bool ok = rw->reverse_to_write(addr);
+        t_write.push_back(seconds_since(t0));
+        if (ok) {
+            seen.push_back({cpu.cycles, state_hash(cpu)});
+            if (!last_write_was(cpu, addr, before))
+                printf("  reverse_to_write(%04X) stopped at the wrong instruction\n", addr), wrong_writes++;
+        }
+        else if (cpu.cycles != before || state_hash(cpu) != before_hash)
+            printf("  reverse_to_write(%04X) missed but moved the machine\n", addr), wrong_writes++;
+    }
+
+    for (int i = 0; i < steps; i++) {
+        u64 target = rw->oldest() + rng() % (now - rw->oldest());
+        t0 = std::chrono::steady_clock::now();
+        if (!rw->run_to(target))
+            break;
+        t_run.push_back(seconds_since(t0));
+        seen.push_back({cpu.cycles, state_hash(cpu)});
+    }
+    rw->run_to(now);
+    bool back_home = cpu.cycles == now && state_hash(cpu) == now_hash;
+
+    auto report = [](const char* what, std::vector<double>& t) {
+        if (t.empty())
+            return;
+        std::sort(t.begin(), t.end());
+        printf("  %-16s %4zu calls, median %.2f ms, worst %.2f ms\n", what, t.size(), ms(t[t.size() / 2]),
+               ms(t.back()));
+    };
+    report("step_back", t_back);
+    report("reverse_to_write", t_write);
+    report("run_to", t_run);
+    printf("  %llu restores, %.1fM cycles re-executed\n", (unsigned long long)rw->restores,
+           rw->replayed_cycles / 1e6);
+
+    // straight reference run through every visited state
+    std::sort(seen.begin(), seen.end(), [](const Seen& a, const Seen& b) { return a.cycle < b.cycle; });
+    boot_com(cpu, *mem, lcg_program);
+    int bad = 0;
+    size_t next = 0;
+    while (cpu.cycles <= now) {
+        while (next < seen.size() && seen[next].cycle <= cpu.cycles) {
+            if (seen[next].cycle != cpu.cycles || seen[next].hash != state_hash(cpu))
+                bad++;
+            next++;
+        }
+        if (cpu.cycles == now)
+            break;
+        cpu.step();
+    }
+    printf("  %zu visited states checked, %d wrong, returned to start %s\n", seen.size(), bad,
+           back_home ? "intact" : "CHANGED");
+    printf("  %zu write searches, %d wrong\n", sizeof(targets) / sizeof(targets[0]), wrong_writes);
+    return bad == 0 && wrong_writes == 0 && back_home ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "bench/bench.h"
+#include "cpu/load.h"
+#include "wide/wide.h"
+
+// Runs the same .COM image as N instances, once on the scalar core and once
+// WIDE_LANES at a time on WideCPU, and checks both end in identical states.
+int bench_wide(int argc, char** argv) {
+    const char* rom = "roms/testing/CPUTEST.COM";
+    int instances = WIDE_LANES * 4;
+    u64 max_cycles = 20000000;
+    long poke = -1; // address that receives the instance number
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--instances") && i + 1 < argc)
+            instances = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            max_cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--poke") && i + 1 < argc)
+            poke = strtol(argv[++i], nullptr, 0);
+        else
+            rom = argv[i];
+    }
+
+    std::vector<u8> image;
+    if (!readROM(rom, image) || image.size() > 0x10000 - 0x100)
+        return 1;
+
+    std::unique_ptr<Memory[]> scalar_mem(new Memory[instances]);
+    std::unique_ptr<Memory[]> wide_mem(new Memory[instances]);
+    std::vector<CPU> scalar_cpu(instances);
+    Console quiet{nullptr};
+
+    auto t0 = std::chrono::steady_clock::now();
+    u64 scalar_instr = 0;
+    for (int n = 0; n < instances; n++) {
+        boot_com(scalar_cpu[n], scalar_mem[n], image);
+        if (poke >= 0)
+            scalar_mem[n].write(poke, n);
+        scalar_instr += run_com(scalar_cpu[n], quiet, max_cycles).instructions;
+    }
+    double scalar_s = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    u64 wide_instr = 0, wide_steps = 0;
+    int mismatches = 0;
+    for (int base = 0; base < instances; base += WIDE_LANES) {
+        WideCPU w{};
+        for (int i = 0; i < WIDE_LANES && base + i < instances; i++) {
+            CPU cpu;
+            boot_com(cpu, wide_mem[base + i], image);
+            if (poke >= 0)
+                wide_mem[base + i].write(poke, base + i);
+            w.load(i, cpu);
+            w.live |= 1u << i;
+        }
+        run_com(w, quiet, max_cycles);
+        wide_instr += w.lane_steps;
+        wide_steps += w.steps;
+
+        for (int i = 0; i < WIDE_LANES && base + i < instances; i++) {
+            CPU cpu;
+            w.store(i, cpu);
+            CPU& ref = scalar_cpu[base + i];
+            if (cpu.a != ref.a || cpu.BC() != ref.BC() || cpu.DE() != ref.DE() || cpu.HL() != ref.HL() ||
+                cpu.sp != ref.sp || cpu.pc != ref.pc || cpu.flags.f != ref.flags.f || cpu.cycles != ref.cycles ||
+                memcmp(wide_mem[base + i].data, scalar_mem[base + i].data, sizeof(Memory::data)) != 0)
+                mismatches++;
+        }
+    }
+    double wide_s = seconds_since(t0);
+
+    printf("rom %s, %d instances, %llu cycles each, %d lanes\n", rom, instances,
+           (unsigned long long)max_cycles, WIDE_LANES);
+    printf("scalar  %8.3f s  %8.1f MIPS\n", scalar_s, scalar_instr / scalar_s / 1e6);
+    printf("wide    %8.3f s  %8.1f MIPS  (%.2fx, %.1f lanes/step)\n", wide_s, wide_instr / wide_s / 1e6,
+           scalar_s / wide_s, wide_steps ? double(wide_instr) / wide_steps : 0.0);
+    if (mismatches)
+        printf("MISMATCH: %d instances differ from the scalar core\n", mismatches);
+    return mismatches ? 1 : 0;
+}
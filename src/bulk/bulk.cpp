@@ -0,0 +1,252 @@
+#include "bulk/bulk.h"
+#include <cstring>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static constexpr size_t PAGE = 256;
+
+// Hash: eight 64-bit lanes, one per word of a 64-byte stripe. Each lane
+// adds the 32x32 product of the word's halves after xoring in a per-lane
+// key, and adds the raw word to its neighbour lane. The keys move on every
+// stripe so equal stripes at different offsets hash differently. Only
+// 32x32->64 multiplies are used, which every SSE level has.
+static const u64 KEY[8] = {
+    0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull,
+    0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull, 0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull,
+};
+static const u64 STEP[8] = {
+    0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull,
+    0xff51afd7ed558ccdull, 0xc4ceb9fe1a85ec53ull, 0x85ebca77c2b2ae63ull, 0x27d4eb2f165667c5ull,
+};
+
+static u64 mix64(u64 h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+static u64 finish(const u64* acc, size_t n, u64 seed) {
+    u64 h = seed ^ (n * 0x9e3779b97f4a7c15ull);
+    for (int i = 0; i < 8; i++)
+        h = mix64(h ^ acc[i]) + KEY[i];
+    return mix64(h);
+}
+
+// Scalar versions: the reference for the vector ones, and the fallback.
+
+static void clear_scalar(void* dst, size_t n) { memset(dst, 0, n); }
+
+static void diff_scalar(const u8* a, const u8* b, size_t pages, u64* bits) {
+    memset(bits, 0, (pages + 63) / 64 * 8);
+    for (size_t p = 0; p < pages; p++) {
+        u64 x = 0;
+        for (size_t i = 0; i < PAGE; i += 8) {
+            u64 va, vb;
+            memcpy(&va, a + p * PAGE + i, 8);
+            memcpy(&vb, b + p * PAGE + i, 8);
+            x |= va ^ vb;
+        }
+        bits[p / 64] |= u64(x != 0) << (p % 64);
+    }
+}
+
+static u64 hash_scalar(const void* data, size_t n, u64 seed) {
+    const u8* p = (const u8*)data;
+    u64 acc[8], key[8];
+    memcpy(acc, KEY, sizeof(acc));
+    memcpy(key, KEY, sizeof(key));
+    for (size_t s = 0; s < n; s += 64) {
+        for (int i = 0; i < 8; i++) {
+            u64 d;
+            memcpy(&d, p + s + i * 8, 8);
+            u64 dk = d ^ key[i];
+            acc[i] += (dk & 0xffffffff) * (dk >> 32);
+            acc[i ^ 1] += d;
+            key[i] += STEP[i];
+        }
+    }
+    return finish(acc, n, seed);
+}
+
+#if defined(__x86_64__)
+
+// SSE2 is part of x86-64, so this one needs no target attribute.
+
+static void clear_sse2(void* dst, size_t n) {
+    u8* p = (u8*)dst;
+    __m128i z = _mm_setzero_si128();
+    for (size_t i = 0; i < n; i += 64) {
+        _mm_storeu_si128((__m128i*)(p + i), z);
+        _mm_storeu_si128((__m128i*)(p + i + 16), z);
+        _mm_storeu_si128((__m128i*)(p + i + 32), z);
+        _mm_storeu_si128((__m128i*)(p + i + 48), z);
+    }
+}
+
+static void diff_sse2(const u8* a, const u8* b, size_t pages, u64* bits) {
+    memset(bits, 0, (pages + 63) / 64 * 8);
+    for (size_t p = 0; p < pages; p++) {
+        const u8* pa = a + p * PAGE;
+        const u8* pb = b + p * PAGE;
+        __m128i x = _mm_setzero_si128();
+        for (size_t i = 0; i < PAGE; i += 16)
+            x = _mm_or_si128(x, _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pa + i)),
+                                              _mm_loadu_si128((const __m128i*)(pb + i))));
+        bool same = _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) == 0xffff;
+        bits[p / 64] |= u64(!same) << (p % 64);
+    }
+}
+
+static u64 hash_sse2(const void* data, size_t n, u64 seed) {
+    const u8* p = (const u8*)data;
+    __m128i acc[4], key[4], step[4];
+    for (int j = 0; j < 4; j++) {
+        acc[j] = key[j] = _mm_loadu_si128((const __m128i*)&KEY[j * 2]);
+        step[j] = _mm_loadu_si128((const __m128i*)&STEP[j * 2]);
+    }
+    for (size_t s = 0; s < n; s += 64) {
+        for (int j = 0; j < 4; j++) {
+            __m128i d = _mm_loadu_si128((const __m128i*)(p + s + j * 16));
+            __m128i dk = _mm_xor_si128(d, key[j]);
+            acc[j] = _mm_add_epi64(acc[j], _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32)));
+            acc[j] = _mm_add_epi64(acc[j], _mm_shuffle_epi32(d, 0x4e));
+            key[j] = _mm_add_epi64(key[j], step[j]);
+        }
+    }
+    u64 out[8];
+    for (int j = 0; j < 4; j++)
+        _mm_storeu_si128((__m128i*)&out[j * 2], acc[j]);
+    return finish(out, n, seed);
+}
+
+__attribute__((target("avx2"))) static void clear_avx2(void* dst, size_t n) {
+    u8* p = (u8*)dst;
+    __m256i z = _mm256_setzero_si256();
+    for (size_t i = 0; i < n; i += 64) {
+        _mm256_storeu_si256((__m256i*)(p + i), z);
+        _mm256_storeu_si256((__m256i*)(p + i + 32), z);
+    }
+}
+
+__attribute__((target("avx2"))) static void diff_avx2(const u8* a, const u8* b, size_t pages, u64* bits) {
+    memset(bits, 0, (pages + 63) / 64 * 8);
+    for (size_t p = 0; p < pages; p++) {
+        const u8* pa = a + p * PAGE;
+        const u8* pb = b + p * PAGE;
+        __m256i x = _mm256_setzero_si256();
+        for (size_t i = 0; i < PAGE; i += 32)
+            x = _mm256_or_si256(x, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(pa + i)),
+                                                    _mm256_loadu_si256((const __m256i*)(pb + i))));
+        bits[p / 64] |= u64(!_mm256_testz_si256(x, x)) << (p % 64);
+    }
+}
+
+__attribute__((target("avx2"))) static u64 hash_avx2(const void* data, size_t n, u64 seed) {
+    const u8* p = (const u8*)data;
+    __m256i acc[2], key[2], step[2];
+    for (int j = 0; j < 2; j++) {
+        acc[j] = key[j] = _mm256_loadu_si256((const __m256i*)&KEY[j * 4]);
+        step[j] = _mm256_loadu_si256((const __m256i*)&STEP[j * 4]);
+    }
+    for (size_t s = 0; s < n; s += 64) {
+        for (int j = 0; j < 2; j++) {
+            __m256i d = _mm256_loadu_si256((const __m256i*)(p + s + j * 32));
+            __m256i dk = _mm256_xor_si256(d, key[j]);
+            acc[j] = _mm256_add_epi64(acc[j], _mm256_mul_epu32(dk, _mm256_srli_epi64(dk, 32)));
+            acc[j] = _mm256_add_epi64(acc[j], _mm256_shuffle_epi32(d, 0x4e));
+            key[j] = _mm256_add_epi64(key[j], step[j]);
+        }
+    }
+    u64 out[8];
+    for (int j = 0; j < 2; j++)
+        _mm256_storeu_si256((__m256i*)&out[j * 4], acc[j]);
+    return finish(out, n, seed);
+}
+
+__attribute__((target("avx512f"))) static void clear_avx512(void* dst, size_t n) {
+    u8* p = (u8*)dst;
+    __m512i z = _mm512_setzero_si512();
+    for (size_t i = 0; i < n; i += 64)
+        _mm512_storeu_si512(p + i, z);
+}
+
+__attribute__((target("avx512f"))) static void diff_avx512(const u8* a, const u8* b, size_t pages, u64* bits) {
+    memset(bits, 0, (pages + 63) / 64 * 8);
+    for (size_t p = 0; p < pages; p++) {
+        const u8* pa = a + p * PAGE;
+        const u8* pb = b + p * PAGE;
+        __m512i x = _mm512_setzero_si512();
+        for (size_t i = 0; i < PAGE; i += 64)
+            x = _mm512_or_si512(x, _mm512_xor_si512(_mm512_loadu_si512(pa + i), _mm512_loadu_si512(pb + i)));
+        bits[p / 64] |= u64(_mm512_test_epi64_mask(x, x) != 0) << (p % 64);
+    }
+}
+
+__attribute__((target("avx512f"))) static u64 hash_avx512(const void* data, size_t n, u64 seed) {
+    const u8* p = (const u8*)data;
+    __m512i acc = _mm512_loadu_si512(KEY);
+    __m512i key = acc;
+    __m512i step = _mm512_loadu_si512(STEP);
+    // The unmasked srli/mul/shuffle intrinsics pass GCC's self-initialized
+    // _mm512_undefined_epi32() as their merge source, which -Wmaybe-uninitialized
+    // flags once inlined; the zero-masked forms with every lane set are the
+    // same instructions with a defined source.
+    for (size_t s = 0; s < n; s += 64) {
+        __m512i d = _mm512_loadu_si512(p + s);
+        __m512i dk = _mm512_xor_si512(d, key);
+        __m512i hi = _mm512_maskz_srli_epi64(0xFF, dk, 32);
+        acc = _mm512_add_epi64(acc, _mm512_maskz_mul_epu32(0xFF, dk, hi));
+        acc = _mm512_add_epi64(acc, _mm512_maskz_shuffle_epi32(0xFFFF, d, (_MM_PERM_ENUM)0x4e));
+        key = _mm512_add_epi64(key, step);
+    }
+    u64 out[8];
+    _mm512_storeu_si512(out, acc);
+    return finish(out, n, seed);
+}
+
+#endif
+
+static const BulkKernels all[] = {
+    {"scalar", clear_scalar, diff_scalar, hash_scalar},
+#if defined(__x86_64__)
+    {"sse2", clear_sse2, diff_sse2, hash_sse2},
+    {"avx2", clear_avx2, diff_avx2, hash_avx2},
+    {"avx512", clear_avx512, diff_avx512, hash_avx512},
+#endif
+};
+
+static bool supported(const char* name) {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (!strcmp(name, "avx2"))
+        return __builtin_cpu_supports("avx2");
+    if (!strcmp(name, "avx512"))
+        return __builtin_cpu_supports("avx512f");
+#endif
+    (void)name;
+    return true;
+}
+
+const BulkKernels* bulk_variants(int* count) {
+    static int n = [] {
+        int k = 0;
+        while (k < int(sizeof(all) / sizeof(all[0])) && supported(all[k].name))
+            k++;
+        return k;
+    }();
+    *count = n;
+    return all;
+}
+
+const BulkKernels& bulk() {
+    static const BulkKernels& picked = [] () -> const BulkKernels& {
+        int n;
+        const BulkKernels* v = bulk_variants(&n);
+        return v[n - 1];
+    }();
+    return picked;
+}
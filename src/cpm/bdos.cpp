@@ -0,0 +1,122 @@
+#include "cpm/bdos.h"
+#include "cpm/bios.h"
+#include "metrics/metrics.h"
+#include "replay/replay.h"
+
+constexpr u8 CPM_EOF = 0x1A; // ^Z, returned once input is used up
+
+u8 console_read(Console& con, const CPU& cpu) {
+    if (con.replay)
+        return con.replay->console(cpu.cycles);
+    u8 ch = con.input_pos < con.input_len ? con.input[con.input_pos++] : CPM_EOF;
+    if (con.record)
+        con.record->console(cpu.cycles, ch);
+    return ch;
+}
+
+bool console_ready(Console& con, const CPU& cpu) {
+    if (con.replay)
+        return con.replay->console_ready(cpu.cycles) != 0;
+    bool ready = con.input_pos < con.input_len;
+    if (con.record)
+        con.record->console_ready(cpu.cycles, ready);
+    return ready;
+}
+
+// return value in A, mirrored in L as CP/M does
+static void set_result(CPU& cpu, u8 v) {
+    cpu.a = v;
+    cpu.l = v;
+}
+
+BdosStatus bdos_call(CPU& cpu, Console& con) {
+    metrics_add(metrics_local().bdos[cpu.c < 63 ? cpu.c : 63]);
+    switch (cpu.c) {
+    case 0: // program termination
+        return BDOS_EXIT;
+
+    case 1: { // console input with echo
+        u8 ch = console_read(con, cpu);
+        if (ch != CPM_EOF)
+            con.put(ch);
+        set_result(cpu, ch);
+        break;
+    }
+
+    case 2: // print char
+        con.put(cpu.e);
+        break;
+
+    case 6: // direct console I/O
+        if (cpu.e == 0xFF)
+            set_result(cpu, console_ready(con, cpu) ? console_read(con, cpu) : 0);
+        else
+            con.put(cpu.e);
+        break;
+
+    case 9: { // print '$' terminated string
+        u16 addr = cpu.DE();
+        char ch;
+        while ((ch = cpu.mem->read(addr++)) != '$')
+            con.put(ch);
+        break;
+    }
+
+    case 10: { // read console buffer: DE -> max, count, chars
+        u16 buf = cpu.DE();
+        u8 max = cpu.mem->read(buf), n = 0;
+        while (n < max) {
+            u8 ch = console_read(con, cpu);
+            if (ch == CPM_EOF || ch == '\n' || ch == '\r')
+                break;
+            cpu.mem->write(buf + 2 + n++, ch);
+            con.put(ch);
+        }
+        cpu.mem->write(buf + 1, n);
+        break;
+    }
+
+    case 11: // console status
+        set_result(cpu, console_ready(con, cpu) ? 0xFF : 0x00);
+        break;
+    }
+
+    // simulate RET
+    cpu.pc = cpu.mem->read(cpu.sp) | (cpu.mem->read(cpu.sp + 1) << 8);
+    cpu.sp += 2;
+    return BDOS_CONTINUE;
+}
+
+RunResult run_com(CPU& cpu, Console& con, u64 max_cycles, Bios* bios) {
+    RunResult r{RUN_BUDGET, 0, 0};
+
+    while (r.cycles < max_cycles) {
+        int cycles = cpu.step();
+        if (cycles == 0) {
+            metrics_add(metrics_local().faults);
+            r.status = RUN_FAULT;
+            break;
+        }
+        r.instructions++;
+        r.cycles += cycles;
+
+        if (cpu.pc == BDOS_ENTRY && bdos_call(cpu, con) == BDOS_EXIT) {
+            r.status = RUN_EXIT;
+            break;
+        }
+        if (cpu.pc == WARM_BOOT) {
+            r.status = RUN_EXIT;
+            break;
+        }
+        if (bios && is_bios_entry(cpu.pc) && !bios_call(cpu, con, *bios)) {
+            r.status = RUN_EXIT;
+            break;
+        }
+        if (cpu.halted && !cpu.inte) {
+            r.status = RUN_HALT;
+            break;
+        }
+    }
+    metrics_add_run(r.instructions, r.cycles);
+    return r;
+}
@@ -0,0 +1,193 @@
+#include "cpm/bios.h"
+#include "cpm/bdos.h"
+#include "metrics/metrics.h"
+
+static void put16(Memory& mem, u16 addr, u16 v) {
+    mem.data[addr] = v & 0xFF;
+    mem.data[u16(addr + 1)] = v >> 8;
+}
+
+static void ret(CPU& cpu) {
+    cpu.pc = cpu.mem->read(cpu.sp) | (cpu.mem->read(cpu.sp + 1) << 8);
+    cpu.sp += 2;
+}
+
+bool bios_install(Memory& mem, Bios& bios) {
+    for (int e = 0; e < BIOS_ENTRIES; e++) {
+        mem.data[bios_entry(BiosEntry(e))] = 0xC3;
+        put16(mem, bios_entry(BiosEntry(e)) + 1, bios_entry(BiosEntry(e)));
+    }
+
+    // page zero: warm boot vector, BDOS vector (its target tops the TPA)
+    mem.data[0x0000] = 0xC3;
+    put16(mem, 0x0001, bios_entry(BIOS_WBOOT));
+    mem.data[0x0005] = 0xC3;
+    put16(mem, 0x0006, BIOS_BASE);
+
+    // parameter blocks, allocated upwards after the jump table
+    u32 next = bios_entry(BIOS_ENTRIES);
+    auto alloc = [&](u32 n) {
+        u32 at = next;
+        next += n;
+        return u16(at);
+    };
+    u16 dirbuf = alloc(CPM_SECTOR);
+
+    for (int d = 0; d < BIOS_DRIVES; d++) {
+        bios.dph[d] = 0;
+        if (!bios.drive[d])
+            continue;
+        const DiskFormat& f = *bios.drive[d]->image->format;
+
+        u16 spt = f.sectors;
+        u8 bsh = 0;
+        while ((CPM_SECTOR << bsh) < f.block_size)
+            bsh++;
+        u16 dsm = u16(u32(f.tracks - f.reserved) * f.sectors * CPM_SECTOR / f.block_size - 1);
+        u16 drm = f.dir_entries - 1;
+        u8 exm = (dsm < 256 ? f.block_size / 1024 : f.block_size / 2048) - 1;
+        u32 dir_blocks = (f.dir_entries * 32 + f.block_size - 1) / f.block_size;
+        u16 al = u16(0xFFFF0000u >> dir_blocks); // top dir_blocks bits
+        u16 cks = (f.dir_entries + 3) / 4;
+
+        u16 dpb = alloc(15);
+        put16(mem, dpb, spt);
+        mem.data[dpb + 2] = bsh;
+        mem.data[dpb + 3] = (1 << bsh) - 1;
+        mem.data[dpb + 4] = exm;
+        put16(mem, dpb + 5, dsm);
+        put16(mem, dpb + 7, drm);
+        mem.data[dpb + 9] = al >> 8;
+        mem.data[dpb + 10] = al & 0xFF;
+        put16(mem, dpb + 11, cks);
+        put16(mem, dpb + 13, f.reserved);
+
+        u16 xlt = 0;
+        if (f.skew) {
+            xlt = alloc(f.sectors);
+            for (int i = 0; i < f.sectors; i++)
+                mem.data[xlt + i] = f.skew[i];
+        }
+        u16 csv = alloc(cks);
+        u16 alv = alloc(dsm / 8 + 1);
+
+        u16 dph = alloc(16);
+        put16(mem, dph, xlt);
+        put16(mem, dph + 2, 0);
+        put16(mem, dph + 4, 0);
+        put16(mem, dph + 6, 0);
+        put16(mem, dph + 8, dirbuf);
+        put16(mem, dph + 10, dpb);
+        put16(mem, dph + 12, csv);
+        put16(mem, dph + 14, alv);
+        bios.dph[d] = dph;
+    }
+    mem.mark_written(0, 8);
+    mem.mark_written(BIOS_BASE, next - BIOS_BASE);
+    return next <= 0x10000;
+}
+
+// logical sector number of the current track/sector, or -1
+static long current_lsn(const Bios& b) {
+    const DiskOverlay* d = b.drive[b.disk];
+    if (!d)
+        return -1;
+    const DiskFormat& f = *d->image->format;
+    if (b.track >= f.tracks || b.sector < 1 || b.sector > f.sectors)
+        return -1;
+    return long(b.track) * f.sectors + (b.sector - 1);
+}
+
+bool bios_call(CPU& cpu, Console& con, Bios& b) {
+    metrics_add(metrics_local().bios);
+    switch ((cpu.pc - BIOS_BASE) / 3) {
+    case BIOS_BOOT:
+    case BIOS_WBOOT:
+        return false;
+
+    case BIOS_CONST:
+        cpu.a = console_ready(con, cpu) ? 0xFF : 0x00;
+        break;
+
+    case BIOS_CONIN:
+        cpu.a = console_read(con, cpu);
+        break;
+
+    case BIOS_CONOUT:
+        con.put(cpu.c);
+        break;
+
+    case BIOS_LISTST:
+        cpu.a = 0xFF; // list device always ready, output dropped
+        break;
+
+    case BIOS_READER:
+        cpu.a = 0x1A;
+        break;
+
+    case BIOS_HOME:
+        b.track = 0;
+        break;
+
+    case BIOS_SELDSK:
+        if (cpu.c < BIOS_DRIVES && b.drive[cpu.c]) {
+            b.disk = cpu.c;
+            cpu.setHL(b.dph[cpu.c]);
+        } else
+            cpu.setHL(0);
+        break;
+
+    case BIOS_SETTRK:
+        b.track = cpu.BC();
+        break;
+
+    case BIOS_SETSEC:
+        b.sector = cpu.BC();
+        break;
+
+    case BIOS_SETDMA:
+        b.dma = cpu.BC();
+        break;
+
+    case BIOS_SECTRAN: // physical sectors are 1-based
+        cpu.setHL(cpu.DE() ? cpu.mem->read(cpu.DE() + cpu.BC()) : cpu.BC() + 1);
+        break;
+
+    case BIOS_READ: {
+        long lsn = current_lsn(b);
+        if (lsn < 0) {
+            b.errors++;
+            cpu.a = 1;
+            break;
+        }
+        const u8* src = b.drive[b.disk]->read_sector(u32(lsn));
+        for (u32 i = 0; i < CPM_SECTOR; i++)
+            cpu.mem->write(b.dma + i, src[i]);
+        b.reads++;
+        cpu.a = 0;
+        break;
+    }
+
+    case BIOS_WRITE: {
+        long lsn = current_lsn(b);
+        if (lsn < 0) {
+            b.errors++;
+            cpu.a = 1;
+            break;
+        }
+        u8 buf[CPM_SECTOR];
+        for (u32 i = 0; i < CPM_SECTOR; i++)
+            buf[i] = cpu.mem->read(b.dma + i);
+        b.drive[b.disk]->write_sector(u32(lsn), buf);
+        b.writes++;
+        cpu.a = 0;
+        break;
+    }
+
+    default: // LIST, PUNCH: output dropped
+        break;
+    }
+
+    ret(cpu);
+    return true;
+}
@@ -0,0 +1,100 @@
+#include "cpm/disk.h"
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// standard 8" single density skew of 6
+static const u8 ibm3740_skew[26] = {1,  7,  13, 19, 25, 5,  11, 17, 23, 3,  9,  15, 21,
+                                    2,  8,  14, 20, 26, 6,  12, 18, 24, 4,  10, 16, 22};
+
+const DiskFormat disk_formats[] = {
+    {"ibm-3740", 77, 26, 2, 1024, 64, ibm3740_skew},
+    {"z80pack-hd", 255, 128, 0, 2048, 1024, nullptr}, // 4 MB hard disk
+};
+const int disk_format_count = sizeof(disk_formats) / sizeof(disk_formats[0]);
+
+const DiskFormat* find_disk_format(const char* name, size_t bytes) {
+    for (const DiskFormat& f : disk_formats)
+        if (name ? strcmp(name, f.name) == 0 : disk_bytes(f) == bytes)
+            return &f;
+    return nullptr;
+}
+
+bool DiskImage::open(const char* path, const char* fmt) {
+    close();
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        printf("Failed to open disk image: %s\n", path);
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+
+    format = find_disk_format(fmt, st.st_size);
+    if (!format || size_t(st.st_size) < disk_bytes(*format)) {
+        printf("Unknown or short disk image: %s\n", path);
+        ::close(fd);
+        return false;
+    }
+
+    size = disk_bytes(*format);
+    void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        size = 0;
+        return false;
+    }
+    base = static_cast<const u8*>(p);
+    return true;
+}
+
+void DiskImage::close() {
+    if (base)
+        munmap(const_cast<u8*>(base), size);
+    base = nullptr;
+    size = 0;
+}
+
+void DiskOverlay::attach(const DiskImage& img) {
+    discard();
+    image = &img;
+    chunks.assign((img.size + CHUNK - 1) / CHUNK, nullptr);
+}
+
+void DiskOverlay::discard() {
+    for (u8*& c : chunks) {
+        delete[] c;
+        c = nullptr;
+    }
+}
+
+size_t DiskOverlay::private_bytes() const {
+    size_t n = chunks.capacity() * sizeof(u8*);
+    for (u8* c : chunks)
+        n += c ? CHUNK : 0;
+    return n;
+}
+
+const u8* DiskOverlay::read_sector(u32 lsn) const {
+    size_t off = size_t(lsn) * CPM_SECTOR;
+    const u8* c = chunks[off / CHUNK];
+    return c ? c + off % CHUNK : image->base + off;
+}
+
+void DiskOverlay::write_sector(u32 lsn, const u8* src) {
+    size_t off = size_t(lsn) * CPM_SECTOR;
+    u8*& c = chunks[off / CHUNK];
+    if (!c) {
+        size_t start = off / CHUNK * CHUNK;
+        size_t len = image->size - start < CHUNK ? image->size - start : CHUNK;
+        c = new u8[CHUNK];
+        std::memcpy(c, image->base + start, len);
+    }
+    std::memcpy(c + off % CHUNK, src, CPM_SECTOR);
+}
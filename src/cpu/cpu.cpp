@@ -1,6 +1,7 @@
 #include "cpu/cpu.h"
 #include "cpu/opcodes.h"
 #include "cpu/instructions.h"
+#include "metrics/metrics.h"
 #include <cstdio>
 
 
@@ -8,47 +9,52 @@
 
 
 void CPU::reset(){
-    a=b=c=d=e=h=l=0;
+    bc=de=hl=0;
+    a=0;
     pc=sp=0;
     flags.f =0x2; // bit 1 always set
     inte=false;
-}
-
-u16 CPU::BC() {
-    return (u16(b) << 8) | u16(c);
-}
-
-u16 CPU::DE() {
-    return (u16(d) << 8) | u16(e);
-}
-
-u16 CPU::HL() {
-    return (u16(h) << 8) | u16(l);
-}
-
-void CPU::setBC(u16 v) {
-    b = (v >> 8) & 0xFF;
-    c = v & 0xFF;
-}
-
-void CPU::setDE(u16 v) {
-    d = (v >> 8) & 0xFF;
-    e = v & 0xFF;
-}
-
-void CPU::setHL(u16 v) {
-    h = (v >> 8) & 0xFF;
-    l = v & 0xFF;
+    halted=false;
+    cycles=0;
 }
 
 int CPU::step() {
-    return execute_instruction(*this);
-}
-
-u8 CPU::in(u8 port) {
-    return 0x00; // change this
-}
-
-void CPU::out(u8 port, u8 value) {
-    // chnange
+    if (halted) {
+        // HLT idles until an interrupt
+        metrics_add(metrics_local().halt_cycles, 4);
+        cycles += 4;
+        return 4;
+    }
+    int n = execute_instruction(*this);
+    cycles += n;
+    return n;
+}
+
+int CPU::interrupt(u8 rst) {
+    if (!inte)
+        return 0;
+    inte = false;
+    halted = false;
+    sp -= 2;
+    mem->write(sp + 1, pc >> 8);
+    mem->write(sp, pc & 0xFF);
+    pc = rst & 0x38;
+    cycles += 11;
+    return 11;
+}
+
+// Out of line, so the port counters stay out of the interpreter switch.
+// Port-heavy code misses the 1% metrics budget: a count is about 0.7 ns
+// (bench metrics), 7-8% of an average instruction when every instruction
+// is IN or OUT, and by the same measure about 2% for the Invaders loop,
+// which does port I/O on 4 of 14 instructions.
+__attribute__((noinline)) u8 CPU::in(u8 port) {
+    metrics_add(metrics_local().port_in[port]);
+    return io ? io->in(io->ctx, port) : 0x00;
+}
+
+__attribute__((noinline)) void CPU::out(u8 port, u8 value) {
+    metrics_add(metrics_local().port_out[port]);
+    if (io)
+        io->out(io->ctx, port, value);
 }
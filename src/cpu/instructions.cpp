@@ -1,9 +1,12 @@
 #include "cpu/instructions.h"
 #include "cpu/flags.h"
-#include "cpu/opcodes.h"
+#include "cpu/isa.h"
 #include "cpu/cpu.h"
-#include <cstdio>
-static int count = 0;
+
+// One handler per opcode, specialized at compile time from its isa_table
+// entry: operand fields, lengths and cycles are constants, and only the
+// operation's code is left in each case of the switch below.
+
 static inline u16 read_u16(CPU &cpu)
 {
     return cpu.mem->read(cpu.pc + 1) | (cpu.mem->read(cpu.pc + 2) << 8);
@@ -22,59 +25,76 @@ static inline u16 pop(CPU &cpu)
     return (hi << 8) | lo;
 }
 
-static inline u8 read_reg(CPU &cpu, u8 code)
+// register field: B C D E H L M A
+template <u8 R>
+static inline u8 get_reg(CPU &cpu)
 {
-    switch (code)
-    {
-    case 0:
+    if constexpr (R == 0)
         return cpu.b;
-    case 1:
+    else if constexpr (R == 1)
         return cpu.c;
-    case 2:
+    else if constexpr (R == 2)
         return cpu.d;
-    case 3:
+    else if constexpr (R == 3)
         return cpu.e;
-    case 4:
+    else if constexpr (R == 4)
         return cpu.h;
-    case 5:
+    else if constexpr (R == 5)
         return cpu.l;
-    case 6:
-        return cpu.mem->read(cpu.HL()); // M
-    case 7:
+    else if constexpr (R == 6)
+        return cpu.mem->read(cpu.hl);
+    else
         return cpu.a;
-    }
-    return 0;
 }
 
-static inline void write_reg(CPU &cpu, u8 code, u8 val)
+template <u8 R>
+static inline void set_reg(CPU &cpu, u8 val)
 {
-    switch (code)
-    {
-    case 0:
+    if constexpr (R == 0)
         cpu.b = val;
-        break;
-    case 1:
+    else if constexpr (R == 1)
         cpu.c = val;
-        break;
-    case 2:
+    else if constexpr (R == 2)
         cpu.d = val;
-        break;
-    case 3:
+    else if constexpr (R == 3)
         cpu.e = val;
-        break;
-    case 4:
+    else if constexpr (R == 4)
         cpu.h = val;
-        break;
-    case 5:
+    else if constexpr (R == 5)
         cpu.l = val;
-        break;
-    case 6:
-        cpu.mem->write(cpu.HL(), val);
-        break; // M
-    case 7:
+    else if constexpr (R == 6)
+        cpu.mem->write(cpu.hl, val);
+    else
         cpu.a = val;
-        break;
-    }
+}
+
+// register pair field: BC DE HL SP
+template <u8 P>
+static inline u16 &pair(CPU &cpu)
+{
+    if constexpr (P == 0)
+        return cpu.bc;
+    else if constexpr (P == 1)
+        return cpu.de;
+    else if constexpr (P == 2)
+        return cpu.hl;
+    else
+        return cpu.sp;
+}
+
+// condition field: NZ Z NC C PO PE P M
+template <u8 C>
+static inline bool condition(const CPU &cpu)
+{
+    constexpr bool set = C & 1;
+    if constexpr (C >> 1 == 0)
+        return cpu.flags.z == set;
+    else if constexpr (C >> 1 == 1)
+        return cpu.flags.c == set;
+    else if constexpr (C >> 1 == 2)
+        return cpu.flags.p == set;
+    else
+        return cpu.flags.s == set;
 }
 
 static inline void add_to_a(CPU &cpu, u8 value, bool with_carry)
@@ -94,7 +114,7 @@ static inline void sub_from_a(CPU &cpu, u8 value, bool with_borrow)
     u8 borrow = with_borrow ? cpu.flags.c : 0;
     u16 result = cpu.a - value - borrow;
 
-    cpu.flags.ac = ((cpu.a & 0x0F) < ((value & 0x0F) + borrow));
+    cpu.flags.ac = (((cpu.a & 0x0F) + (~value & 0x0F) + !borrow) > 0x0F);
     cpu.flags.c = (result > 0xFF);
 
     cpu.a = result & 0xFF;
@@ -134,965 +154,243 @@ static inline void cmp_a(CPU &cpu, u8 value)
     cpu.flags.s = (res8 & 0x80) != 0;
     cpu.flags.p = parity(res8);
     cpu.flags.c = (result > 0xFF);
-    cpu.flags.ac = ((cpu.a & 0x0F) < (value & 0x0F));
+    cpu.flags.ac = (((cpu.a & 0x0F) + (~value & 0x0F) + 1) > 0x0F);
 }
 
-int execute_instruction(CPU &cpu)
+// ALU field: ADD ADC SUB SBB ANA XRA ORA CMP
+template <u8 A>
+static inline void alu(CPU &cpu, u8 value)
 {
-    u8 opcode = cpu.mem->read(cpu.pc);
+    if constexpr (A == 0 || A == 1)
+        add_to_a(cpu, value, A == 1);
+    else if constexpr (A == 2 || A == 3)
+        sub_from_a(cpu, value, A == 3);
+    else if constexpr (A == 4)
+        ana_a(cpu, value);
+    else if constexpr (A == 5)
+        xra_a(cpu, value);
+    else if constexpr (A == 6)
+        ora_a(cpu, value);
+    else
+        cmp_a(cpu, value);
+}
 
-    // MOV r1, r2 : 0x40 – 0x7F (except 0x76)
-    if ((opcode & 0xC0) == 0x40)
-    {
+static inline void daa(CPU &cpu)
+{
+    u8 correction = 0;
+    u8 orig = cpu.a;
+    bool carry_in = cpu.flags.c;
 
-        if (opcode == 0x76)
-        { // HLT
-            cpu.halted = true;
-            cpu.pc += 1;
-            return opcode_table[opcode].cycles;
-        }
+    // Lower nibble correction
+    if ((orig & 0x0F) > 9 || cpu.flags.ac)
+        correction |= 0x06;
 
-        u8 dst = (opcode >> 3) & 0x07;
-        u8 src = opcode & 0x07;
+    // Upper nibble correction (and decide carry)
+    if ((orig >> 4) > 9 || carry_in || (((orig >> 4) >= 9) && ((orig & 0x0F) > 9)))
+        correction |= 0x60;
 
-        u8 val = read_reg(cpu, src);
-        write_reg(cpu, dst, val);
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-    }
+    u16 res = orig + correction;
 
-    // ADD / ADC group: 0x80–0x8F
-    if ((opcode & 0xF0) == 0x80)
-    {
+    // Auxiliary carry: carry from bit 3 when adding correction to low nibble
+    cpu.flags.ac = ((orig & 0x0F) + (correction & 0x0F)) > 0x0F;
 
-        u8 src = opcode & 0x07;
-        bool is_adc = (opcode & 0x08) != 0;
+    // Carry: set by the upper correction, never cleared by DAA
+    cpu.flags.c = (correction & 0x60) != 0;
 
-        u8 value;
-        if (src == 6)
-            value = cpu.mem->read(cpu.HL());
-        else
-            value = read_reg(cpu, src);
+    cpu.a = res & 0xFF;
+    setZSP(cpu.flags, cpu.a);
+}
 
-        add_to_a(cpu, value, is_adc);
+template <u8 OP>
+static inline int exec(CPU &cpu)
+{
+    constexpr IsaInsn I = isa_table[OP];
+    constexpr u8 y = I.y, z = I.z, rp = I.rp;
 
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
+    if constexpr (I.op == ISA_NOP)
+    {
     }
-
-    // SUB / SBB group: 0x90–0x9F
-    if ((opcode & 0xF0) == 0x90)
+    else if constexpr (I.op == ISA_HLT)
+        cpu.halted = true;
+    else if constexpr (I.op == ISA_MOV)
+        set_reg<y>(cpu, get_reg<z>(cpu));
+    else if constexpr (I.op == ISA_ALU)
+        alu<y>(cpu, get_reg<z>(cpu));
+    else if constexpr (I.op == ISA_ALU_IMM)
+        alu<y>(cpu, cpu.mem->read(cpu.pc + 1));
+    else if constexpr (I.op == ISA_MVI)
+        set_reg<y>(cpu, cpu.mem->read(cpu.pc + 1));
+    else if constexpr (I.op == ISA_INR)
     {
-
-        u8 src = opcode & 0x07;
-        bool is_sbb = (opcode & 0x08) != 0;
-
-        u8 value;
-        if (src == 6)
-            value = cpu.mem->read(cpu.HL());
-        else
-            value = read_reg(cpu, src);
-
-        sub_from_a(cpu, value, is_sbb);
-
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
+        u8 val = get_reg<y>(cpu);
+        cpu.flags.ac = ((val & 0x0F) == 0x0F);
+        val++;
+        set_reg<y>(cpu, val);
+        setZSP(cpu.flags, val);
     }
-
-    // ANA / XRA group: 0xA0–0xAF
-    if ((opcode & 0xF0) == 0xA0)
+    else if constexpr (I.op == ISA_DCR)
     {
-
-        u8 src = opcode & 0x07;
-        bool is_xra = (opcode & 0x08) != 0;
-
-        u8 value;
-        if (src == 6)
-            value = cpu.mem->read(cpu.HL());
-        else
-            value = read_reg(cpu, src);
-
-        if (is_xra)
-            xra_a(cpu, value);
-        else
-            ana_a(cpu, value);
-
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
+        u8 val = get_reg<y>(cpu);
+        cpu.flags.ac = ((val & 0x0F) != 0x00);
+        val--;
+        set_reg<y>(cpu, val);
+        setZSP(cpu.flags, val);
     }
-
-    // ORA / CMP group: 0xB0–0xBF
-    if ((opcode & 0xF0) == 0xB0)
+    else if constexpr (I.op == ISA_LXI)
+        pair<rp>(cpu) = read_u16(cpu);
+    else if constexpr (I.op == ISA_INX)
+        pair<rp>(cpu)++;
+    else if constexpr (I.op == ISA_DCX)
+        pair<rp>(cpu)--;
+    else if constexpr (I.op == ISA_DAD)
     {
-
-        u8 src = opcode & 0x07;
-        bool is_cmp = (opcode & 0x08) != 0;
-
-        u8 value;
-        if (src == 6)
-            value = cpu.mem->read(cpu.HL());
-        else
-            value = read_reg(cpu, src);
-
-        if (is_cmp)
-            cmp_a(cpu, value);
-        else
-            ora_a(cpu, value);
-
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
+        u32 res = cpu.hl + pair<rp>(cpu);
+        cpu.flags.c = res > 0xFFFF;
+        cpu.hl = u16(res);
     }
-
-    // Rest opcodes
-    switch (opcode)
+    else if constexpr (I.op == ISA_STAX)
+        cpu.mem->write(pair<rp>(cpu), cpu.a);
+    else if constexpr (I.op == ISA_LDAX)
+        cpu.a = cpu.mem->read(pair<rp>(cpu));
+    else if constexpr (I.op == ISA_SHLD)
+    {
+        u16 addr = read_u16(cpu);
+        cpu.mem->write(addr, cpu.l);
+        cpu.mem->write(addr + 1, cpu.h);
+    }
+    else if constexpr (I.op == ISA_LHLD)
+    {
+        u16 addr = read_u16(cpu);
+        cpu.l = cpu.mem->read(addr);
+        cpu.h = cpu.mem->read(addr + 1);
+    }
+    else if constexpr (I.op == ISA_STA)
+        cpu.mem->write(read_u16(cpu), cpu.a);
+    else if constexpr (I.op == ISA_LDA)
+        cpu.a = cpu.mem->read(read_u16(cpu));
+    else if constexpr (I.op == ISA_RLC)
     {
-
-    case 0x00: // NOP
-        break;
-
-    case 0x01: // LXI B,d16 | loads high byte into B , low byte into C
-        cpu.b = cpu.mem->read(cpu.pc + 2);
-        cpu.c = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x02: // STAX B | [BC]=A stores content of register A at location BC
-        cpu.mem->write(cpu.BC(), cpu.a);
-        break;
-
-    case 0x03: // INX B | BC=BC+1
-        cpu.setBC(cpu.BC() + 1);
-        break;
-
-    case 0x04: // INR B | B=B+1
-        cpu.flags.ac = ((cpu.b & 0x0F) == 0x0F);
-        cpu.b = cpu.b + 1;
-        setZSP(cpu.flags, cpu.b);
-        break;
-
-    case 0x05: // DCR B
-        /*cpu.flags.ac = ((cpu.b & 0x0F) == 0x00);
-        cpu.b = cpu.b - 1;
-        setZSP(cpu.flags, cpu.b);
-        break;*/
-        cpu.flags.ac = ((cpu.b ^ (cpu.b-1) ^ 0x01) & 0x10) != 0;
-        cpu.b--;
-        setZSP(cpu.flags, cpu.b);
-        break;
-
-    case 0x06: // MVI B,D8
-        cpu.b = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x07:
-    { // RLC
         u8 msb = (cpu.a >> 7) & 1;
         cpu.a = (cpu.a << 1) | msb;
         cpu.flags.c = msb;
-        break;
     }
-    case 0x08: // NOP
-        break;
-
-    case 0x09:
-    { // DAD B
-        u32 res = cpu.HL() + cpu.BC();
-        cpu.flags.c = res > 0xFFFF;
-        cpu.setHL(res & 0xFFFF);
-        break;
-    }
-    case 0x0A: // LDAX B
-        cpu.a = cpu.mem->read(cpu.BC());
-        break;
-
-    case 0x0B: // DCX B
-        cpu.setBC(cpu.BC() - 1);
-        break;
-
-    case 0x0C: // INR C
-        cpu.flags.ac = ((cpu.c & 0x0F) == 0x0F);
-        cpu.c = cpu.c + 1;
-        setZSP(cpu.flags, cpu.c);
-        break;
-
-    case 0x0D: // DCR C
-        cpu.flags.ac = ((cpu.c & 0x0F) == 0x00);
-        cpu.c = cpu.c - 1;
-        setZSP(cpu.flags, cpu.c);
-        break;
-
-    case 0x0E: // MVI C,d8
-        cpu.c = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x0F:
-    { // RRC
-        u8 lsb = (cpu.a) & 1;
+    else if constexpr (I.op == ISA_RRC)
+    {
+        u8 lsb = cpu.a & 1;
         cpu.a = (cpu.a >> 1) | (lsb << 7);
         cpu.flags.c = lsb;
-        break;
     }
-    case 0x10: // NOP
-        break;
-
-    case 0x11: // LXI D,d16
-        cpu.e = cpu.mem->read(cpu.pc + 1);
-        cpu.d = cpu.mem->read(cpu.pc + 2);
-        break;
-
-    case 0x12: // STAX D
-        cpu.mem->write(cpu.DE(), cpu.a);
-        break;
-
-    case 0x13: // INX D
-        cpu.setDE(cpu.DE() + 1);
-        break;
-
-    case 0x14: // INR D
-        cpu.flags.ac = ((cpu.d & 0x0F) == 0x0F);
-        cpu.d++;
-        setZSP(cpu.flags, cpu.d);
-        break;
-
-    case 0x15: // DCR D
-        cpu.flags.ac = ((cpu.d & 0x0F) == 0x00);
-        cpu.d--;
-        setZSP(cpu.flags, cpu.d);
-        break;
-
-    case 0x16: // MVI D,d8
-        cpu.d = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x17:
-    { // RAL
+    else if constexpr (I.op == ISA_RAL)
+    {
         u8 old_cy = cpu.flags.c;
-        u8 msb = (cpu.a >> 7) & 1;
+        cpu.flags.c = (cpu.a >> 7) & 1;
         cpu.a = (cpu.a << 1) | old_cy;
-        cpu.flags.c = msb;
-        break;
     }
-
-    case 0x18: // NOP
-        break;
-
-    case 0x19:
-    { // DAD D
-        u32 res = cpu.HL() + cpu.DE();
-        cpu.flags.c = res > 0xFFFF;
-        cpu.setHL(res & 0xFFFF);
-        break;
-    }
-
-    case 0x1A: // LDAX D
-        cpu.a = cpu.mem->read(cpu.DE());
-        break;
-
-    case 0x1B: // DCX D
-        cpu.setDE(cpu.DE() - 1);
-        break;
-
-    case 0x1C: // INR E
-        cpu.flags.ac = ((cpu.e & 0x0F) == 0x0F);
-        cpu.e++;
-        setZSP(cpu.flags, cpu.e);
-        break;
-
-    case 0x1D: // DCR E
-        cpu.flags.ac = ((cpu.e & 0x0F) == 0x00);
-        cpu.e--;
-        setZSP(cpu.flags, cpu.e);
-        break;
-
-    case 0x1E: // MVI E,d8
-        cpu.e = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x1F:
-    { // RAR
+    else if constexpr (I.op == ISA_RAR)
+    {
         u8 old_cy = cpu.flags.c;
-        u8 lsb = cpu.a & 1;
+        cpu.flags.c = cpu.a & 1;
         cpu.a = (cpu.a >> 1) | (old_cy << 7);
-        cpu.flags.c = lsb;
-        break;
-    }
-
-    case 0x20: // NOP
-        break;
-
-    case 0x21: // LXI H,d16
-        cpu.l = cpu.mem->read(cpu.pc + 1);
-        cpu.h = cpu.mem->read(cpu.pc + 2);
-        break;
-
-    case 0x22:
-    { // SHLD adr
-        u16 addr = cpu.mem->read(cpu.pc + 1) | (cpu.mem->read(cpu.pc + 2) << 8);
-        cpu.mem->write(addr, cpu.l);
-        cpu.mem->write(addr + 1, cpu.h);
-        break;
-    }
-
-    case 0x23: // INX H
-        cpu.setHL(cpu.HL() + 1);
-        break;
-
-    case 0x24: // INR H
-        cpu.flags.ac = ((cpu.h & 0x0F) == 0x0F);
-        cpu.h++;
-        setZSP(cpu.flags, cpu.h);
-        break;
-
-    case 0x25: // DCR H
-        cpu.flags.ac = ((cpu.h & 0x0F) == 0x00);
-        cpu.h--;
-        setZSP(cpu.flags, cpu.h);
-        break;
-
-    case 0x26: // MVI H,d8
-        cpu.h = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x27:
-    { // DAA
-        u8 correction = 0;
-        // Save original value and flags
-        u8 orig = cpu.a;
-        bool carry_in = cpu.flags.c;
-
-        // Lower nibble correction
-        if ((orig & 0x0F) > 9 || cpu.flags.ac)
-            correction |= 0x06;
-
-        // Upper nibble correction (and decide carry)
-        if ((orig >> 4) > 9 || carry_in || (((orig >> 4) >= 9) && ((orig & 0x0F) > 9)))
-            correction |= 0x60;
-
-        u16 res = orig + correction;
-
-        // Auxiliary carry: carry from bit 3 when adding correction to low nibble
-        cpu.flags.ac = ((orig & 0x0F) + (correction & 0x0F)) > 0x0F;
-
-        // Carry: carry out of the byte addition
-        cpu.flags.c = (res > 0xFF);
-
-        cpu.a = res & 0xFF;
-
-        setZSP(cpu.flags, cpu.a);
-        break;
-    }
-
-    case 0x28: // NOP
-        break;
-
-    case 0x29:
-    { // DAD H
-        u32 res = cpu.HL() + cpu.HL();
-        cpu.flags.c = (res > 0xFFFF);
-        cpu.setHL(res & 0xFFFF);
-        break;
-    }
-
-    case 0x2A:
-    { // LHLD adr
-        u16 addr = cpu.mem->read(cpu.pc + 1) | (cpu.mem->read(cpu.pc + 2) << 8);
-        cpu.l = cpu.mem->read(addr);
-        cpu.h = cpu.mem->read(addr + 1);
-        break;
     }
-
-    case 0x2B: // DCX H
-        cpu.setHL(cpu.HL() - 1);
-        break;
-
-    case 0x2C: // INR L
-        cpu.flags.ac = ((cpu.l & 0x0F) == 0x0F);
-        cpu.l++;
-        setZSP(cpu.flags, cpu.l);
-        break;
-
-    case 0x2D: // DCR L
-        cpu.flags.ac = ((cpu.l & 0x0F) == 0x00);
-        cpu.l--;
-        setZSP(cpu.flags, cpu.l);
-        break;
-
-    case 0x2E: // MVI L,d8
-        cpu.l = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x2F: // CMA
+    else if constexpr (I.op == ISA_DAA)
+        daa(cpu);
+    else if constexpr (I.op == ISA_CMA)
         cpu.a = ~cpu.a;
-        break;
-
-    case 0x30: // NOP
-        break;
-
-    case 0x31: // LXI SP,d16
-        cpu.sp = cpu.mem->read(cpu.pc + 1) | (cpu.mem->read(cpu.pc + 2) << 8);
-        break;
-
-    case 0x32:
-    { // STA adr
-        u16 addr = cpu.mem->read(cpu.pc + 1) | (cpu.mem->read(cpu.pc + 2) << 8);
-        cpu.mem->write(addr, cpu.a);
-        break;
-    }
-
-    case 0x33: // INX SP
-        cpu.sp++;
-        break;
-
-    case 0x34:
-    { // INR M
-        u16 addr = cpu.HL();
-        u8 val = cpu.mem->read(addr);
-        cpu.flags.ac = ((val & 0x0F) == 0x0F);
-        val++;
-        cpu.mem->write(addr, val);
-        setZSP(cpu.flags, val);
-        break;
-    }
-
-    case 0x35:
-    { // DCR M
-        u16 addr = cpu.HL();
-        u8 val = cpu.mem->read(addr);
-        cpu.flags.ac = ((val & 0x0F) == 0x00);
-        val--;
-        cpu.mem->write(addr, val);
-        setZSP(cpu.flags, val);
-        break;
-    }
-
-    case 0x36: // MVI M,d8
-        cpu.mem->write(cpu.HL(), cpu.mem->read(cpu.pc + 1));
-        break;
-
-    case 0x37: // STC
+    else if constexpr (I.op == ISA_STC)
         cpu.flags.c = 1;
-        break;
-
-    case 0x38: // NOP
-        break;
-
-    case 0x39:
-    { // DAD SP
-        u32 res = cpu.HL() + cpu.sp;
-        cpu.flags.c = (res > 0xFFFF);
-        cpu.setHL(res & 0xFFFF);
-        break;
-    }
-
-    case 0x3A:
-    { // LDA adr
-        u16 addr = cpu.mem->read(cpu.pc + 1) | (cpu.mem->read(cpu.pc + 2) << 8);
-        cpu.a = cpu.mem->read(addr);
-        break;
-    }
-
-    case 0x3B: // DCX SP
-        cpu.sp--;
-        break;
-
-    case 0x3C: // INR A
-        cpu.flags.ac = ((cpu.a & 0x0F) == 0x0F);
-        cpu.a++;
-        setZSP(cpu.flags, cpu.a);
-        break;
-        /*
-        if (count < 50)
-        {
-            printf("INR A before: A=%02X F=%02X\n", cpu.a, cpu.flags.f);
-        }
-
-        cpu.flags.ac = ((cpu.a & 0x0F) == 0x0F);
-        cpu.a++;
-        setZSP(cpu.flags, cpu.a);
-
-        if (count < 50)
-        {
-            printf("INR A after : A=%02X F=%02X\n\n", cpu.a, cpu.flags.f);
-        }
-        count++;
-        break;
-        */
-
-    case 0x3D: // DCR A
-        cpu.flags.ac = ((cpu.a & 0x0F) == 0x00);
-        cpu.a--;
-        setZSP(cpu.flags, cpu.a);
-        break;
-
-    case 0x3E: // MVI A,d8
-        cpu.a = cpu.mem->read(cpu.pc + 1);
-        break;
-
-    case 0x3F: // CMC
+    else if constexpr (I.op == ISA_CMC)
         cpu.flags.c = !cpu.flags.c;
-        break;
-
-    case 0xC0: // RNZ
-        if (!cpu.flags.z)
-        {
-            cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xC1: // POP B
-        cpu.setBC(pop(cpu));
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xC2: // JNZ adr
-        if (!cpu.flags.z)
+    else if constexpr (I.op == ISA_JMP || I.op == ISA_JCC)
+    {
+        if (I.op == ISA_JMP || condition<y>(cpu))
         {
             cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
+            return I.cycles;
         }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xC3: // JMP adr
-        cpu.pc = read_u16(cpu);
-        return opcode_table[opcode].cycles;
-
-    case 0xC4: // CNZ adr
-        if (!cpu.flags.z)
-        {
-            push(cpu, cpu.pc + 3);
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xC5: // PUSH B
-        push(cpu, cpu.BC());
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xC6:
-    { // ADI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        add_to_a(cpu, val, false);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
     }
-
-    case 0xC7: // RST 0
-        push(cpu, cpu.pc + 1);
-        cpu.pc = 0x00;
-        return opcode_table[opcode].cycles;
-
-    case 0xC8: // RZ
-        if (cpu.flags.z)
-        {
-            cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xC9: // RET
-        cpu.pc = pop(cpu);
-        return opcode_table[opcode].cycles;
-
-    case 0xCA: // JZ adr
-        if (cpu.flags.z)
-        {
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xCC: // CZ adr
-        if (cpu.flags.z)
+    else if constexpr (I.op == ISA_CALL || I.op == ISA_CCC)
+    {
+        if (I.op == ISA_CALL || condition<y>(cpu))
         {
             push(cpu, cpu.pc + 3);
             cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
+            return I.cycles_taken;
         }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xCD: // CALL adr
-        push(cpu, cpu.pc + 3);
-        cpu.pc = read_u16(cpu);
-        return opcode_table[opcode].cycles;
-
-    case 0xCE:
-    { // ACI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        add_to_a(cpu, val, true);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
-        break;
     }
-
-    case 0xCF: // RST 1
-        push(cpu, cpu.pc + 1);
-        cpu.pc = 0x08;
-        return opcode_table[opcode].cycles;
-
-    case 0xD0: // RNC
-        if (!cpu.flags.c)
+    else if constexpr (I.op == ISA_RET || I.op == ISA_RCC)
+    {
+        if (I.op == ISA_RET || condition<y>(cpu))
         {
             cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xD1: // POP D
-        cpu.setDE(pop(cpu));
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xD2: // JNC adr
-        if (!cpu.flags.c)
-        {
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
+            return I.cycles_taken;
         }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xD3: // OUT d8
-        cpu.out(cpu.mem->read(cpu.pc + 1), cpu.a);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
-
-    case 0xD4: // CNC adr
-        if (!cpu.flags.c)
-        {
-            push(cpu, cpu.pc + 3);
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xD5: // PUSH D
-        push(cpu, cpu.DE());
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xD6:
-    { // SUI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        sub_from_a(cpu, val, false);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
     }
-
-    case 0xD7: // RST 2
+    else if constexpr (I.op == ISA_RST)
+    {
         push(cpu, cpu.pc + 1);
-        cpu.pc = 0x10;
-        return opcode_table[opcode].cycles;
-
-    case 0xD8: // RC
-        if (cpu.flags.c)
-        {
-            cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xDA: // JC adr
-        if (cpu.flags.c)
-        {
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xDB:
-    { // IN d8
-        u8 port = cpu.mem->read(cpu.pc + 1);
-        cpu.a = cpu.in(port);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
+        cpu.pc = y * 8;
+        return I.cycles;
     }
-
-    case 0xDC: // CC adr
-        if (cpu.flags.c)
-        {
-            push(cpu, cpu.pc + 3);
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xDE:
-    { // SBI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        sub_from_a(cpu, val, true);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
+    else if constexpr (I.op == ISA_PCHL)
+    {
+        cpu.pc = cpu.hl;
+        return I.cycles;
     }
-
-    case 0xDF: // RST 3
-        push(cpu, cpu.pc + 1);
-        cpu.pc = 0x18;
-        return opcode_table[opcode].cycles;
-
-    case 0xE0: // RPO
-        if (!cpu.flags.p)
-        {
-            cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xE1: // POP H
-        cpu.setHL(pop(cpu));
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xE2: // JPO adr
-        if (!cpu.flags.p)
-        {
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xE3:
-    { // XTHL
+    else if constexpr (I.op == ISA_PUSH)
+    {
+        if constexpr (rp == 3)
+            push(cpu, cpu.psw | 0x02);
+        else
+            push(cpu, pair<rp>(cpu));
+    }
+    else if constexpr (I.op == ISA_POP)
+    {
+        if constexpr (rp == 3)
+            cpu.psw = (pop(cpu) & 0xFFD7) | 0x02; // bits 3 and 5 read 0, bit 1 reads 1
+        else
+            pair<rp>(cpu) = pop(cpu);
+    }
+    else if constexpr (I.op == ISA_XTHL)
+    {
         u8 lo = cpu.mem->read(cpu.sp);
         u8 hi = cpu.mem->read(cpu.sp + 1);
-
         cpu.mem->write(cpu.sp, cpu.l);
         cpu.mem->write(cpu.sp + 1, cpu.h);
-
         cpu.l = lo;
         cpu.h = hi;
-
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
     }
-
-    case 0xE4: // CPO adr
-        if (!cpu.flags.p)
-        {
-            push(cpu, cpu.pc + 3);
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xE5: // PUSH H
-        push(cpu, cpu.HL());
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xE6:
-    { // ANI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        cpu.flags.ac = ((cpu.a | val) & 0x08) != 0;
-        cpu.a &= val;
-        cpu.flags.c = 0;
-        setZSP(cpu.flags, cpu.a);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
-    }
-
-    case 0xE7: // RST 4
-        push(cpu, cpu.pc + 1);
-        cpu.pc = 0x20;
-        return opcode_table[opcode].cycles;
-
-    case 0xE8: // RPE
-        if (cpu.flags.p)
-        {
-            cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xE9: // PCHL
-        cpu.pc = cpu.HL();
-        return opcode_table[opcode].cycles;
-
-    case 0xEA: // JPE adr
-        if (cpu.flags.p)
-        {
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xEB:
-    { // XCHG
-        u8 td = cpu.d, te = cpu.e;
-        cpu.d = cpu.h;
-        cpu.e = cpu.l;
-        cpu.h = td;
-        cpu.l = te;
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-    }
-
-    case 0xEC: // CPE adr
-        if (cpu.flags.p)
-        {
-            push(cpu, cpu.pc + 3);
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xEE:
-    { // XRI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        cpu.a ^= val;
-        cpu.flags.c = 0;
-        cpu.flags.ac = 0;
-        setZSP(cpu.flags, cpu.a);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
-    }
-
-    case 0xEF: // RST 5
-        push(cpu, cpu.pc + 1);
-        cpu.pc = 0x28;
-        return opcode_table[opcode].cycles;
-
-    case 0xF0: // RP
-        if (!cpu.flags.s)
-        {
-            cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xF1:
-    { // POP PSW
-        u16 psw = pop(cpu);
-        cpu.flags.f = psw & 0xFF;
-        cpu.flags.f |= 0x02; // bit 1 always set
-        cpu.a = (psw >> 8) & 0xFF;
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-    }
-
-    case 0xF2: // JP adr
-        if (!cpu.flags.s)
-        {
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xF3: // DI
+    else if constexpr (I.op == ISA_XCHG)
+    {
+        u16 de = cpu.de;
+        cpu.de = cpu.hl;
+        cpu.hl = de;
+    }
+    else if constexpr (I.op == ISA_SPHL)
+        cpu.sp = cpu.hl;
+    else if constexpr (I.op == ISA_IN)
+        cpu.a = cpu.in(cpu.mem->read(cpu.pc + 1));
+    else if constexpr (I.op == ISA_OUT)
+        cpu.out(cpu.mem->read(cpu.pc + 1), cpu.a);
+    else if constexpr (I.op == ISA_DI)
         cpu.inte = false;
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xF4: // CP adr
-        if (!cpu.flags.s)
-        {
-            push(cpu, cpu.pc + 3);
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xF5:
-    { // PUSH PSW
-        u16 psw = (cpu.a << 8) | (cpu.flags.f | 0x02);
-        push(cpu, psw);
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-    }
-
-    case 0xF6:
-    { // ORI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        cpu.a |= val;
-        cpu.flags.c = 0;
-        cpu.flags.ac = 0;
-        setZSP(cpu.flags, cpu.a);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
-    }
-
-    case 0xF7: // RST 6
-        push(cpu, cpu.pc + 1);
-        cpu.pc = 0x30;
-        return opcode_table[opcode].cycles;
-
-    case 0xF8: // RM
-        if (cpu.flags.s)
-        {
-            cpu.pc = pop(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xF9: // SPHL
-        cpu.sp = cpu.HL();
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xFA: // JM adr
-        if (cpu.flags.s)
-        {
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xFB: // EI
+    else if constexpr (I.op == ISA_EI)
         cpu.inte = true;
-        cpu.pc += 1;
-        return opcode_table[opcode].cycles;
-
-    case 0xFC: // CM adr
-        if (cpu.flags.s)
-        {
-            push(cpu, cpu.pc + 3);
-            cpu.pc = read_u16(cpu);
-            return opcode_table[opcode].cycles + 6;
-        }
-        cpu.pc += 3;
-        return opcode_table[opcode].cycles;
-
-    case 0xFE:
-    { // CPI d8
-        u8 val = cpu.mem->read(cpu.pc + 1);
-        cmp_a(cpu, val);
-        cpu.pc += 2;
-        return opcode_table[opcode].cycles;
-    }
+    else
+        static_assert(I.op == ISA_NOP, "operation without a handler");
 
-    case 0xFF: // RST 7
-        push(cpu, cpu.pc + 1);
-        cpu.pc = 0x38;
-        return opcode_table[opcode].cycles;
+    cpu.pc += I.bytes;
+    return I.cycles;
+}
 
-    default:
-        printf("Unimplemented opcode %02X at %04X\n", opcode, cpu.pc);
-        return 0;
+int execute_instruction(CPU &cpu)
+{
+    switch (cpu.mem->read(cpu.pc))
+    {
+#define ISA_CASE(op) \
+    case op:         \
+        return exec<op>(cpu);
+        ISA_OPCODES(ISA_CASE)
+#undef ISA_CASE
     }
-
-    cpu.pc += opcode_table[opcode].bytes;
-    return opcode_table[opcode].cycles;
+    return 0;
 }
@@ -28,6 +28,7 @@ bool loadROM(CPU* cpu, const char* path, u16 offset) {
 
     size_t read = fread(cpu->mem->data + offset, 1, size, f);
     fclose(f);
+    cpu->mem->mark_written(offset, u32(read));
 
     if (read != (size_t)size) {
         printf("Failed to read full ROM\n");
@@ -39,3 +40,31 @@ bool loadROM(CPU* cpu, const char* path, u16 offset) {
 
     return true;
 }
+
+bool readROM(const char* path, std::vector<u8>& bytes) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Failed to open ROM: %s\n", path);
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+
+    if (size > 0x10000) {
+        printf("ROM too large to fit in memory\n");
+        fclose(f);
+        return false;
+    }
+
+    bytes.resize(size);
+    size_t read = fread(bytes.data(), 1, size, f);
+    fclose(f);
+
+    if (read != (size_t)size) {
+        printf("Failed to read full ROM\n");
+        return false;
+    }
+    return true;
+}
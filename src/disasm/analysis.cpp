@@ -0,0 +1,296 @@
+#include "disasm/analysis.h"
+#include "cpu/opcodes.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+// control does not continue with the next instruction in the block
+static bool ends_block(u8 f) {
+    return f == FLOW_JUMP || f == FLOW_BRANCH || f == FLOW_RET || f == FLOW_CRET || f == FLOW_PCHL;
+}
+
+static bool inside(const Image& img, u32 addr, u32 len) {
+    return addr >= img.origin && addr + len <= img.origin + img.size;
+}
+
+static u8 byte_at(const Image& img, u32 addr) {
+    return img.bytes[addr - img.origin];
+}
+
+template <typename T>
+static void sort_unique(std::vector<T>& v) {
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+void Program::clear() {
+    insns.clear();
+    blocks.clear();
+    functions.clear();
+    calls.clear();
+    labels.clear();
+    code.reset();
+    conflicts = 0;
+}
+
+static void decode_reachable(const Image& img, std::vector<u16>& work, Program& out) {
+    std::bitset<0x10000> starts;
+
+    while (!work.empty()) {
+        u32 pc = work.back();
+        work.pop_back();
+
+        while (inside(img, pc, 1)) {
+            u8 op = byte_at(img, pc);
+            u8 len = opcode_table[op].bytes;
+            if (!inside(img, pc, len))
+                break;
+
+            if (starts[pc])
+                break; // joined code decoded earlier
+
+            // a target inside another instruction, or running into one
+            bool overlap = false;
+            for (u32 i = 0; i < len; i++)
+                overlap |= out.code[pc + i];
+            if (overlap) {
+                out.conflicts++;
+                break;
+            }
+            for (u32 i = 0; i < len; i++)
+                out.code[pc + i] = true;
+            starts[pc] = true;
+
+            u8 lo = len > 1 ? byte_at(img, pc + 1) : 0;
+            u8 hi = len > 2 ? byte_at(img, pc + 2) : 0;
+            DecodedInsn ins = decode(op, lo, hi, pc);
+            out.insns.push_back(ins);
+
+            if (flow_has_target(ins.flow)) {
+                out.labels.push_back(ins.target);
+                if (ins.flow == FLOW_CALL || ins.flow == FLOW_CCALL || ins.flow == FLOW_RST)
+                    out.functions.push_back(ins.target);
+                work.push_back(ins.target);
+            }
+
+            if (ins.flow == FLOW_JUMP || ins.flow == FLOW_RET || ins.flow == FLOW_PCHL)
+                break;
+            pc += len;
+        }
+    }
+}
+
+static void build_blocks(Program& out) {
+    for (size_t i = 0; i < out.insns.size(); i++) {
+        const DecodedInsn& ins = out.insns[i];
+        bool leader = i == 0 || ends_block(out.insns[i - 1].flow) ||
+                      out.insns[i - 1].addr + out.insns[i - 1].len != ins.addr ||
+                      std::binary_search(out.labels.begin(), out.labels.end(), ins.addr);
+        if (leader)
+            out.blocks.push_back(BasicBlock{ins.addr, u32(i), u32(i), {0, 0}, 0});
+        out.blocks.back().end = i + 1;
+    }
+
+    for (BasicBlock& bb : out.blocks) {
+        const DecodedInsn& last = out.insns[bb.end - 1];
+        u16 next = last.addr + last.len;
+        switch (last.flow) {
+        case FLOW_JUMP:
+            bb.succ[bb.nsucc++] = last.target;
+            break;
+        case FLOW_BRANCH:
+            bb.succ[bb.nsucc++] = next;
+            bb.succ[bb.nsucc++] = last.target;
+            break;
+        case FLOW_RET:
+        case FLOW_PCHL:
+            break;
+        default:
+            bb.succ[bb.nsucc++] = next;
+            break;
+        }
+    }
+}
+
+static int block_at(const Program& p, u16 addr) {
+    auto it = std::lower_bound(p.blocks.begin(), p.blocks.end(), addr,
+                               [](const BasicBlock& bb, u16 a) { return bb.start < a; });
+    if (it == p.blocks.end() || it->start != addr)
+        return -1;
+    return int(it - p.blocks.begin());
+}
+
+// Walks each function's blocks without following calls and records the
+// calls made from them.
+static void build_call_graph(Program& out) {
+    std::vector<u8> seen(out.blocks.size());
+    std::vector<int> stack;
+
+    for (u16 fn : out.functions) {
+        int first = block_at(out, fn);
+        if (first < 0)
+            continue;
+
+        std::fill(seen.begin(), seen.end(), 0);
+        stack.assign(1, first);
+        seen[first] = 1;
+        while (!stack.empty()) {
+            const BasicBlock& bb = out.blocks[stack.back()];
+            stack.pop_back();
+
+            for (u32 i = bb.first; i < bb.end; i++) {
+                const DecodedInsn& ins = out.insns[i];
+                if (ins.flow == FLOW_CALL || ins.flow == FLOW_CCALL || ins.flow == FLOW_RST)
+                    out.calls.push_back(CallEdge{fn, ins.target});
+            }
+            for (int s = 0; s < bb.nsucc; s++) {
+                int b = block_at(out, bb.succ[s]);
+                if (b >= 0 && !seen[b]) {
+                    seen[b] = 1;
+                    stack.push_back(b);
+                }
+            }
+        }
+    }
+
+    std::sort(out.calls.begin(), out.calls.end(), [](const CallEdge& x, const CallEdge& y) {
+        return x.caller != y.caller ? x.caller < y.caller : x.callee < y.callee;
+    });
+    out.calls.erase(std::unique(out.calls.begin(), out.calls.end(),
+                                [](const CallEdge& x, const CallEdge& y) {
+                                    return x.caller == y.caller && x.callee == y.callee;
+                                }),
+                    out.calls.end());
+}
+
+void analyze(const Image& img, const u16* entries, int nentries, Program& out) {
+    out.clear();
+
+    std::vector<u16> work(entries, entries + nentries);
+    out.functions.assign(entries, entries + nentries);
+    out.labels.assign(entries, entries + nentries);
+    decode_reachable(img, work, out);
+
+    std::sort(out.insns.begin(), out.insns.end(),
+              [](const DecodedInsn& x, const DecodedInsn& y) { return x.addr < y.addr; });
+    sort_unique(out.labels);
+    sort_unique(out.functions);
+
+    build_blocks(out);
+    build_call_graph(out);
+}
+
+// Listing output is built with these instead of printf; batch runs format
+// millions of lines.
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static void put_hex(std::string& out, u32 v, int digits) {
+    char buf[4];
+    for (int i = digits - 1; i >= 0; i--, v >>= 4)
+        buf[i] = hex_digits[v & 0xF];
+    out.append(buf, digits);
+}
+
+static void put_label(std::string& out, const Program& p, u16 addr) {
+    out += std::binary_search(p.functions.begin(), p.functions.end(), addr) ? "sub_" : "loc_";
+    put_hex(out, addr, 4);
+}
+
+static bool insn_starts_at(const Program& p, u16 addr) {
+    auto it = std::lower_bound(p.insns.begin(), p.insns.end(), addr,
+                               [](const DecodedInsn& ins, u16 a) { return ins.addr < a; });
+    return it != p.insns.end() && it->addr == addr;
+}
+
+void format_listing(const Image& img, const Program& prog, std::string& out) {
+    u32 addr = img.origin, end = img.origin + img.size;
+    size_t next = 0; // next instruction in prog.insns
+
+    while (addr < end) {
+        if (next < prog.insns.size() && prog.insns[next].addr == addr) {
+            const DecodedInsn& ins = prog.insns[next++];
+            if (std::binary_search(prog.labels.begin(), prog.labels.end(), ins.addr)) {
+                out += '\n';
+                put_label(out, prog, ins.addr);
+                out += ":\n";
+            }
+
+            const char* mn = opcode_table[ins.opcode].mnemonic;
+            size_t n = strlen(mn);
+            put_hex(out, ins.addr, 4);
+            out += "  ";
+            out += mn;
+            out.append(n < 12 ? 12 - n : 0, ' ');
+
+            if (flow_has_target(ins.flow) && ins.flow != FLOW_RST && insn_starts_at(prog, ins.target)) {
+                out += ' ';
+                put_label(out, prog, ins.target);
+            } else if (ins.len > 1) {
+                out += " #";
+                put_hex(out, ins.imm, ins.len == 2 ? 2 : 4);
+            }
+            out += '\n';
+            addr += ins.len;
+            continue;
+        }
+
+        // data up to the next instruction, 8 bytes per line
+        u32 stop = next < prog.insns.size() ? prog.insns[next].addr : end;
+        while (addr < stop) {
+            put_hex(out, addr, 4);
+            out += "  DB          ";
+            for (int i = 0; i < 8 && addr < stop; i++, addr++) {
+                out += i ? ",#" : " #";
+                put_hex(out, byte_at(img, addr), 2);
+            }
+            out += '\n';
+        }
+    }
+}
+
+BatchStats analyze_batch(const std::vector<Image>& images, u16 entry, int threads,
+                         void (*sink)(size_t, const std::string&, void*), void* ctx) {
+    std::atomic<size_t> next{0};
+    std::atomic<u64> bytes{0}, instructions{0}, output{0};
+
+    auto worker = [&]() {
+        Program prog;
+        std::string listing;
+        listing.reserve(1 << 20);
+        u64 my_bytes = 0, my_insns = 0, my_out = 0;
+
+        for (size_t i; (i = next.fetch_add(1)) < images.size();) {
+            const Image& img = images[i];
+            analyze(img, &entry, 1, prog);
+            listing.clear();
+            format_listing(img, prog, listing);
+            if (sink)
+                sink(i, listing, ctx);
+
+            my_bytes += img.size;
+            my_insns += prog.insns.size();
+            my_out += listing.size();
+        }
+        bytes += my_bytes;
+        instructions += my_insns;
+        output += my_out;
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++)
+        pool.emplace_back(worker);
+    worker();
+    for (std::thread& t : pool)
+        t.join();
+
+    BatchStats s;
+    s.images = images.size();
+    s.bytes = bytes;
+    s.instructions = instructions;
+    s.output_bytes = output;
+    s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return s;
+}
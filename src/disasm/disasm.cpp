@@ -1,35 +1,48 @@
 #include <cstdio>
+#include <string>
 #include "disasm/disasm.h"
 #include "cpu/opcodes.h"
 
-int disasm(const u8* code, u16 pc) {
-    u8 opcode = code[pc];
-    Opcode op = opcode_table[opcode];
+int format_insn(const DecodedInsn& d, char* buf, size_t size) {
+    const char* mnemonic = opcode_table[d.opcode].mnemonic;
 
-    printf("%04x  %-12s", pc, op.mnemonic);
+    if (d.len == 2)
+        return snprintf(buf, size, "%04x  %-12s #%02x\n", d.addr, mnemonic, d.imm);
+    if (d.len == 3)
+        return snprintf(buf, size, "%04x  %-12s #%04x\n", d.addr, mnemonic, d.imm);
+    return snprintf(buf, size, "%04x  %-12s\n", d.addr, mnemonic);
+}
 
-    if (op.bytes == 2)
-        printf(" #%02x", code[pc+1]);
-    else if (op.bytes == 3)
-        printf(" #%02x%02x", code[pc+2], code[pc+1]);
+int disasm(const u8* code, u16 pc) {
+    DecodedInsn d = decode(code, pc);
+    char line[48];
 
-    printf("\n");
-    return op.bytes;
+    format_insn(d, line, sizeof(line));
+    fputs(line, stdout);
+    return d.len;
 }
 
 
 void disasm_all(const u8* code, u16 start, u16 size) {
-    u16 pc = start;
+    std::string out;
+    char line[48];
+    u32 pc = start;
 
-    while (pc < start + size) {
-        int bytes = disasm(code, pc);
+    while (pc < u32(start) + size) {
+        DecodedInsn d = decode(code, pc);
 
         // Safety check (for illegal / unimplemented opcodes)
-        if (bytes <= 0) {
+        if (d.len == 0) {
             printf("Invalid opcode at %04x\n", pc);
             break;
         }
 
-        pc += bytes;
+        out.append(line, format_insn(d, line, sizeof(line)));
+        if (out.size() >= (1 << 16)) {
+            fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+        pc += d.len;
     }
+    fwrite(out.data(), 1, out.size(), stdout);
 }
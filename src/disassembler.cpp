@@ -1,35 +1,155 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "util/types.h"
 #include "disasm/disasm.h"
+#include "disasm/analysis.h"
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options] <8080 binary>...\n", prog);
+    printf("  --linear        sweep every byte as code (old behaviour)\n");
+    printf("  --org ADDR      load address (default 0x100 for .COM, else 0)\n");
+    printf("  -e ADDR         entry point, repeatable (default: load address)\n");
+    printf("  --graph         print blocks and call graph after the listing\n");
+    printf("  --batch         analyze all files in parallel and report throughput\n");
+    printf("  -j N            worker threads for --batch\n");
+    printf("  --repeat N      analyze the file list N times in --batch\n");
+    printf("  --write         --batch: write each listing to <file>.asm\n");
+}
+
+static bool read_file(const char* path, std::vector<u8>& out) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror("Failed to open file");
+        return false;
+    }
+    out.resize(0x10000);
+    out.resize(fread(out.data(), 1, out.size(), f));
+    fclose(f);
+    return true;
+}
+
+static u16 default_org(const char* path) {
+    size_t n = strlen(path);
+    return (n > 4 && strcasecmp(path + n - 4, ".com") == 0) ? 0x100 : 0x0000;
+}
+
+static void print_graph(const Program& prog) {
+    printf("\n; %zu instructions, %zu blocks, %zu functions, %u conflicts\n", prog.insns.size(),
+           prog.blocks.size(), prog.functions.size(), prog.conflicts);
+    for (const BasicBlock& bb : prog.blocks) {
+        printf("; block %04x  %u insns ->", bb.start, bb.end - bb.first);
+        for (int i = 0; i < bb.nsucc; i++)
+            printf(" %04x", bb.succ[i]);
+        printf("\n");
+    }
+    for (const CallEdge& e : prog.calls)
+        printf("; call %04x -> %04x\n", e.caller, e.callee);
+}
+
+struct WriteCtx {
+    const std::vector<const char*>* paths;
+};
+
+static void write_listing(size_t index, const std::string& listing, void* ctx) {
+    const std::vector<const char*>& paths = *static_cast<WriteCtx*>(ctx)->paths;
+    std::string name = std::string(paths[index % paths.size()]) + ".asm";
+    if (FILE* f = fopen(name.c_str(), "wb")) {
+        fwrite(listing.data(), 1, listing.size(), f);
+        fclose(f);
+    }
+}
 
 int main(int argc, char** argv) {
-    if (argc < 2) {
-        printf("Usage: %s <8080 binary>\n", argv[0]);
+    bool linear = false, graph = false, batch = false, write = false;
+    long org = -1;
+    int threads = 1, repeat = 1;
+    std::vector<u16> entries;
+    std::vector<const char*> paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--linear"))
+            linear = true;
+        else if (!strcmp(argv[i], "--graph"))
+            graph = true;
+        else if (!strcmp(argv[i], "--batch"))
+            batch = true;
+        else if (!strcmp(argv[i], "--write"))
+            write = true;
+        else if (!strcmp(argv[i], "--org") && i + 1 < argc)
+            org = strtol(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "-e") && i + 1 < argc)
+            entries.push_back(strtol(argv[++i], nullptr, 0));
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = atoi(argv[++i]);
+        else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else
+            paths.push_back(argv[i]);
+    }
+    if (paths.empty()) {
+        usage(argv[0]);
         return 1;
     }
 
-    // 64KB memory
-    static u8 memory[0x10000];
-    memset(memory, 0, sizeof(memory));
+    if (linear) {
+        // 64KB memory
+        static u8 memory[0x10000];
+        memset(memory, 0, sizeof(memory));
 
-    // Open file
-    FILE* f = fopen(argv[1], "rb");
-    if (!f) {
-        perror("Failed to open file");
-        return 1;
+        std::vector<u8> bytes;
+        if (!read_file(paths[0], bytes))
+            return 1;
+        memcpy(memory, bytes.data(), bytes.size());
+
+        printf("Loaded %zu bytes\n\n", bytes.size());
+        disasm_all(memory, 0x0000, (u16)bytes.size());
+        return 0;
     }
 
-    // Load at 0x0000 (8080 COM programs expect this)
-    size_t bytes = fread(memory, 1, sizeof(memory), f);
-    fclose(f);
+    std::vector<std::vector<u8>> files(paths.size());
+    std::vector<Image> images;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!read_file(paths[i], files[i]))
+            return 1;
+        u16 base = org >= 0 ? u16(org) : default_org(paths[i]);
+        u32 size = files[i].size() > 0x10000u - base ? 0x10000u - base : u32(files[i].size());
+        images.push_back(Image{files[i].data(), base, size});
+    }
 
-    printf("Loaded %zu bytes\n\n", bytes);
+    if (batch) {
+        std::vector<Image> corpus;
+        for (int r = 0; r < repeat; r++)
+            corpus.insert(corpus.end(), images.begin(), images.end());
 
-    // Disassemble entire file
-    disasm_all(memory, 0x0000, (u16)bytes);
+        WriteCtx ctx{&paths};
+        u16 entry = entries.empty() ? images[0].origin : entries[0];
+        BatchStats s = analyze_batch(corpus, entry, threads, write ? write_listing : nullptr, &ctx);
 
+        printf("%llu images, %d threads: %.3f s\n", (unsigned long long)s.images, threads, s.seconds);
+        printf("  %.0f images/s  %.1f MB/s in  %.1f M insns/s  %.1f MB/s listing\n", s.images / s.seconds,
+               s.bytes / s.seconds / 1e6, s.instructions / s.seconds / 1e6, s.output_bytes / s.seconds / 1e6);
+        return 0;
+    }
+
+    Program prog;
+    std::string listing;
+    listing.reserve(1 << 20);
+    for (const Image& img : images) {
+        std::vector<u16> from = entries.empty() ? std::vector<u16>{img.origin} : entries;
+        analyze(img, from.data(), int(from.size()), prog);
+
+        listing.clear();
+        format_listing(img, prog, listing);
+        fwrite(listing.data(), 1, listing.size(), stdout);
+        if (graph)
+            print_graph(prog);
+    }
     return 0;
 }
@@ -0,0 +1,97 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "cpu/load.h"
+#include "metrics/metrics.h"
+#include "serve/server.h"
+
+static Server* running = nullptr;
+
+static void on_signal(int) {
+    if (running)
+        server_stop(running);
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options] <program.com>...\n", prog);
+    printf("  --socket PATH   listen address (default /tmp/emud.sock)\n");
+    printf("  -j N            worker threads (default 1)\n");
+    printf("  --numa          pin workers across NUMA nodes, memory on each one's node\n");
+    printf("  --cycles N      cycle budget when a request gives none\n");
+    printf("  --memo PATH     answer repeated runs from a result cache kept in PATH\n");
+    printf("  --memo-size MB  size of the cache file (default 64)\n");
+    printf("  --memo-verify F run this fraction of cache hits again to catch stale entries\n");
+    printf("  --metrics-file PATH  Prometheus text file, rewritten every 5 s\n");
+    printf("  --metrics-port PORT  serve /metrics on 127.0.0.1\n");
+    printf("ROMs are served under their file name without extension.\n");
+}
+
+int main(int argc, char** argv) {
+    ServeConfig cfg;
+    cfg.socket_path = "/tmp/emud.sock";
+    std::vector<RomImage> roms;
+    const char* metrics_file = nullptr;
+    int metrics_port = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--socket") && i + 1 < argc)
+            cfg.socket_path = argv[++i];
+        else if (!strcmp(argv[i], "-j") && i + 1 < argc)
+            cfg.workers = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--numa"))
+            cfg.numa = true;
+        else if (!strcmp(argv[i], "--cycles") && i + 1 < argc)
+            cfg.default_cycles = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--memo") && i + 1 < argc)
+            cfg.memo_path = argv[++i];
+        else if (!strcmp(argv[i], "--memo-size") && i + 1 < argc)
+            cfg.memo_bytes = size_t(strtoull(argv[++i], nullptr, 0)) << 20;
+        else if (!strcmp(argv[i], "--memo-verify") && i + 1 < argc)
+            cfg.memo_verify = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--metrics-file") && i + 1 < argc)
+            metrics_file = argv[++i];
+        else if (!strcmp(argv[i], "--metrics-port") && i + 1 < argc)
+            metrics_port = atoi(argv[++i]);
+        else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            RomImage rom;
+            rom.name = std::filesystem::path(argv[i]).stem().string();
+            if (!readROM(argv[i], rom.bytes) || rom.bytes.size() > 0x10000 - 0x100)
+                return 1;
+            roms.push_back(std::move(rom));
+        }
+    }
+    if (roms.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    MetricsExporter* metrics = nullptr;
+    if (metrics_file || metrics_port) {
+        metrics = metrics_export_start(metrics_file, metrics_port);
+        if (!metrics)
+            return 1;
+    }
+
+    Server* s = server_create(cfg, std::move(roms));
+    running = s;
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    printf("emud: serving on %s with %d workers%s\n", cfg.socket_path.c_str(), cfg.workers,
+           cfg.numa ? ", NUMA placement" : "");
+    fflush(stdout);
+    int rc = server_run(s);
+
+    running = nullptr;
+    server_destroy(s);
+    metrics_export_stop(metrics);
+    return rc ? 1 : 0;
+}
@@ -0,0 +1,612 @@
+#include "gdb/stub.h"
+#include "cpu/opcodes.h"
+#include "rewind/rewind.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static constexpr u8 HLT = 0x76;
+static constexpr int NREGS = 13; // z80 layout; the last 7 are not on the 8080
+
+enum Stop {
+    STOP_BREAK,
+    STOP_WATCH,
+    STOP_STEP,
+    STOP_HALT,
+    STOP_INTERRUPT,
+    STOP_EXIT,
+    STOP_HISTORY_START, // reversed to the oldest checkpoint
+};
+
+static const char hexdigits[] = "0123456789abcdef";
+
+static int hexval(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = char(tolower(c));
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+static u32 parse_hex(const char*& p) {
+    u32 v = 0;
+    for (int d; (d = hexval(*p)) >= 0; p++)
+        v = v << 4 | u32(d);
+    return v;
+}
+
+static void put_byte(std::string& out, u8 v) {
+    out += hexdigits[v >> 4];
+    out += hexdigits[v & 15];
+}
+
+// --- transport ---
+
+bool gdb_listen(GdbStub& g, const char* where) {
+    const char* colon = strrchr(where, ':');
+    const char* port = colon ? colon + 1 : where;
+    bool tcp = *port && strspn(port, "0123456789") == strlen(port);
+
+    if (tcp) {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(u16(atoi(port)));
+        std::string host = colon ? std::string(where, colon) : "127.0.0.1";
+        if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+            fprintf(stderr, "gdb: bad address %s\n", where);
+            return false;
+        }
+        g.listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(g.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (g.listen_fd < 0 || bind(g.listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+            listen(g.listen_fd, 1) < 0) {
+            perror("gdb socket");
+            return false;
+        }
+        return true;
+    }
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(where) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "gdb: socket path too long: %s\n", where);
+        return false;
+    }
+    strcpy(addr.sun_path, where);
+    unlink(addr.sun_path);
+    g.listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (g.listen_fd < 0 || bind(g.listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(g.listen_fd, 1) < 0) {
+        perror("gdb socket");
+        return false;
+    }
+    g.unix_path = where;
+    return true;
+}
+
+void gdb_close(GdbStub& g) {
+    if (g.fd >= 0)
+        close(g.fd);
+    if (g.listen_fd >= 0)
+        close(g.listen_fd);
+    if (!g.unix_path.empty())
+        unlink(g.unix_path.c_str());
+    g.fd = g.listen_fd = -1;
+    g.unix_path.clear();
+}
+
+static bool send_all(int fd, const char* p, size_t n) {
+    while (n) {
+        ssize_t w = write(fd, p, n);
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= size_t(w);
+    }
+    return true;
+}
+
+static bool send_packet(GdbStub& g, const std::string& body) {
+    u8 sum = 0;
+    for (char c : body)
+        sum += u8(c);
+    std::string pkt = "$" + body + "#";
+    put_byte(pkt, sum);
+    return send_all(g.fd, pkt.data(), pkt.size());
+}
+
+static int read_char(GdbStub& g) {
+    u8 c;
+    return read(g.fd, &c, 1) == 1 ? c : -1;
+}
+
+// Next packet body, or "\x03" for an interrupt request; false on EOF.
+// Acks are sent here and the debugger's acks are skipped.
+static bool read_packet(GdbStub& g, std::string& body) {
+    for (;;) {
+        int c = read_char(g);
+        if (c < 0)
+            return false;
+        if (c == 0x03) {
+            body = "\x03";
+            return true;
+        }
+        if (c != '$')
+            continue; // '+', '-' or noise
+
+        body.clear();
+        u8 sum = 0;
+        while ((c = read_char(g)) >= 0 && c != '#') {
+            body += char(c);
+            sum += u8(c);
+        }
+        int h = read_char(g), l = read_char(g);
+        if (c < 0 || h < 0 || l < 0)
+            return false;
+        if (g.no_ack)
+            return true;
+        if (hexval(char(h)) * 16 + hexval(char(l)) != sum) {
+            send_all(g.fd, "-", 1);
+            continue;
+        }
+        send_all(g.fd, "+", 1);
+        return true;
+    }
+}
+
+// Whether the debugger sent ^C; checked every so often while running.
+static bool interrupted(GdbStub& g) {
+    pollfd p = {g.fd, POLLIN, 0};
+    if (poll(&p, 1, 0) <= 0)
+        return false;
+    int c = read_char(g);
+    return c == 0x03 || c < 0;
+}
+
+// --- breakpoints and execution ---
+
+static GdbBreakpoint* find_bp(GdbStub& g, u16 addr) {
+    for (GdbBreakpoint& b : g.breakpoints)
+        if (b.addr == addr)
+            return &b;
+    return nullptr;
+}
+
+// Byte as the program sees it, without breakpoint patches.
+static u8 peek(GdbStub& g, u16 addr) {
+    GdbBreakpoint* b = find_bp(g, addr);
+    return b ? b->saved : g.cpu->mem->data[addr];
+}
+
+static void poke(GdbStub& g, u16 addr, u8 v) {
+    GdbBreakpoint* b = find_bp(g, addr);
+    if (b)
+        b->saved = v;
+    if (!b || g.rewind)
+        g.cpu->mem->data[addr] = v;
+    g.cpu->mem->mark_written(addr, 1);
+}
+
+static void insert_bp(GdbStub& g, u16 addr) {
+    if (find_bp(g, addr))
+        return;
+    u8* m = g.cpu->mem->data;
+    g.breakpoints.push_back({addr, m[addr]});
+    if (!g.rewind) {
+        m[addr] = HLT;
+        g.cpu->mem->mark_written(addr, 1); // keeps hashes and dirty pages true
+    }
+}
+
+static void remove_bp(GdbStub& g, u16 addr) {
+    for (size_t i = 0; i < g.breakpoints.size(); i++) {
+        GdbBreakpoint b = g.breakpoints[i];
+        if (b.addr != addr)
+            continue;
+        u8* m = g.cpu->mem->data;
+        if (!g.rewind && m[addr] == HLT) {
+            m[addr] = b.saved;
+            g.cpu->mem->mark_written(addr, 1);
+        }
+        g.breakpoints.erase(g.breakpoints.begin() + i);
+        return;
+    }
+}
+
+// Page bits for every watched range.
+static void update_watch_pages(GdbStub& g) {
+    Memory& m = *g.cpu->mem;
+    m.watched[0] = m.watched[1] = m.watched[2] = m.watched[3] = 0;
+    for (const GdbWatch& w : g.watches)
+        for (u32 a = w.addr; a < u32(w.addr) + w.len && a < 0x10000; a = (a | 0xFF) + 1)
+            m.watch_page(a >> 8, true);
+}
+
+static int exec_one(GdbStub& g) {
+    if (g.rewind)
+        return g.rewind->step();
+    return g.exec ? g.exec(g.exec_ctx, *g.cpu) : g.cpu->step();
+}
+
+// One instruction with the breakpoint under pc (if any) lifted for it.
+static int step_over(GdbStub& g) {
+    u8* m = g.cpu->mem->data;
+    GdbBreakpoint* b = g.rewind ? nullptr : find_bp(g, g.cpu->pc);
+    if (!b)
+        return exec_one(g);
+    u16 addr = b->addr;
+    m[addr] = b->saved;
+    g.cpu->mem->mark_written(addr, 1);
+    int n = exec_one(g);
+    if ((b = find_bp(g, addr))) {
+        b->saved = m[addr]; // the instruction may have rewritten itself
+        m[addr] = HLT;
+        g.cpu->mem->mark_written(addr, 1);
+    }
+    return n;
+}
+
+// A HLT just executed: report it as the breakpoint it replaced, with the
+// CPU put back in front of the original instruction.
+static bool took_breakpoint(GdbStub& g) {
+    CPU& cpu = *g.cpu;
+    u16 at = u16(cpu.pc - 1);
+    if (g.rewind || !find_bp(g, at) || cpu.mem->data[at] != HLT)
+        return false;
+    cpu.pc = at;
+    cpu.halted = false;
+    cpu.cycles -= timing_table[HLT].not_taken;
+    return true;
+}
+
+static bool took_watch(GdbStub& g, u16& hit) {
+    Memory& m = *g.cpu->mem;
+    for (u32 i = 0; i < m.nhits && i < 4; i++)
+        for (const GdbWatch& w : g.watches)
+            if (u16(m.hits[i] - w.addr) < w.len) {
+                hit = m.hits[i];
+                return true;
+            }
+    return false;
+}
+
+static Stop run(GdbStub& g, bool single, u16& watch_addr) {
+    CPU& cpu = *g.cpu;
+    Memory& m = *cpu.mem;
+    m.nhits = 0;
+    int n = step_over(g);
+    for (u32 polls = 0;; n = exec_one(g)) {
+        if (n == 0)
+            return STOP_EXIT;
+        if (cpu.halted)
+            return took_breakpoint(g) ? STOP_BREAK : STOP_HALT;
+        if (m.nhits) {
+            if (took_watch(g, watch_addr))
+                return STOP_WATCH;
+            m.nhits = 0;
+        }
+        if (single)
+            return STOP_STEP;
+        if (g.rewind && find_bp(g, cpu.pc))
+            return STOP_BREAK;
+        if ((++polls & 0xFFFF) == 0 && interrupted(g))
+            return STOP_INTERRUPT;
+    }
+}
+
+static std::string stop_reply(Stop s, u16 watch_addr) {
+    char buf[32];
+    switch (s) {
+    case STOP_BREAK:
+        return "T05swbreak:;";
+    case STOP_WATCH:
+        snprintf(buf, sizeof(buf), "T05watch:%04x;", watch_addr);
+        return buf;
+    case STOP_INTERRUPT:
+        return "T02";
+    case STOP_EXIT:
+        return "W00";
+    case STOP_HISTORY_START:
+        return "T05replaylog:begin;";
+    default:
+        return "T05";
+    }
+}
+
+// --- reverse execution ---
+
+struct ReverseHit {
+    GdbStub* g;
+    Stop stop;
+    u16 watch_addr;
+};
+
+static bool reverse_hit(void* ctx, u16 pc) {
+    ReverseHit& h = *static_cast<ReverseHit*>(ctx);
+    if (h.g->cpu->mem->nhits && took_watch(*h.g, h.watch_addr)) {
+        h.stop = STOP_WATCH;
+        return true;
+    }
+    if (find_bp(*h.g, pc)) {
+        h.stop = STOP_BREAK;
+        return true;
+    }
+    return false;
+}
+
+// bs: back one instruction. bc: back to the latest breakpoint, or write to
+// a watched range, before this point. Either stops at the oldest
+// checkpoint when there is nothing earlier.
+static Stop reverse(GdbStub& g, bool single, u16& watch_addr) {
+    Rewind& r = *g.rewind;
+    if (single)
+        return r.step_back() ? STOP_STEP : STOP_HISTORY_START;
+    ReverseHit h{&g, STOP_HISTORY_START, 0};
+    if (!r.reverse_until(reverse_hit, &h))
+        return STOP_HISTORY_START;
+    watch_addr = h.watch_addr;
+    return h.stop;
+}
+
+// --- registers ---
+
+static u16 get_reg(const CPU& c, int n) {
+    switch (n) {
+    case 0: return u16(c.a << 8 | c.flags.f);
+    case 1: return u16(c.b << 8 | c.c);
+    case 2: return u16(c.d << 8 | c.e);
+    case 3: return u16(c.h << 8 | c.l);
+    case 4: return c.sp;
+    case 5: return c.pc;
+    default: return 0;
+    }
+}
+
+static void set_reg(CPU& c, int n, u16 v) {
+    switch (n) {
+    case 0:
+        c.a = u8(v >> 8);
+        c.flags.f = u8((v & 0xD7) | 0x02); // bits 3 and 5 read 0, bit 1 reads 1
+        break;
+    case 1: c.b = u8(v >> 8), c.c = u8(v); break;
+    case 2: c.d = u8(v >> 8), c.e = u8(v); break;
+    case 3: c.h = u8(v >> 8), c.l = u8(v); break;
+    case 4: c.sp = v; break;
+    case 5: c.pc = v; break;
+    }
+}
+
+static void put_reg(std::string& out, u16 v) {
+    put_byte(out, u8(v)); // target byte order
+    put_byte(out, u8(v >> 8));
+}
+
+static u16 parse_reg(const char*& p) {
+    u16 v = 0;
+    for (int i = 0; i < 2 && hexval(p[0]) >= 0 && hexval(p[1]) >= 0; i++, p += 2)
+        v |= u16(hexval(p[0]) << 4 | hexval(p[1])) << (8 * i);
+    return v;
+}
+
+// --- packets ---
+
+static void clear_all(GdbStub& g) {
+    while (!g.breakpoints.empty())
+        remove_bp(g, g.breakpoints.back().addr);
+    g.watches.clear();
+    update_watch_pages(g);
+}
+
+// Z/z: type,addr,kind
+static std::string breakpoint_packet(GdbStub& g, const char* p, bool insert) {
+    int type = p[1] - '0';
+    p += 3;
+    u16 addr = u16(parse_hex(p));
+    u16 len = *p == ',' ? u16(parse_hex(++p)) : 1;
+    if (type == 0 || type == 1) {
+        insert ? insert_bp(g, addr) : remove_bp(g, addr);
+        return "OK";
+    }
+    if (type != 2)
+        return ""; // read and access watchpoints would need a read hook
+    if (insert) {
+        g.watches.push_back({addr, len ? len : u16(1)});
+    } else {
+        for (size_t i = 0; i < g.watches.size(); i++)
+            if (g.watches[i].addr == addr) {
+                g.watches.erase(g.watches.begin() + i);
+                break;
+            }
+    }
+    update_watch_pages(g);
+    return "OK";
+}
+
+enum Serve { SERVE_ON, SERVE_DETACH, SERVE_END };
+
+static Serve handle(GdbStub& g, const std::string& pkt, std::string& reply) {
+    CPU& cpu = *g.cpu;
+    const char* p = pkt.c_str();
+    u16 watch_addr = 0;
+
+    switch (p[0]) {
+    case '?':
+        reply = "S05";
+        break;
+    case 'g':
+        for (int i = 0; i < NREGS; i++)
+            put_reg(reply, get_reg(cpu, i));
+        break;
+    case 'G':
+        p++;
+        for (int i = 0; i < NREGS && *p; i++)
+            set_reg(cpu, i, parse_reg(p));
+        reply = "OK";
+        break;
+    case 'p': {
+        p++;
+        int n = int(parse_hex(p));
+        if (n < NREGS)
+            put_reg(reply, get_reg(cpu, n));
+        else
+            reply = "E01";
+        break;
+    }
+    case 'P': {
+        p++;
+        int n = int(parse_hex(p));
+        if (*p++ != '=' || n >= NREGS) {
+            reply = "E01";
+            break;
+        }
+        set_reg(cpu, n, parse_reg(p));
+        reply = "OK";
+        break;
+    }
+    case 'm': {
+        p++;
+        u32 addr = parse_hex(p);
+        u32 len = *p == ',' ? parse_hex(++p) : 0;
+        for (u32 i = 0; i < len && i < 0x10000; i++)
+            put_byte(reply, peek(g, u16(addr + i)));
+        break;
+    }
+    case 'M': {
+        p++;
+        u32 addr = parse_hex(p);
+        u32 len = *p == ',' ? parse_hex(++p) : 0;
+        if (*p++ != ':') {
+            reply = "E01";
+            break;
+        }
+        for (u32 i = 0; i < len && hexval(p[0]) >= 0 && hexval(p[1]) >= 0; i++, p += 2)
+            poke(g, u16(addr + i), u8(hexval(p[0]) << 4 | hexval(p[1])));
+        reply = "OK";
+        break;
+    }
+    case 'X': {
+        p++;
+        u32 addr = parse_hex(p);
+        u32 len = *p == ',' ? parse_hex(++p) : 0;
+        if (*p++ != ':') {
+            reply = "E01";
+            break;
+        }
+        const char* end = pkt.c_str() + pkt.size();
+        for (u32 i = 0; i < len && p < end; i++) {
+            u8 v = u8(*p++);
+            if (v == '}' && p < end)
+                v = u8(*p++) ^ 0x20;
+            poke(g, u16(addr + i), v);
+        }
+        reply = "OK";
+        break;
+    }
+    case 'c':
+    case 's': {
+        const char* a = p + 1;
+        if (*a)
+            cpu.pc = u16(parse_hex(a));
+        Stop s = run(g, p[0] == 's', watch_addr);
+        g.stops++;
+        reply = stop_reply(s, watch_addr);
+        if (s == STOP_EXIT) {
+            send_packet(g, reply);
+            return SERVE_END;
+        }
+        break;
+    }
+    case 'b':
+        if (g.rewind && (p[1] == 's' || p[1] == 'c')) {
+            Stop s = reverse(g, p[1] == 's', watch_addr);
+            g.stops++;
+            reply = stop_reply(s, watch_addr);
+        }
+        break;
+    case 'Z':
+    case 'z':
+        reply = breakpoint_packet(g, p, p[0] == 'Z');
+        break;
+    case 'H':
+    case 'T':
+        reply = "OK";
+        break;
+    case 'D':
+        clear_all(g);
+        send_packet(g, "OK");
+        return SERVE_DETACH;
+    case 'k':
+        clear_all(g);
+        return SERVE_END;
+    case 'q':
+        if (!strncmp(p, "qSupported", 10))
+            reply = g.rewind ? "PacketSize=1000;QStartNoAckMode+;swbreak+;hwbreak+;ReverseStep+;ReverseContinue+"
+                             : "PacketSize=1000;QStartNoAckMode+;swbreak+;hwbreak+";
+        else if (!strcmp(p, "qAttached"))
+            reply = "1";
+        else if (!strcmp(p, "qfThreadInfo"))
+            reply = "m1";
+        else if (!strcmp(p, "qsThreadInfo"))
+            reply = "l";
+        else if (!strcmp(p, "qC"))
+            reply = "QC1";
+        break;
+    case 'Q':
+        if (!strcmp(p, "QStartNoAckMode")) {
+            send_packet(g, "OK");
+            g.no_ack = true;
+            return SERVE_ON;
+        }
+        break;
+    case 'v':
+        if (!strncmp(p, "vKill", 5)) {
+            clear_all(g);
+            send_packet(g, "OK");
+            return SERVE_END;
+        }
+        break; // vCont and friends: empty reply, GDB falls back to s/c
+    }
+    send_packet(g, reply);
+    return SERVE_ON;
+}
+
+bool gdb_serve(GdbStub& g) {
+    printf("[gdb] waiting for the debugger\n");
+    fflush(stdout);
+    g.fd = accept4(g.listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (g.fd < 0) {
+        perror("gdb accept");
+        return false;
+    }
+    int one = 1;
+    setsockopt(g.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on Unix sockets
+    g.no_ack = false;
+
+    std::string pkt, reply;
+    Serve state = SERVE_ON;
+    while (state == SERVE_ON) {
+        if (!read_packet(g, pkt)) {
+            clear_all(g); // debugger went away: run on as if detached
+            state = SERVE_DETACH;
+            break;
+        }
+        g.packets++;
+        if (pkt == "\x03") {
+            send_packet(g, "T02"); // already stopped
+            continue;
+        }
+        reply.clear();
+        state = handle(g, pkt, reply);
+    }
+    close(g.fd);
+    g.fd = -1;
+    return state == SERVE_DETACH;
+}
@@ -0,0 +1,407 @@
+#include "gen/gen.h"
+#include "cpu/opcodes.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static constexpr u16 ORG = 0x100;
+static constexpr u16 CODE_END = 0x4000;
+static constexpr u16 DATA = 0x4100;  // HL may drift up to 128 bytes either side
+static constexpr int HL_SLACK = 128;
+static constexpr u16 COUNT = 0x8200; // inner iterations left, a word
+static constexpr u16 ROUNDS = 0x8202; // outer iterations left, a byte
+static constexpr u16 STACK = 0xF000;
+
+static const char* const class_names[GEN_CLASSES] = {
+    "mov", "alu", "imm", "incdec", "rotate", "memory", "stack", "branch", "loop", "call",
+};
+
+const char* gen_class_name(int c) { return class_names[c]; }
+
+//                      MOV ALU IMM I/D ROT MEM STK BR LOOP CALL
+static const GenProfile presets[] = {
+    {"mixed", {30, 14, 12, 12, 4, 10, 4, 8, 3, 3}, 0.6, 0.2, 1024, 2, 0.0, 200, 100000000},
+    {"mov", {80, 5, 5, 5, 0, 5, 0, 0, 0, 0}, 0.5, 0.0, 256, 1, 0.0, 200, 100000000},
+    {"alu", {5, 50, 25, 10, 10, 0, 0, 0, 0, 0}, 0.5, 0.0, 256, 1, 0.0, 200, 100000000},
+    {"memory", {20, 10, 5, 5, 0, 60, 0, 0, 0, 0}, 0.5, 0.0, 16384, 1, 0.0, 200, 100000000},
+    {"branchy", {10, 10, 5, 5, 0, 5, 0, 50, 15, 0}, 0.5, 0.5, 1024, 1, 0.0, 200, 100000000},
+    {"calls", {10, 10, 5, 5, 0, 5, 20, 0, 0, 45}, 0.5, 0.0, 1024, 6, 0.0, 100, 100000000},
+    {"smc", {30, 14, 12, 12, 4, 10, 4, 8, 3, 3}, 0.6, 0.2, 1024, 2, 0.1, 200, 100000000},
+    {"adversarial", {15, 15, 10, 10, 5, 15, 5, 15, 5, 5}, 0.5, 1.0, 16384, 8, 0.05, 400, 100000000},
+};
+
+const GenProfile* gen_presets(int* count) {
+    if (count)
+        *count = int(sizeof(presets) / sizeof(presets[0]));
+    return presets;
+}
+
+const GenProfile* gen_preset(const char* name) {
+    for (const GenProfile& p : presets)
+        if (!strcmp(p.name, name))
+            return &p;
+    return nullptr;
+}
+
+bool gen_parse(GenProfile& p, const char* spec) {
+    std::string s = spec;
+    size_t at = 0;
+    while (at < s.size()) {
+        size_t end = s.find(',', at);
+        if (end == std::string::npos)
+            end = s.size();
+        std::string item = s.substr(at, end - at);
+        at = end + 1;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+            return false;
+        std::string key = item.substr(0, eq);
+        const char* value = item.c_str() + eq + 1;
+        char* rest;
+        double v = strtod(value, &rest);
+        if (rest == value || *rest || v < 0)
+            return false;
+
+        bool known = false;
+        for (int c = 0; c < GEN_CLASSES; c++)
+            if (key == class_names[c]) {
+                p.weight[c] = u16(v);
+                known = true;
+            }
+        if (key == "taken")
+            p.taken_rate = v;
+        else if (key == "data")
+            p.data_branches = v;
+        else if (key == "footprint")
+            p.footprint = u32(v);
+        else if (key == "depth")
+            p.call_depth = int(v);
+        else if (key == "smc")
+            p.smc_rate = v;
+        else if (key == "body")
+            p.body = int(v);
+        else if (key == "cycles")
+            p.cycles = u64(v);
+        else if (!known)
+            return false;
+    }
+    return true;
+}
+
+struct Rng {
+    u64 s;
+    u64 next() {
+        u64 z = (s += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    u32 below(u32 n) { return u32(next() % n); }
+    bool chance(double p) { return (next() >> 11) * 0x1.0p-53 < p; }
+};
+
+// Register codes as in the opcode bits: B C D E H L M A.
+static const u8 data_dst[] = {7, 1, 2, 3, 6}; // never B, H or L
+static const u8 rotates[] = {0x07, 0x0F, 0x17, 0x1F, 0x2F, 0x37, 0x3F, 0x27};
+static const u8 stack_pairs[][2] = {{0xC5, 0xD1}, {0xD5, 0xD1}, {0xE5, 0xE1}, {0xF5, 0xF1}, {0xF5, 0xD1}};
+static const u8 data_jumps[] = {0xC2, 0xCA, 0xE2, 0xEA, 0xF2, 0xFA}; // JNZ JZ JPO JPE JP JM
+
+struct Gen {
+    const GenProfile& p;
+    Rng rng;
+    std::vector<u8> code = {}; // from ORG
+    bool overflow = false;
+    double cycles = 0;    // estimated, of what is emitted with the current weight
+    double weight = 1;    // times the code being emitted runs per pass
+    bool straight = true; // top level of the loop body, where HL is tracked
+    int hl = 0;           // HL - DATA while straight
+    std::vector<u16> chains = {};
+    std::vector<double> chain_cycles = {};
+
+    u16 here() const { return u16(ORG + code.size()); }
+
+    // Every opcode goes through one of these, which take the operand size
+    // from opcode_table and count its cycles.
+    void emit(u8 o, int bytes, u16 v) {
+        if (opcode_table[o].bytes != bytes) {
+            fprintf(stderr, "gen: %s is %d bytes, not %d\n", opcode_table[o].mnemonic, opcode_table[o].bytes,
+                    bytes);
+            abort();
+        }
+        if (here() + bytes > CODE_END)
+            overflow = true;
+        if (overflow)
+            return;
+        code.push_back(o);
+        if (bytes > 1)
+            code.push_back(u8(v));
+        if (bytes > 2)
+            code.push_back(u8(v >> 8));
+        cycles += opcode_table[o].cycles * weight;
+    }
+    void op(u8 o) { emit(o, 1, 0); }
+    void op8(u8 o, u8 v) { emit(o, 2, v); }
+    void op16(u8 o, u16 v) { emit(o, 3, v); }
+    void patch16(size_t at, u16 v) {
+        if (at + 2 < code.size()) {
+            code[at + 1] = u8(v);
+            code[at + 2] = u8(v >> 8);
+        }
+    }
+
+    u16 data_addr() { return u16(DATA + rng.below(p.footprint)); }
+    u8 any_dst() { return data_dst[rng.below(5)]; }
+
+    int pick(bool simple_only) {
+        int last = simple_only ? GEN_MEMORY : GEN_CALL;
+        u32 total = 0;
+        for (int c = 0; c <= last; c++)
+            total += p.weight[c];
+        if (total == 0)
+            return GEN_MOV;
+        u32 r = rng.below(total);
+        for (int c = 0; c <= last; c++) {
+            if (r < p.weight[c])
+                return c;
+            r -= p.weight[c];
+        }
+        return GEN_MOV;
+    }
+
+    void simple(int c) {
+        switch (c) {
+        case GEN_MOV: {
+            u8 dst = any_dst(), src = u8(rng.below(8));
+            if (dst == 6 && src == 6)
+                src = 7; // MOV M,M is HLT
+            op(u8(0x40 | dst << 3 | src));
+            break;
+        }
+        case GEN_ALU:
+            op(u8(0x80 | rng.below(8) << 3 | rng.below(8)));
+            break;
+        case GEN_IMM: {
+            u32 r = rng.below(10);
+            if (r < 5)
+                op8(u8(0x06 | any_dst() << 3), u8(rng.next())); // MVI
+            else if (r < 9)
+                op8(u8(0xC6 | rng.below(8) << 3), u8(rng.next())); // ADI..CPI
+            else
+                op16(0x11, u16(rng.next())); // LXI D
+            break;
+        }
+        case GEN_INCDEC: {
+            u32 r = rng.below(straight ? 6 : 5);
+            bool dec = rng.below(2);
+            if (r < 4)
+                op(u8(0x04 | any_dst() << 3 | dec)); // INR/DCR
+            else if (r == 4)
+                op(dec ? 0x1B : 0x13); // DCX/INX D
+            else {
+                // keep HL inside the data area's slack
+                if (hl <= -HL_SLACK)
+                    dec = false;
+                else if (hl >= int(p.footprint) + HL_SLACK - 2)
+                    dec = true;
+                hl += dec ? -1 : 1;
+                op(dec ? 0x2B : 0x23); // DCX/INX H
+            }
+            break;
+        }
+        case GEN_ROTATE:
+            op(rotates[rng.below(8)]);
+            break;
+        case GEN_MEMORY:
+            switch (rng.below(straight ? 5 : 4)) {
+            case 0:
+                op16(0x3A, data_addr()); // LDA
+                break;
+            case 1:
+                op16(0x32, data_addr()); // STA
+                break;
+            case 2:
+                op16(0x11, data_addr());       // LXI D
+                op(rng.below(2) ? 0x1A : 0x12); // LDAX/STAX D
+                break;
+            case 3:
+                op16(0x22, u16(data_addr() & ~1)); // SHLD
+                break;
+            default: {
+                u16 a = data_addr();
+                hl = a - DATA;
+                op16(0x21, a); // LXI H
+                break;
+            }
+            }
+            break;
+        }
+    }
+
+    void simple() { simple(pick(true)); }
+
+    void branch() {
+        u8 cond;
+        double runs; // share of passes that run the skipped code
+        if (rng.chance(p.data_branches)) {
+            op(0xB7); // ORA A: the condition depends on A
+            cond = data_jumps[rng.below(6)];
+            runs = 0.5;
+        } else {
+            bool taken = rng.chance(p.taken_rate);
+            bool carry = rng.below(2);
+            op(carry ? 0x37 : 0xB7); // STC or ORA A
+            cond = (carry == taken) ? 0xDA : 0xD2; // JC or JNC
+            runs = taken ? 0 : 1;
+        }
+        size_t site = code.size();
+        op16(cond, 0);
+        double w = weight;
+        weight *= runs;
+        bool was = straight;
+        straight = false;
+        for (int n = 1 + int(rng.below(4)); n > 0; n--)
+            simple();
+        straight = was;
+        weight = w;
+        patch16(site, here());
+    }
+
+    void loop() {
+        u8 n = u8(2 + rng.below(7));
+        op8(0x06, n); // MVI B
+        u16 top = here();
+        double w = weight;
+        weight *= n;
+        bool was = straight;
+        straight = false;
+        for (int k = 1 + int(rng.below(3)); k > 0; k--)
+            simple();
+        op(0x05);         // DCR B
+        op16(0xC2, top); // JNZ
+        straight = was;
+        weight = w;
+    }
+
+    // Subroutines of one chain, deepest first so each call target is known.
+    void chain() {
+        double before = cycles;
+        bool was = straight;
+        straight = false;
+        u16 next = 0;
+        for (int d = p.call_depth - 1; d >= 0; d--) {
+            u16 entry = here();
+            for (int k = 1 + int(rng.below(3)); k > 0; k--)
+                simple();
+            if (next)
+                op16(0xCD, next); // CALL
+            op(0xC9);             // RET
+            next = entry;
+        }
+        straight = was;
+        chains.push_back(next);
+        chain_cycles.push_back(cycles - before);
+        cycles = before;
+    }
+
+    void slot() {
+        if (p.smc_rate > 0 && rng.chance(p.smc_rate)) {
+            // STA into the operand of the instruction right after it
+            op16(0x32, u16(here() + 4));
+            op8(rng.below(2) ? 0xC6 : 0x0E, u8(rng.next())); // ADI or MVI C
+            return;
+        }
+        int c = pick(false);
+        switch (c) {
+        case GEN_STACK: {
+            const u8* pair = stack_pairs[rng.below(5)];
+            op(pair[0]);
+            bool was = straight;
+            straight = false;
+            for (int k = int(rng.below(3)); k > 0; k--)
+                simple();
+            straight = was;
+            op(pair[1]);
+            break;
+        }
+        case GEN_BRANCH:
+            branch();
+            break;
+        case GEN_LOOP:
+            loop();
+            break;
+        case GEN_CALL:
+            if (chains.empty()) {
+                simple();
+                break;
+            }
+            {
+                u32 i = rng.below(u32(chains.size()));
+                op16(0xCD, chains[i]);
+                cycles += chain_cycles[i] * weight;
+            }
+            break;
+        default:
+            simple(c);
+        }
+    }
+};
+
+std::vector<u8> gen_rom(const GenProfile& p, u64 seed) {
+    bool pow2 = p.footprint && (p.footprint & (p.footprint - 1)) == 0;
+    if (!pow2 || p.footprint < 16 || p.footprint > 16384 || p.call_depth < 1 || p.call_depth > 8 || p.body < 1 ||
+        p.body > 2000 || p.taken_rate > 1 || p.data_branches > 1 || p.smc_rate > 1)
+        return {};
+
+    Gen g{p, {seed}};
+    g.op16(0xC3, 0); // JMP main
+    if (p.weight[GEN_CALL])
+        for (int i = 0; i < 4; i++)
+            g.chain();
+    g.patch16(0, g.here());
+
+    g.op16(0x31, STACK); // LXI SP
+    for (u8 r : {0x0E, 0x16, 0x1E, 0x3E})
+        g.op8(r, u8(g.rng.next())); // MVI C, D, E, A
+    size_t rounds_site = g.code.size();
+    g.op8(0x3E, 0);       // MVI A,rounds
+    g.op16(0x32, ROUNDS); // STA
+    u16 reload = g.here();
+    size_t count_site = g.code.size();
+    g.op16(0x21, 0);     // LXI H,count
+    g.op16(0x22, COUNT); // SHLD
+
+    // one pass: the body, then the 16-bit count in memory
+    g.cycles = 0;
+    u16 top = g.here();
+    u16 start = g.data_addr();
+    g.hl = start - DATA;
+    g.op16(0x21, start);
+    for (int i = 0; i < p.body; i++)
+        g.slot();
+    g.op16(0x2A, COUNT); // LHLD
+    g.op(0x2B);          // DCX H
+    g.op16(0x22, COUNT); // SHLD
+    g.op(0x7C);          // MOV A,H
+    g.op(0xB5);          // ORA L
+    g.op16(0xC2, top);   // JNZ
+    double pass = g.cycles;
+
+    g.op16(0x3A, ROUNDS); // LDA
+    g.op(0x3D);           // DCR A
+    g.op16(0x32, ROUNDS); // STA
+    g.op16(0xC2, reload); // JNZ
+    g.op8(0x0E, 0);       // MVI C,0
+    g.op16(0xCD, 0x0005); // CALL BDOS: exit
+    g.op16(0xC3, 0x0000); // JMP 0 should BDOS return
+    if (g.overflow)
+        return {};
+
+    u64 passes = pass > 0 ? u64(p.cycles / pass) : 1;
+    passes = passes < 1 ? 1 : passes > 255ull * 65535 ? 255ull * 65535 : passes;
+    u64 rounds = (passes + 65534) / 65535;
+    u64 count = (passes + rounds - 1) / rounds;
+    g.code[rounds_site + 1] = u8(rounds);
+    g.patch16(count_site, u16(count));
+    return g.code;
+}
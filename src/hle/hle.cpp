@@ -0,0 +1,160 @@
+#include "hle/hle.h"
+#include "bulk/bulk.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Signature {
+    std::vector<u8> bytes; // masked bytes are 0
+    std::vector<u8> mask;  // 0xFF where the byte counts
+    u64 hash;
+};
+
+static u64 fingerprint(const u8* code, const Signature& s) {
+    u64 h = 1469598103934665603ull;
+    for (size_t i = 0; i < s.bytes.size(); i++)
+        h = (h ^ (code[i] & s.mask[i])) * 1099511628211ull;
+    return h;
+}
+
+static Signature parse(const char* pattern) {
+    Signature s;
+    for (const char* p = pattern; *p;) {
+        if (*p == ' ') {
+            p++;
+            continue;
+        }
+        if (p[0] == '?') {
+            s.bytes.push_back(0);
+            s.mask.push_back(0);
+        } else {
+            s.bytes.push_back(u8(strtoul(std::string(p, 2).c_str(), nullptr, 16)));
+            s.mask.push_back(0xFF);
+        }
+        p += 2;
+    }
+    s.hash = fingerprint(s.bytes.data(), s);
+    return s;
+}
+
+static const std::vector<Signature>& signatures() {
+    static const std::vector<Signature> sigs = [] {
+        int n;
+        const HleRoutine* r = hle_registry(&n);
+        std::vector<Signature> v;
+        for (int i = 0; i < n; i++)
+            v.push_back(parse(r[i].pattern));
+        return v;
+    }();
+    return sigs;
+}
+
+static bool fits(u16 addr, const Signature& s) { return addr + s.bytes.size() <= 0x10000; }
+
+static bool still_matches(const u8* code, const Signature& s) {
+    for (size_t i = 0; i < s.bytes.size(); i++)
+        if ((code[i] & s.mask[i]) != s.bytes[i])
+            return false;
+    return true;
+}
+
+bool hle_matches(const u8* mem, u16 addr, int r) {
+    const Signature& s = signatures()[r];
+    return fits(addr, s) && still_matches(mem + addr, s);
+}
+
+Hle::Hle() {
+    int n;
+    hle_registry(&n);
+    stats.reset(new HleStats[n]);
+    target.reset(new u8[0x10000]());
+}
+
+u32 Hle::call(CPU& cpu) {
+    const u8* mem = cpu.mem->data;
+    u8& t = target[cpu.pc];
+    if (t == 0) {
+        // fingerprint the target once; a match keeps a copy of its code
+        const std::vector<Signature>& sigs = signatures();
+        t = 1;
+        for (size_t i = 0; i < sigs.size() && matches.size() < 254; i++) {
+            if (fits(cpu.pc, sigs[i]) && fingerprint(mem + cpu.pc, sigs[i]) == sigs[i].hash &&
+                still_matches(mem + cpu.pc, sigs[i])) {
+                matches.push_back({int(i), std::vector<u8>(mem + cpu.pc, mem + cpu.pc + sigs[i].bytes.size())});
+                t = u8(matches.size() + 1);
+                break;
+            }
+        }
+    }
+    if (t == 1)
+        return 0;
+    const HleMatch& m = matches[t - 2];
+    if (memcmp(mem + cpu.pc, m.code.data(), m.code.size()) != 0) {
+        t = 0; // the code changed: look again next time
+        return 0;
+    }
+    int r = m.routine;
+    if (verify && stats[r].verified < verify_limit)
+        return verify_call(cpu, r);
+
+    u32 n = hle_registry(nullptr)[r].run(cpu);
+    if (n == 0) {
+        declined++;
+        return 0;
+    }
+    cpu.cycles += n;
+    stats[r].calls++;
+    stats[r].cycles += n;
+    return n;
+}
+
+static bool same_regs(const CPU& x, const CPU& y) {
+    return x.a == y.a && x.b == y.b && x.c == y.c && x.d == y.d && x.e == y.e && x.h == y.h && x.l == y.l &&
+           x.sp == y.sp && x.pc == y.pc && x.flags.f == y.flags.f && x.inte == y.inte && x.halted == y.halted &&
+           x.cycles == y.cycles;
+}
+
+// Native first, then the interpreter from the same state until the
+// routine returns; the interpreter's state stands.
+u32 Hle::verify_call(CPU& cpu, int r) {
+    if (!scratch)
+        scratch.reset(new u8[0x20000]);
+    u8* before = scratch.get();
+    u8* native = scratch.get() + 0x10000;
+    u8* data = cpu.mem->data;
+
+    CPU start = cpu;
+    memcpy(before, data, 0x10000);
+    u32 n = hle_registry(nullptr)[r].run(cpu);
+    if (n == 0) {
+        declined++;
+        return 0;
+    }
+    cpu.cycles += n;
+    CPU done = cpu;
+    memcpy(native, data, 0x10000);
+
+    memcpy(data, before, 0x10000);
+    cpu = start;
+    u16 ret = u16(data[start.sp] | data[u16(start.sp + 1)] << 8);
+    while (cpu.pc != ret || cpu.sp != u16(start.sp + 2))
+        if (cpu.step() == 0 || cpu.cycles - start.cycles > 100000000)
+            break;
+
+    u64 pages[4];
+    bulk_diff_pages(data, native, 256, pages);
+    bool regs_ok = same_regs(cpu, done);
+    bool mem_ok = (pages[0] | pages[1] | pages[2] | pages[3]) == 0;
+    HleStats& s = stats[r];
+    s.verified++;
+    if (!regs_ok || !mem_ok) {
+        if (s.mismatches++ == 0)
+            printf("[hle] %s at %04X differs from the interpreter:%s%s (cycles %llu vs %llu)\n",
+                   hle_registry(nullptr)[r].name, start.pc, regs_ok ? "" : " registers",
+                   mem_ok ? "" : " memory", (unsigned long long)(done.cycles - start.cycles),
+                   (unsigned long long)(cpu.cycles - start.cycles));
+    }
+    return u32(cpu.cycles - start.cycles);
+}
@@ -0,0 +1,326 @@
+#include "hle/hle.h"
+#include "cpu/opcodes.h"
+
+// Natives for the routines that dominate the bundled 8080EXER (about 90%
+// of its cycles). Each is a line-by-line transcription of the 8080 code:
+// every instruction updates registers, flags and memory the way the
+// interpreter does and adds its cycles from timing_table. What saves time
+// is skipping fetch, decode and dispatch. Routines are assumed not to
+// modify their own code.
+
+namespace {
+
+struct Run {
+    CPU& cpu;
+    Memory& m;
+    u32 t = 0;
+
+    explicit Run(CPU& c) : cpu(c), m(*c.mem) {}
+
+    void op(u8 o) { t += timing_table[o].not_taken; }
+    void op_taken(u8 o) { t += timing_table[o].taken; }
+
+    u8 rd(u16 a) { return m.read(a); }
+    u16 rd16(u16 a) { return u16(rd(a) | rd(u16(a + 1)) << 8); }
+    void push(u16 v) {
+        m.write(--cpu.sp, u8(v >> 8));
+        m.write(--cpu.sp, u8(v));
+    }
+    u16 pop() {
+        u8 lo = rd(cpu.sp++);
+        u8 hi = rd(cpu.sp++);
+        return u16(hi << 8 | lo);
+    }
+    void push_psw() { push(cpu.psw | 0x02); }
+    void pop_psw() { cpu.psw = (pop() & 0xFFD7) | 0x02; }
+    void ret() { cpu.pc = pop(); }
+};
+
+// flag rules as in instructions.cpp
+
+void cmp(CPU& c, u8 v) {
+    u16 result = u16(c.a - v);
+    u8 res8 = u8(result);
+    c.flags.z = res8 == 0;
+    c.flags.s = (res8 & 0x80) != 0;
+    c.flags.p = parity(res8);
+    c.flags.c = result > 0xFF;
+    c.flags.ac = (c.a & 0x0F) + (~v & 0x0F) + 1 > 0x0F;
+}
+
+void ana(CPU& c, u8 v) {
+    c.flags.ac = ((c.a | v) & 0x08) != 0;
+    c.a &= v;
+    c.flags.c = 0;
+    setZSP(c.flags, c.a);
+}
+
+void xra(CPU& c, u8 v) {
+    c.a ^= v;
+    c.flags.c = 0;
+    c.flags.ac = 0;
+    setZSP(c.flags, c.a);
+}
+
+void ora(CPU& c, u8 v) {
+    c.a |= v;
+    c.flags.c = 0;
+    c.flags.ac = 0;
+    setZSP(c.flags, c.a);
+}
+
+void rlc(CPU& c) {
+    u8 msb = c.a >> 7;
+    c.a = u8(c.a << 1 | msb);
+    c.flags.c = msb;
+}
+
+void rrc(CPU& c) {
+    u8 lsb = c.a & 1;
+    c.a = u8(c.a >> 1 | lsb << 7);
+    c.flags.c = lsb;
+}
+
+void dcr_b(CPU& c) {
+    c.flags.ac = (c.b & 0x0F) != 0x00;
+    c.b--;
+    setZSP(c.flags, c.b);
+}
+
+void dcr_c(CPU& c) {
+    c.flags.ac = (c.c & 0x0F) != 0x00;
+    c.c--;
+    setZSP(c.flags, c.c);
+}
+
+void dad(CPU& c, u16 v) {
+    u32 res = u32(c.hl) + v;
+    c.flags.c = res > 0xFFFF;
+    c.hl = u16(res);
+}
+
+void xchg(CPU& c) {
+    u16 de = c.de;
+    c.de = c.hl;
+    c.hl = de;
+}
+
+enum { R_CRC, R_BIT, R_FIELD, R_CLEAR };
+
+// ---- CRC-32 update of the 4-byte big-endian CRC at HL with A, table driven
+
+u32 crc_update(CPU& cpu) {
+    Run r(cpu);
+    CPU& c = cpu;
+    u16 e = c.pc;
+    if (r.rd16(u16(e + 0x21)) != u16(e + 0x19))
+        return 0;
+    u16 table = r.rd16(u16(e + 0x11));
+
+    r.push_psw(), r.op(0xF5);
+    r.push(c.bc), r.op(0xC5);
+    r.push(c.de), r.op(0xD5);
+    r.push(c.hl), r.op(0xE5);
+    r.push(c.hl), r.op(0xE5);
+    c.de = 0x0003, r.op(0x11);
+    dad(c, c.de), r.op(0x19);
+    xra(c, r.rd(c.hl)), r.op(0xAE);
+    c.l = c.a, r.op(0x6F);
+    c.h = 0, r.op(0x26);
+    dad(c, c.hl), r.op(0x29);
+    dad(c, c.hl), r.op(0x29);
+    xchg(c), r.op(0xEB);
+    c.hl = table, r.op(0x21);
+    dad(c, c.de), r.op(0x19);
+    xchg(c), r.op(0xEB);
+    c.hl = r.pop(), r.op(0xE1);
+    c.bc = 0x0004, r.op(0x01);
+    do {
+        c.a = r.rd(c.de), r.op(0x1A);
+        xra(c, c.b), r.op(0xA8);
+        c.b = r.rd(c.hl), r.op(0x46);
+        r.m.write(c.hl, c.a), r.op(0x77);
+        c.de = u16(c.de + 1), r.op(0x13);
+        c.hl = u16(c.hl + 1), r.op(0x23);
+        dcr_c(c), r.op(0x0D);
+        r.op(0xC2);
+    } while (!c.flags.z);
+    c.hl = r.pop(), r.op(0xE1);
+    c.de = r.pop(), r.op(0xD1);
+    c.bc = r.pop(), r.op(0xC1);
+    r.pop_psw(), r.op(0xF1);
+    r.ret(), r.op(0xC9);
+    return r.t;
+}
+
+// ---- next bit of a counter or shifter: steps a one-bit mask through the
+// bytes of a field and returns A = 1 if that bit is set, else 0
+
+bool bit_ok(Run& r, u16 e) {
+    u16 p = r.rd16(u16(e + 3));
+    return r.rd16(u16(e + 0x13)) == p && r.rd16(u16(e + 0x17)) == p && r.rd16(u16(e + 0x10)) == u16(e + 0x19);
+}
+
+void bit_body(Run& r, u16 e) {
+    CPU& c = r.cpu;
+    u16 p = r.rd16(u16(e + 3));
+    u16 mask = r.rd16(u16(e + 7));
+
+    r.push(c.bc), r.op(0xC5);
+    r.push(c.hl), r.op(0xE5);
+    c.hl = r.rd16(p), r.op(0x2A);
+    c.b = r.rd(c.hl), r.op(0x46);
+    c.hl = mask, r.op(0x21);
+    c.a = r.rd(c.hl), r.op(0x7E);
+    c.c = c.a, r.op(0x4F);
+    rlc(c), r.op(0x07);
+    r.m.write(c.hl, c.a), r.op(0x77);
+    cmp(c, 0x01), r.op(0xFE);
+    r.op(0xC2);
+    if (c.flags.z) {
+        c.hl = r.rd16(p), r.op(0x2A);
+        c.hl = u16(c.hl + 1), r.op(0x23);
+        r.m.write(p, c.l), r.m.write(u16(p + 1), c.h), r.op(0x22);
+    }
+    c.a = c.b, r.op(0x78);
+    ana(c, c.c), r.op(0xA1);
+    c.hl = r.pop(), r.op(0xE1);
+    c.bc = r.pop(), r.op(0xC1);
+    if (c.flags.z) {
+        r.op_taken(0xC8), r.ret();
+        return;
+    }
+    r.op(0xC8);
+    c.a = 0x01, r.op(0x3E);
+    r.ret(), r.op(0xC9);
+}
+
+u32 bit_next(CPU& cpu) {
+    Run r(cpu);
+    if (!bit_ok(r, cpu.pc))
+        return 0;
+    bit_body(r, cpu.pc);
+    return r.t;
+}
+
+// ---- one byte of a test field: (HL) xor'ed with the counter bits selected
+// by the mask at HL+20 and the shifter bits selected by the mask at HL+40,
+// stored at DE, which is advanced
+
+u32 field_byte(CPU& cpu) {
+    Run r(cpu);
+    CPU& c = cpu;
+    u16 e = c.pc;
+    u16 callee[2] = {r.rd16(u16(e + 0x15)), r.rd16(u16(e + 0x32))};
+    if (r.rd16(u16(e + 0x0C)) != u16(e + 0x21) || r.rd16(u16(e + 0x1D)) != u16(e + 0x10) ||
+        r.rd16(u16(e + 0x29)) != u16(e + 0x3C) || r.rd16(u16(e + 0x3A)) != u16(e + 0x2D))
+        return 0;
+    for (u16 f : callee)
+        if (!hle_matches(c.mem->data, f, R_BIT) || !bit_ok(r, f))
+            return 0;
+
+    r.push(c.bc), r.op(0xC5);
+    r.push(c.de), r.op(0xD5);
+    r.push(c.hl), r.op(0xE5);
+    c.c = r.rd(c.hl), r.op(0x4E);
+    for (int half = 0; half < 2; half++) {
+        c.de = 0x0014, r.op(0x11);
+        dad(c, c.de), r.op(0x19);
+        c.a = r.rd(c.hl), r.op(0x7E);
+        cmp(c, 0x00), r.op(0xFE);
+        r.op(0xCA);
+        if (c.flags.z)
+            continue;
+        c.b = 0x08, r.op(0x06);
+        do {
+            rrc(c), r.op(0x0F);
+            r.push_psw(), r.op(0xF5);
+            c.a = 0x00, r.op(0x3E);
+            if (c.flags.c) {
+                r.op_taken(0xDC);
+                r.push(u16(e + (half ? 0x34 : 0x17)));
+                bit_body(r, callee[half]);
+            } else {
+                r.op(0xDC);
+            }
+            xra(c, c.c), r.op(0xA9);
+            rrc(c), r.op(0x0F);
+            c.c = c.a, r.op(0x4F);
+            r.pop_psw(), r.op(0xF1);
+            dcr_b(c), r.op(0x05);
+            r.op(0xC2);
+        } while (!c.flags.z);
+        if (half == 0)
+            c.b = 0x08, r.op(0x06);
+    }
+    c.hl = r.pop(), r.op(0xE1);
+    c.de = r.pop(), r.op(0xD1);
+    c.a = c.c, r.op(0x79);
+    r.m.write(c.de, c.a), r.op(0x12);
+    c.de = u16(c.de + 1), r.op(0x13);
+    c.bc = r.pop(), r.op(0xC1);
+    r.ret(), r.op(0xC9);
+    return r.t;
+}
+
+// ---- clear BC bytes at HL: zero the first, then copy each byte onto the
+// next
+
+u32 clear_block(CPU& cpu) {
+    Run r(cpu);
+    CPU& c = cpu;
+    u16 e = c.pc;
+    if (r.rd16(u16(e + 0x12)) != u16(e + 0x0A))
+        return 0;
+
+    r.push_psw(), r.op(0xF5);
+    r.push(c.bc), r.op(0xC5);
+    r.push(c.de), r.op(0xD5);
+    r.push(c.hl), r.op(0xE5);
+    r.m.write(c.hl, 0x00), r.op(0x36);
+    c.d = c.h, r.op(0x54);
+    c.e = c.l, r.op(0x5D);
+    c.de = u16(c.de + 1), r.op(0x13);
+    c.bc = u16(c.bc - 1), r.op(0x0B);
+    do {
+        c.a = r.rd(c.hl), r.op(0x7E);
+        r.m.write(c.de, c.a), r.op(0x12);
+        c.hl = u16(c.hl + 1), r.op(0x23);
+        c.de = u16(c.de + 1), r.op(0x13);
+        c.bc = u16(c.bc - 1), r.op(0x0B);
+        c.a = c.b, r.op(0x78);
+        ora(c, c.c), r.op(0xB1);
+        r.op(0xC2);
+    } while (!c.flags.z);
+    c.hl = r.pop(), r.op(0xE1);
+    c.de = r.pop(), r.op(0xD1);
+    c.bc = r.pop(), r.op(0xC1);
+    r.pop_psw(), r.op(0xF1);
+    r.ret(), r.op(0xC9);
+    return r.t;
+}
+
+const HleRoutine routines[] = {
+    {"crc32 update", // 8080EXER 0E66
+     "F5 C5 D5 E5 E5 11 03 00 19 AE 6F 26 00 29 29 EB 21 ?? ?? 19 EB E1 01 04 00 1A A8 46 77 13 23 0D C2 ?? ?? "
+     "E1 D1 C1 F1 C9",
+     crc_update},
+    {"next counter/shifter bit", // 8080EXER 0BEF and 0C13
+     "C5 E5 2A ?? ?? 46 21 ?? ?? 7E 4F 07 77 FE 01 C2 ?? ?? 2A ?? ?? 23 22 ?? ?? 78 A1 E1 C1 C8 3E 01 C9",
+     bit_next},
+    {"test field byte", // 8080EXER 0BA9
+     "C5 D5 E5 4E 11 14 00 19 7E FE 00 CA ?? ?? 06 08 0F F5 3E 00 DC ?? ?? A9 0F 4F F1 05 C2 ?? ?? 06 08 "
+     "11 14 00 19 7E FE 00 CA ?? ?? 06 08 0F F5 3E 00 DC ?? ?? A9 0F 4F F1 05 C2 ?? ?? E1 D1 79 12 13 C1 C9",
+     field_byte},
+    {"clear block", // 8080EXER 0C34
+     "F5 C5 D5 E5 36 00 54 5D 13 0B 7E 12 23 13 0B 78 B1 C2 ?? ?? E1 D1 C1 F1 C9",
+     clear_block},
+};
+
+} // namespace
+
+const HleRoutine* hle_registry(int* count) {
+    if (count)
+        *count = int(sizeof(routines) / sizeof(routines[0]));
+    return routines;
+}
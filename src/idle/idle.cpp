@@ -0,0 +1,181 @@
+#include "idle/idle.h"
+#include "cpu/decode.h"
+#include <algorithm>
+#include <cstring>
+
+static constexpr int MAX_INSNS = 8;
+
+// What a loop body may contain: no memory writes, no stack, no OUT, INs
+// only from pure ports, and no control flow but jumps and branches.
+static bool allowed(const DecodedInsn& d, const u64* pure_in) {
+    if (d.mem & MEM_WRITE)
+        return false;
+    if ((d.mem & 0x0f) == MEM_STACK)
+        return false;
+    if ((d.mem & 0x0f) == MEM_PORT && !(pure_in[d.imm >> 6] >> (d.imm & 63) & 1))
+        return false;
+    return d.flow == FLOW_NONE || d.flow == FLOW_JUMP || d.flow == FLOW_BRANCH;
+}
+
+// Register pair code of MOV A,r / ORA r operands: B,C -> 0, D,E -> 1, H,L -> 2.
+static bool halves_of(int pair, u8 x, u8 y) {
+    u8 hi = u8(pair * 2), lo = u8(pair * 2 + 1);
+    return (x == hi && y == lo) || (x == lo && y == hi);
+}
+
+static void analyse(IdleLoop& loop, const u8* mem, u16 head, const u64* pure_in) {
+    loop.head = head;
+    loop.kind = IDLE_NONE;
+    loop.len = 1;
+    int len = 0;
+    u16 exits[MAX_INSNS];
+    int nexits = 0;
+    for (int i = 0; i < MAX_INSNS; i++) {
+        DecodedInsn d = decode(mem, u16(head + len));
+        if (head + len + d.len > 0x10000 || len + d.len > IDLE_MAX_BODY)
+            break;
+        len += d.len;
+        loop.len = u8(len);
+        if (!allowed(d, pure_in))
+            break;
+        if (d.flow == FLOW_NONE)
+            continue;
+        if (d.target == head) {
+            loop.kind = IDLE_SPIN;
+            break;
+        }
+        if (d.flow != FLOW_BRANCH)
+            break;
+        exits[nexits++] = d.target; // leaves the loop when taken
+    }
+    memcpy(loop.code, mem + head, loop.len);
+    for (int i = 0; i < nexits; i++)
+        if (u16(exits[i] - head) < loop.len)
+            loop.kind = IDLE_NONE;
+    if (loop.kind != IDLE_SPIN)
+        return;
+
+    const u8* c = loop.code;
+    if (loop.len == 4 && (c[0] & 0xC7) == 0x05 && (c[0] >> 3 & 7) != 6 && c[1] == 0xC2) {
+        loop.kind = IDLE_COUNT8; // DCR r / JNZ
+        loop.reg = c[0] >> 3 & 7;
+    } else if (loop.len == 6 && (c[0] & 0xCF) == 0x0B && (c[0] >> 4) < 3 && (c[1] & 0xF8) == 0x78 &&
+               (c[2] & 0xF8) == 0xB0 && c[3] == 0xC2 && halves_of(c[0] >> 4, c[1] & 7, c[2] & 7)) {
+        loop.kind = IDLE_COUNT16; // DCX rp / MOV A,x / ORA y / JNZ
+        loop.reg = c[0] >> 4;
+    }
+}
+
+static IdleLoop& lookup(IdleSkip& s, const u8* mem, u16 head) {
+    IdleLoop& loop = s.cache[head & 0xFF];
+    if (loop.len == 0 || loop.head != head || memcmp(loop.code, mem + head, loop.len) != 0)
+        analyse(loop, mem, head, s.pure_in);
+    return loop;
+}
+
+// Steps through one pass of the body as the plain run loop would; true
+// when it came back to the head.
+static bool iterate(CPU& cpu, const IdleLoop& loop, u64 target) {
+    do {
+        if (cpu.cycles >= target || cpu.step() == 0)
+            return false;
+    } while (cpu.pc != loop.head && u16(cpu.pc - loop.head) < loop.len);
+    return cpu.pc == loop.head;
+}
+
+static bool same_regs(const CPU& x, const CPU& y) {
+    return x.a == y.a && x.b == y.b && x.c == y.c && x.d == y.d && x.e == y.e && x.h == y.h && x.l == y.l &&
+           x.sp == y.sp && x.flags.f == y.flags.f && x.inte == y.inte;
+}
+
+static u8& reg8(CPU& cpu, int code) {
+    u8* r[8] = {&cpu.b, &cpu.c, &cpu.d, &cpu.e, &cpu.h, &cpu.l, nullptr, &cpu.a};
+    return *r[code];
+}
+
+u64 IdleSkip::skip(CPU& cpu, u64 target) {
+    if (!enabled || cpu.cycles >= target)
+        return 0;
+
+    if (cpu.halted) {
+        // stepping adds 4 cycles at a time until the target is reached
+        u64 n = (target - cpu.cycles + 3) / 4 * 4;
+        cpu.cycles += n;
+        halts++;
+        saved += n;
+        return n;
+    }
+
+    IdleLoop& loop = lookup(*this, cpu.mem->data, cpu.pc);
+    if (loop.kind == IDLE_NONE)
+        return 0;
+
+    // One real pass gives the cycles per pass. A spin may load what it
+    // polls into registers that held something else on the way in, so it
+    // settles with one pass and is a fixed point if a second changes nothing.
+    CPU before = cpu;
+    if (!iterate(cpu, loop, target))
+        return 0;
+    if (loop.kind == IDLE_SPIN) {
+        before = cpu;
+        if (!iterate(cpu, loop, target))
+            return 0;
+    }
+    u64 per = cpu.cycles - before.cycles;
+    u64 room = (target - cpu.cycles) / per; // whole passes before target
+
+    if (loop.kind == IDLE_SPIN) {
+        if (!same_regs(before, cpu))
+            return 0; // not idle (yet); checked again on the next entry
+        u64 n = room * per;
+        cpu.cycles += n;
+        spins += n != 0;
+        saved += n;
+        return n;
+    }
+
+    // Countdowns skip all but one of the passes left before the exit or
+    // the target; the last runs for real so the flags come out as stepping
+    // leaves them.
+    u32 left;
+    if (loop.kind == IDLE_COUNT8)
+        left = reg8(cpu, loop.reg);
+    else
+        left = loop.reg == 0 ? cpu.BC() : loop.reg == 1 ? cpu.DE() : cpu.HL();
+    if (left < 2 || room < 2)
+        return 0;
+    u64 k = std::min<u64>(left - 1, room - 1);
+    if (loop.kind == IDLE_COUNT8) {
+        reg8(cpu, loop.reg) -= u8(k);
+    } else {
+        u16 v = u16(left - k);
+        if (loop.reg == 0)
+            cpu.setBC(v);
+        else if (loop.reg == 1)
+            cpu.setDE(v);
+        else
+            cpu.setHL(v);
+    }
+    cpu.cycles += k * per;
+    iterate(cpu, loop, target);
+    countdowns++;
+    saved += k * per;
+    return k * per;
+}
+
+bool idle_run(IdleSkip& idle, CPU& cpu, u64 target) {
+    if (!idle.enabled) {
+        while (cpu.cycles < target)
+            if (cpu.step() == 0)
+                return false;
+        return true;
+    }
+    while (cpu.cycles < target) {
+        u16 from = cpu.pc;
+        if (cpu.step() == 0)
+            return false;
+        if (cpu.pc <= from || cpu.halted)
+            idle.skip(cpu, target);
+    }
+    return true;
+}
@@ -0,0 +1,178 @@
+#include "machine/invaders.h"
+#include "cpu/load.h"
+#include "bulk/bulk.h"
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+constexpr u32 PIXEL_ON = 0xFFFFFFFF;
+constexpr u32 PIXEL_OFF = 0xFF000000;
+
+static u8 invaders_in(void* ctx, u8 port) {
+    Invaders& m = *static_cast<Invaders*>(ctx);
+    switch (port) {
+    case 0:
+        return 0x0E;
+    case 1:
+        return 0x08 | m.port1; // bit 3 is always set
+    case 2:
+        return m.port2;
+    case 3:
+        return u8(m.shift >> (8 - m.shift_off));
+    default:
+        return 0;
+    }
+}
+
+static void invaders_out(void* ctx, u8 port, u8 value) {
+    Invaders& m = *static_cast<Invaders*>(ctx);
+    switch (port) {
+    case 2:
+        m.shift_off = value & 7;
+        break;
+    case 3:
+        m.sound[0] = value;
+        break;
+    case 4:
+        m.shift = u16(value << 8) | (m.shift >> 8);
+        break;
+    case 5:
+        m.sound[1] = value;
+        break;
+    default: // 6: watchdog
+        break;
+    }
+}
+
+void Invaders::reset() {
+    cpu.mem = &mem;
+    cpu.reset();
+    io = IOPorts{invaders_in, invaders_out, this};
+    cpu.io = &io;
+
+    shift = 0;
+    shift_off = 0;
+    port1 = 0;
+    port2 = 0;
+    sound[0] = sound[1] = 0;
+    frames = 0;
+    frame_start = 0;
+    tap.cpu = nullptr;
+    record = nullptr;
+    replay = nullptr;
+    idle = IdleSkip();
+    for (int port = 0; port < 4; port++)
+        idle.set_pure_in(u8(port)); // inputs, dip switches and the shifter
+
+    for (u32& px : rgba)
+        px = PIXEL_OFF;
+    bulk_clear(shadow, sizeof(shadow));
+}
+
+bool Invaders::load(const char* path) {
+    mem.reset();
+    std::vector<u8> bytes;
+    if (!std::filesystem::is_directory(path)) {
+        if (!readROM(path, bytes) || bytes.empty() || bytes.size() > 0x2000)
+            return false;
+        std::memcpy(mem.data, bytes.data(), bytes.size());
+        return true;
+    }
+
+    // MAME-style split set
+    static const char* parts[] = {"invaders.h", "invaders.g", "invaders.f", "invaders.e"};
+    for (int i = 0; i < 4; i++) {
+        std::string name = std::string(path) + "/" + parts[i];
+        if (!readROM(name.c_str(), bytes) || bytes.size() != 0x800)
+            return false;
+        std::memcpy(mem.data + i * 0x800, bytes.data(), 0x800);
+    }
+    return true;
+}
+
+void Invaders::trace(Recorder* rec, Replayer* rep) {
+    tap.detach();
+    record = rec;
+    replay = rep;
+    if (rec || rep)
+        tap.attach(cpu, rec, rep);
+}
+
+static bool run_until(CPU& cpu, u64 target, Replayer* replay, IdleSkip* idle) {
+    if (replay) {
+        while (cpu.cycles < target) {
+            replay_interrupts(cpu, *replay);
+            if (cpu.step() == 0)
+                return false;
+        }
+        return true;
+    }
+    if (idle)
+        return idle_run(*idle, cpu, target);
+    while (cpu.cycles < target)
+        if (cpu.step() == 0)
+            return false;
+    return true;
+}
+
+bool Invaders::run_frame() {
+    IdleSkip* skip = record || replay ? nullptr : &idle;
+    // targets are absolute so the overshoot of the last instruction is
+    // taken off the next half frame
+    if (!run_until(cpu, frame_start + INVADERS_FRAME_CYCLES / 2, replay, skip))
+        return false;
+    if (replay)
+        replay_interrupts(cpu, *replay);
+    else
+        raise_interrupt(cpu, 0xCF, record); // RST 1
+
+    frame_start += INVADERS_FRAME_CYCLES;
+    if (!run_until(cpu, frame_start, replay, skip))
+        return false;
+    if (replay)
+        replay_interrupts(cpu, *replay);
+    else
+        raise_interrupt(cpu, 0xD7, record); // RST 2
+    frames++;
+    return true;
+}
+
+// 8 pixels from one VRAM byte: each lane tests its own bit.
+typedef u32 pixel8 __attribute__((vector_size(32)));
+typedef int mask8 __attribute__((vector_size(32)));
+
+static inline void expand_byte(u8 bits, u32* out) {
+    const pixel8 bit = {1, 2, 4, 8, 16, 32, 64, 128};
+    mask8 on = (mask8)((pixel8{} + bits) & bit) != 0;
+    pixel8 px = ((pixel8)on & PIXEL_ON) | ((pixel8)~on & PIXEL_OFF);
+    std::memcpy(out, &px, sizeof(px));
+}
+
+int Invaders::render() {
+    const u8* vram = mem.data + INVADERS_VRAM;
+    // pages (8 rows each) that changed since the last render
+    constexpr int PAGES = sizeof(shadow) / 256;
+    constexpr int ROWS_PER_PAGE = 256 / INVADERS_ROW_BYTES;
+    u64 changed[1];
+    static_assert(PAGES <= 64);
+    bulk_diff_pages(vram, shadow, PAGES, changed);
+    int dirty = 0;
+    for (int row = 0; row < INVADERS_ROWS; row++) {
+        if (!(changed[0] >> (row / ROWS_PER_PAGE) & 1)) {
+            row += ROWS_PER_PAGE - 1;
+            continue;
+        }
+        const u8* src = vram + row * INVADERS_ROW_BYTES;
+        u8* seen = shadow + row * INVADERS_ROW_BYTES;
+        if (std::memcmp(src, seen, INVADERS_ROW_BYTES) == 0)
+            continue;
+        std::memcpy(seen, src, INVADERS_ROW_BYTES);
+
+        u32* out = rgba + row * INVADERS_WIDTH;
+        for (int x = 0; x < INVADERS_ROW_BYTES; x++)
+            expand_byte(src[x], out + x * 8);
+        dirty++;
+    }
+    return dirty;
+}
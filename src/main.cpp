@@ -1,11 +1,190 @@
 #include "cpu/cpu.h"
 #include "memory/memory.h"
 #include "cpu/load.h"
+#include "cpm/bdos.h"
+#include "cpm/bios.h"
+#include "pace/pace.h"
+#include "replay/replay.h"
+#include "gdb/stub.h"
+#include "rewind/rewind.h"
+#include "hle/hle.h"
+#include "perf/perf.h"
+#include "metrics/metrics.h"
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <memory>
 
-int main(void)
+enum StepResult
 {
+    STEP_OK,
+    STEP_EXIT,
+    STEP_ERROR,
+    STEP_HALT, // HLT with interrupts disabled: nothing can resume the CPU
+};
+
+static int step(CPU& cpu, Hle* hle)
+{
+    return hle ? hle_step(*hle, cpu) : cpu.step();
+}
+
+static StepResult run_one(CPU& cpu, Console& con, Bios* bios, Hle* hle, PerfProfile* perf)
+{
+    int cycles = perf ? perf->step(cpu, [&] { return step(cpu, hle); }) : step(cpu, hle);
+    if ((cpu.flags.f & 0x02) == 0)
+    {
+        printf("ERROR: flag bit1 cleared at PC=%04X\n", cpu.pc);
+        exit(1);
+    }
+
+    // BDOS trap
+    if (cpu.pc == BDOS_ENTRY && bdos_call(cpu, con) == BDOS_EXIT)
+    {
+        // PROGRAM TERMINATION
+        printf("\n[BDOS] Program terminated\n");
+        return STEP_EXIT;
+    }
+    if (bios && is_bios_entry(cpu.pc) && !bios_call(cpu, con, *bios))
+    {
+        printf("\n[BIOS] Boot\n");
+        return STEP_EXIT;
+    }
+    if (cpu.pc == WARM_BOOT)
+    {
+        printf("\n[BDOS] Warm boot\n");
+        return STEP_EXIT;
+    }
+
+    if (cycles == 0)
+    {
+        metrics_add(metrics_local().faults);
+        printf("ERROR: Unimplemented opcode at PC=%04X\n", cpu.pc);
+        printf("Opcode = %02X\n", cpu.mem->read(cpu.pc));
+        return STEP_ERROR;
+    }
+    if (cpu.halted && !cpu.inte)
+        return STEP_HALT;
+    return STEP_OK;
+}
+
+// run_one() as a GdbStub exec hook, so traps work under the debugger
+struct ExecContext
+{
+    Console* con;
+    Bios* bios;
+    Hle* hle;
+    PerfProfile* perf;
+    StepResult result;
+    Rewind* rewind;
+};
+
+static int exec_step(void* ctx, CPU& cpu)
+{
+    ExecContext& x = *static_cast<ExecContext*>(ctx);
+    u64 before = cpu.cycles;
+    // an instruction run again after a rewind already printed its output
+    FILE* out = x.con->out;
+    if (x.rewind && x.rewind->replaying())
+        x.con->out = nullptr;
+    x.result = run_one(cpu, *x.con, x.bios, x.hle, x.perf);
+    x.con->out = out;
+    if (x.result == STEP_HALT)
+        x.result = STEP_OK; // the stub reports halts (and HLT breakpoints) itself
+    metrics_add_run(1, cpu.cycles - before);
+    return x.result == STEP_OK ? int(cpu.cycles - before) : 0;
+}
+
+static void report(const Pacer& p)
+{
+    const PaceStats& s = p.stats;
+    printf("[pace] %llu frames in %.2f s, busy %.1f%%, %llu overruns (worst %.2f ms late), %llu resyncs\n",
+           (unsigned long long)s.frames, s.wall_seconds,
+           s.wall_seconds > 0 ? 100.0 * s.busy_seconds / s.wall_seconds : 0.0,
+           (unsigned long long)s.overruns, s.max_lag_ns / 1e6, (unsigned long long)s.resyncs);
+}
+
+int main(int argc, char** argv)
+{
+    const char* rom = "roms/testing/CPUTEST.COM";
+    bool realtime = false;
+    PaceConfig pace;
+    static DiskImage disks[BIOS_DRIVES];
+    static DiskOverlay overlays[BIOS_DRIVES];
+    Bios bios;
+    int ndisks = 0;
+    const char* input = "";
+    const char* record_path = nullptr;
+    const char* replay_path = nullptr;
+    const char* gdb_where = nullptr;
+    bool use_rewind = false;
+    bool use_hle = false;
+    bool hle_verify = false;
+    bool use_perf = false;
+    bool perf_classes = false;
+    const char* metrics_file = nullptr;
+    int metrics_port = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--realtime"))
+            realtime = true;
+        else if (!strcmp(argv[i], "--clock") && i + 1 < argc)
+            pace.clock_hz = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "--speed") && i + 1 < argc)
+            pace.speed = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--fps") && i + 1 < argc)
+            pace.frame_hz = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--disk") && i + 1 < argc && ndisks < BIOS_DRIVES)
+        {
+            if (!disks[ndisks].open(argv[++i]))
+                return 1;
+            overlays[ndisks].attach(disks[ndisks]);
+            bios.drive[ndisks] = &overlays[ndisks];
+            ndisks++;
+        }
+        else if (!strcmp(argv[i], "--input") && i + 1 < argc)
+            input = argv[++i];
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            record_path = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (!strcmp(argv[i], "--gdb") && i + 1 < argc)
+            gdb_where = argv[++i];
+        else if (!strcmp(argv[i], "--rewind"))
+            use_rewind = true;
+        else if (!strcmp(argv[i], "--hle"))
+            use_hle = true;
+        else if (!strcmp(argv[i], "--hle-verify"))
+            use_hle = hle_verify = true;
+        else if (!strcmp(argv[i], "--perf"))
+            use_perf = true;
+        else if (!strcmp(argv[i], "--perf-classes"))
+            use_perf = perf_classes = true;
+        else if (!strcmp(argv[i], "--metrics-file") && i + 1 < argc)
+            metrics_file = argv[++i];
+        else if (!strcmp(argv[i], "--metrics-port") && i + 1 < argc)
+            metrics_port = atoi(argv[++i]);
+        else if (argv[i][0] == '-')
+        {
+            printf("Usage: %s [program.com] [--realtime] [--clock HZ] [--speed N] [--fps N] [--disk IMAGE]...\n"
+                   "       [--input TEXT] [--record LOG | --replay LOG] [--gdb PORT|HOST:PORT|SOCKET [--rewind]]\n"
+                   "       [--hle | --hle-verify] [--perf | --perf-classes]\n"
+                   "       [--metrics-file PATH] [--metrics-port PORT]\n", argv[0]);
+            return 1;
+        }
+        else
+            rom = argv[i];
+    }
+    if (pace.frame_hz == 0)
+        pace.frame_hz = 60;
+    // the history covers CPU, memory and console input, nothing else
+    if (use_rewind && (!gdb_where || record_path || replay_path || ndisks))
+    {
+        printf("--rewind needs --gdb, and works without --record, --replay and --disk\n");
+        return 1;
+    }
+
     std::cout << "CWD = " << std::filesystem::current_path() << "\n";
     Memory mem;
     mem.reset();
@@ -14,54 +193,177 @@ int main(void)
     cpu.mem = &mem;
     cpu.reset();
 
-    loadROM(&cpu, "roms/testing/CPUTEST.COM", 0x100);
+    loadROM(&cpu, rom, 0x100);
     cpu.pc = 0x100;
 
-    while (true)
+    // disks come with a BIOS; writes stay in memory
+    Bios* with_bios = nullptr;
+    if (ndisks)
     {
-        int cycles = cpu.step();
-        if ((cpu.flags.f & 0x02) == 0)
+        if (!bios_install(mem, bios))
         {
-            printf("ERROR: flag bit1 cleared at PC=%04X\n", cpu.pc);
-            exit(1);
+            printf("[BIOS] disk parameter blocks do not fit below 0x10000\n");
+            return 1;
         }
+        with_bios = &bios;
+    }
 
-        // BDOS trap
-        if (cpu.pc == 0x0005)
+    Console con;
+    con.input = (const u8*)input;
+    con.input_len = strlen(input);
+
+    // console input and IN values go through the log
+    Recorder rec;
+    Replayer rep;
+    PortTap tap;
+    if (replay_path)
+    {
+        if (!rep.load(replay_path))
+            return 1;
+        con.replay = &rep;
+        tap.attach(cpu, nullptr, &rep);
+    }
+    else if (record_path)
+    {
+        rec.begin();
+        con.record = &rec;
+        tap.attach(cpu, &rec, nullptr);
+    }
+
+    // known subroutines run natively, optionally checked against the core
+    std::unique_ptr<Hle> hle;
+    if (use_hle)
+    {
+        hle.reset(new Hle);
+        hle->verify = hle_verify;
+    }
+
+    // host counters around the loop, per emulated instruction
+    std::unique_ptr<PerfProfile> perf;
+    if (use_perf)
+    {
+        perf.reset(new PerfProfile);
+        perf->per_class = perf_classes;
+        perf->begin();
+    }
+
+    // Prometheus text for a scraper or a textfile collector during the run
+    MetricsExporter* metrics = nullptr;
+    if (metrics_file || metrics_port)
+    {
+        metrics = metrics_export_start(metrics_file, metrics_port);
+        if (!metrics)
+            return 1;
+    }
+
+    StepResult r = STEP_OK;
+    if (gdb_where)
+    {
+        // the debugger drives until it detaches; then the run goes on below
+        GdbStub gdb;
+        ExecContext x{&con, with_bios, hle.get(), perf.get(), STEP_OK, nullptr};
+        gdb.cpu = &cpu;
+        gdb.exec = exec_step;
+        gdb.exec_ctx = &x;
+
+        // history for reverse-step and reverse-continue
+        std::unique_ptr<Rewind> rewind;
+        if (use_rewind)
         {
-            if (cpu.c == 9)
-            {
-                // print string
-                u16 addr = cpu.DE();
-                char ch;
-                while ((ch = cpu.mem->read(addr++)) != '$')
-                    putchar(ch);
-            }
-            else if (cpu.c == 2)
-            {
-                // print char
-                putchar(cpu.e);
-            }
-            else if (cpu.c == 0)
+            rewind.reset(new Rewind);
+            rewind->exec = exec_step;
+            rewind->exec_ctx = &x;
+            rewind->cursor = &con.input_pos;
+            rewind->attach(cpu);
+            x.rewind = gdb.rewind = rewind.get();
+        }
+        if (!gdb_listen(gdb, gdb_where))
+            return 1;
+        bool detached = gdb_serve(gdb);
+        gdb_close(gdb);
+
+        // detached back in time: what follows up to where the program had
+        // got has printed already
+        while (detached && rewind && x.result == STEP_OK && cpu.cycles < rewind->frontier)
+            exec_step(&x, cpu);
+        r = detached || x.result != STEP_OK ? x.result : STEP_EXIT;
+    }
+
+    if (realtime)
+    {
+        // one frame of emulated cycles, then sleep until its deadline
+        Pacer pacer{pace};
+        pacer.start(cpu.cycles);
+        while (r == STEP_OK)
+        {
+            u64 target = pacer.frame_target();
+            u64 start = cpu.cycles, n = 0;
+            for (; r == STEP_OK && cpu.cycles < target; n++)
+                r = run_one(cpu, con, with_bios, hle.get(), perf.get());
+            metrics_add_run(n, cpu.cycles - start);
+            pacer.end_frame(cpu.cycles);
+        }
+        report(pacer);
+    }
+    else
+    {
+        // counted per batch, not per instruction
+        u64 start = cpu.cycles, n = 0;
+        while (r == STEP_OK)
+        {
+            r = run_one(cpu, con, with_bios, hle.get(), perf.get());
+            if (++n == 65536)
             {
-                // PROGRAM TERMINATION
-                printf("\n[BDOS] Program terminated\n");
-                return 0; // or set cpu.halted = true;
+                metrics_add_run(n, cpu.cycles - start);
+                start = cpu.cycles;
+                n = 0;
             }
-
-            // simulate RET
-            cpu.pc = cpu.mem->read(cpu.sp) | (cpu.mem->read(cpu.sp + 1) << 8);
-            cpu.sp += 2;
         }
+        metrics_add_run(n, cpu.cycles - start);
+    }
+    metrics_export_stop(metrics);
+    if (r == STEP_HALT)
+        printf("\n[CPU] HLT with interrupts disabled at PC=%04X, stopping\n", u16(cpu.pc - 1));
 
-        if (cycles == 0)
+    if (perf)
+    {
+        perf->end();
+        perf_report(*perf, stdout);
+    }
+
+    if (hle)
+    {
+        int n;
+        const HleRoutine* routines = hle_registry(&n);
+        for (int i = 0; i < n; i++)
         {
-            printf("ERROR: Unimplemented opcode at PC=%04X\n", cpu.pc);
-            printf("Opcode = %02X\n", cpu.mem->read(cpu.pc));
-            break;
+            const HleStats& s = hle->stats[i];
+            if (s.calls || s.verified)
+                printf("[hle] %-26s %10llu calls, %5.1f%% of cycles, %llu verified, %llu mismatches\n",
+                       routines[i].name, (unsigned long long)s.calls,
+                       cpu.cycles ? 100.0 * s.cycles / cpu.cycles : 0.0, (unsigned long long)s.verified,
+                       (unsigned long long)s.mismatches);
         }
     }
 
-    std::cout << "Finished\n";
+    if (record_path && !replay_path)
+    {
+        rec.save(record_path);
+        printf("[record] %llu events, %zu bytes, %llu cycles\n", (unsigned long long)rec.events, rec.log.size() + 1,
+               (unsigned long long)cpu.cycles);
+    }
+    if (replay_path)
+    {
+        if (rep.diverged)
+            printf("[replay] DIVERGED at cycle %llu\n", (unsigned long long)rep.diverged_at);
+        else if (!rep.done())
+            printf("[replay] run ended with events left in the log\n");
+        else
+            printf("[replay] %llu events matched, %llu cycles\n", (unsigned long long)rep.events,
+                   (unsigned long long)cpu.cycles);
+    }
+
+    if (r == STEP_ERROR)
+        std::cout << "Finished\n";
     return 0;
 }
@@ -0,0 +1,247 @@
+#include "memo/memo.h"
+#include "bulk/bulk.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static u64 digest64(const u8* p, size_t n, u64 seed) {
+    size_t body = n & ~size_t(63);
+    u64 h = body ? bulk_hash(p, body, seed) : seed;
+    u8 tail[64] = {};
+    memcpy(tail, p + body, n - body);
+    return bulk_hash(tail, sizeof(tail), h ^ n);
+}
+
+MemoKey memo_digest(const void* data, size_t n) {
+    const u8* p = (const u8*)data;
+    return MemoKey{digest64(p, n, 0x243F6A8885A308D3ull), digest64(p, n, 0x13198A2E03707344ull)};
+}
+
+MemoKey memo_key(const MemoKey& rom, u16 load, u16 entry, const void* input, size_t input_len, u64 max_cycles) {
+    MemoKey in = memo_digest(input, input_len);
+    u64 fields[8] = {rom.lo, rom.hi, in.lo, in.hi, input_len, max_cycles, u64(load) << 16 | entry, 1};
+    return memo_digest(fields, sizeof(fields));
+}
+
+u64 memo_state_digest(CPU& cpu) {
+    u64 h = cpu.mem->hash();
+    auto mix = [&](u64 v) {
+        h = (h ^ v) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 29;
+    };
+    mix(cpu.bc), mix(cpu.de), mix(cpu.hl), mix(cpu.psw);
+    mix(cpu.sp), mix(cpu.pc), mix(cpu.inte), mix(cpu.halted), mix(cpu.cycles);
+    return h;
+}
+
+// File layout: header page, slot table, output area. Geometry follows
+// from the file size alone.
+static constexpr char MAGIC[8] = {'E', 'M', 'U', 'M', 'E', 'M', 'O', '2'};
+static constexpr size_t HEADER = 4096;
+static constexpr size_t MIN_BYTES = 1 << 20;
+
+struct FileHeader {
+    char magic[8];
+    MemoKey build; // build_stamp() of the program that wrote the results
+    u64 size;
+    u64 slots;
+    u64 entries;
+    u64 output_used;
+    u64 resets;
+};
+
+struct Slot {
+    MemoKey key;
+    u64 instructions, cycles, state;
+    u64 output_at;
+    u32 output_len;
+    // Odd while the fields are being written, so an entry a crash
+    // interrupted reads as a miss. used stays set once the key is in,
+    // keeping the probe runs through the slot intact either way.
+    u32 seq;
+    u8 status;
+    u8 used;
+};
+
+// Results are only as good as the emulator that produced them, so they
+// are tied to the executable: a digest of its image, which any rebuild of
+// the core changes. Where it cannot be read, the compile time of this file
+// stands in.
+static MemoKey build_stamp() {
+    static const MemoKey stamp = [] {
+        std::string image;
+        int fd = open("/proc/self/exe", O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            char buf[1 << 16];
+            for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;)
+                image.append(buf, size_t(n));
+            close(fd);
+        }
+        if (image.empty())
+            image = __DATE__ " " __TIME__;
+        return memo_digest(image.data(), image.size());
+    }();
+    return stamp;
+}
+
+// A power of two, with the table about an eighth of the file.
+static u64 slots_for(size_t bytes) {
+    u64 n = 1024;
+    while (n * 2 * sizeof(Slot) <= bytes / 8)
+        n *= 2;
+    return n;
+}
+
+struct MemoCache {
+    int fd;
+    u8* base;
+    size_t bytes;
+    FileHeader* head;
+    Slot* slot;
+    u64 mask;
+    u8* output;
+    u64 output_size;
+
+    std::mutex mu;
+    u64 hits = 0, misses = 0, stored = 0;
+};
+
+static void start_over(MemoCache* c) {
+    memset(c->slot, 0, c->head->slots * sizeof(Slot));
+    c->head->entries = 0;
+    c->head->output_used = 0;
+}
+
+MemoCache* memo_open(const char* path, size_t bytes) {
+    if (bytes < MIN_BYTES)
+        bytes = MIN_BYTES;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        perror(path);
+        return nullptr;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "%s: in use by another process\n", path);
+        close(fd);
+        return nullptr;
+    }
+
+    struct stat st;
+    FileHeader old{};
+    bool keep = fstat(fd, &st) == 0 && size_t(st.st_size) == bytes &&
+                pread(fd, &old, sizeof(old), 0) == ssize_t(sizeof(old)) && !memcmp(old.magic, MAGIC, 8) &&
+                old.build == build_stamp() && old.size == bytes && old.slots == slots_for(bytes) && old.entries <= old.slots &&
+                old.output_used <= bytes - HEADER - old.slots * sizeof(Slot);
+    if (!keep && (ftruncate(fd, 0) != 0 || ftruncate(fd, off_t(bytes)) != 0)) {
+        perror(path);
+        close(fd);
+        return nullptr;
+    }
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        perror(path);
+        close(fd);
+        return nullptr;
+    }
+
+    MemoCache* c = new MemoCache;
+    c->fd = fd;
+    c->base = (u8*)p;
+    c->bytes = bytes;
+    c->head = (FileHeader*)p;
+    u64 slots = slots_for(bytes);
+    c->slot = (Slot*)(c->base + HEADER);
+    c->mask = slots - 1;
+    c->output = c->base + HEADER + slots * sizeof(Slot);
+    c->output_size = bytes - HEADER - slots * sizeof(Slot);
+    if (!keep) {
+        // the file is all zeroes: an empty table
+        c->head->build = build_stamp();
+        c->head->size = bytes;
+        c->head->slots = slots;
+        memcpy(c->head->magic, MAGIC, 8);
+    }
+    return c;
+}
+
+void memo_close(MemoCache* c) {
+    if (!c)
+        return;
+    munmap(c->base, c->bytes);
+    close(c->fd); // drops the lock
+    delete c;
+}
+
+// The slot holding key, or the empty one where it would go.
+static Slot* find(MemoCache* c, const MemoKey& key) {
+    for (u64 i = key.lo & c->mask;; i = (i + 1) & c->mask) {
+        Slot* s = &c->slot[i];
+        if (!s->used || s->key == key)
+            return s;
+    }
+}
+
+bool memo_lookup(MemoCache* c, const MemoKey& key, MemoResult& out) {
+    std::lock_guard<std::mutex> lock(c->mu);
+    Slot* s = find(c, key);
+    // an output outside the used area means the file was damaged
+    if (!s->used || (s->seq & 1) || s->output_at + s->output_len > c->head->output_used) {
+        c->misses++;
+        return false;
+    }
+    out.status = s->status;
+    out.instructions = s->instructions;
+    out.cycles = s->cycles;
+    out.state = s->state;
+    out.output.assign((const char*)c->output + s->output_at, s->output_len);
+    c->hits++;
+    return true;
+}
+
+void memo_store(MemoCache* c, const MemoKey& key, const MemoResult& r) {
+    if (r.output.size() > c->output_size / 4)
+        return; // would crowd out everything else
+    std::lock_guard<std::mutex> lock(c->mu);
+    Slot* s = find(c, key);
+    bool fresh = !s->used;
+    bool full = c->head->output_used + r.output.size() > c->output_size ||
+                (fresh && (c->head->entries + 1) * 2 > c->mask + 1);
+    if (full) {
+        start_over(c);
+        c->head->resets++;
+        s = find(c, key);
+        fresh = true;
+    }
+
+    s->seq |= 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (fresh) {
+        s->key = key;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        s->used = 1;
+        c->head->entries++;
+    }
+    memcpy(c->output + c->head->output_used, r.output.data(), r.output.size());
+    s->instructions = r.instructions;
+    s->cycles = r.cycles;
+    s->state = r.state;
+    s->output_at = c->head->output_used;
+    s->output_len = u32(r.output.size());
+    s->status = r.status;
+    c->head->output_used += r.output.size();
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    s->seq++;
+    c->stored++;
+}
+
+MemoStats memo_stats(MemoCache* c) {
+    std::lock_guard<std::mutex> lock(c->mu);
+    return MemoStats{c->head->entries, c->head->output_used, c->hits, c->misses, c->stored, c->head->resets};
+}
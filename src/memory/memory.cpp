@@ -1,14 +1,71 @@
 #include "memory/memory.h"
-#include <cstring>
+#include "bulk/bulk.h"
 
-u8 Memory::read(u16 addr){
-    return data[addr];
+void Memory::reset(){
+    bulk_clear(data,sizeof(data));
+    clear_dirty();
+    for (int w = 0; w < 4; w++)
+        unhashed[w] = ~0ull;
+    nhits = 0;
 };
 
-void Memory::write(u16 addr,u8 value){
-    data[addr]=value;
-};
+// Order matters: swapping two subtrees changes the parent.
+static inline u64 combine(u64 l, u64 r) {
+    u64 h = l * 0x9E3779B97F4A7C15ull ^ (r + 0xC2B2AE3D27D4EB4Full);
+    h ^= h >> 32;
+    h *= 0xD6E8FEB86659FD93ull;
+    return h ^ h >> 32;
+}
 
-void Memory::reset(){
-    std::memset(data,0,sizeof(data));
-};
\ No newline at end of file
+u64 Memory::hash() {
+    u64 stale[4], any = 0;
+    for (int w = 0; w < 4; w++) {
+        stale[w] = unhashed[w] | dirty[w];
+        dirty_held[w] |= dirty[w];
+        dirty[w] = unhashed[w] = 0;
+        any |= stale[w];
+    }
+    if (!any)
+        return tree[1];
+
+    // the stale leaves, then their parents a level at a time; the list
+    // stays sorted, so a parent shared by two children is adjacent
+    u16 nodes[128];
+    int n = 0;
+    u64 (*leaf)(const void*, size_t, u64) = bulk().hash;
+    for (int w = 0; w < 4; w++)
+        for (u64 bits = stale[w]; bits; bits &= bits - 1) {
+            int page = w * 64 + __builtin_ctzll(bits);
+            tree[256 + page] = leaf(data + page * 256, 256, 0);
+            if (n == 0 || nodes[n - 1] != (256 + page) >> 1)
+                nodes[n++] = u16((256 + page) >> 1);
+        }
+    while (n) {
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            int node = nodes[i];
+            tree[node] = combine(tree[2 * node], tree[2 * node + 1]);
+            if (node > 1 && (m == 0 || nodes[m - 1] != node >> 1))
+                nodes[m++] = u16(node >> 1);
+        }
+        n = m;
+    }
+    return tree[1];
+}
+
+static int diff(const Memory& a, const Memory& b, int node, u64* bits) {
+    if (a.tree[node] == b.tree[node])
+        return 0;
+    if (node >= 256) {
+        bits[(node - 256) >> 6] |= 1ull << (node & 63);
+        return 1;
+    }
+    return diff(a, b, 2 * node, bits) + diff(a, b, 2 * node + 1, bits);
+}
+
+int memory_diff(Memory& a, Memory& b, u64 bits[4]) {
+    bits[0] = bits[1] = bits[2] = bits[3] = 0;
+    a.hash();
+    b.hash();
+    return diff(a, b, 1, bits);
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "memory/pages.h"
+#include <cstring>
+
+static size_t slot_of(u64 h, size_t mask) {
+    return size_t(h ^ h >> 29) & mask;
+}
+
+static void grow(PageStore& s) {
+    std::vector<u32> old;
+    old.swap(s.table);
+    s.table.assign(old.empty() ? 1024 : old.size() * 2, 0);
+    size_t mask = s.table.size() - 1;
+    for (u32 e : old)
+        if (e) {
+            size_t i = slot_of(s.hashes[e - 1], mask);
+            while (s.table[i])
+                i = (i + 1) & mask;
+            s.table[i] = e;
+        }
+}
+
+u32 PageStore::put(const u8* page, u64 h) {
+    if ((used + 1) * 2 > table.size())
+        grow(*this);
+    size_t mask = table.size() - 1, i = slot_of(h, mask);
+    for (; table[i]; i = (i + 1) & mask) {
+        u32 id = table[i] - 1;
+        if (hashes[id] == h && memcmp(get(id), page, 256) == 0) {
+            refs[id]++;
+            return id;
+        }
+    }
+
+    u32 id;
+    if (!free.empty()) {
+        id = free.back();
+        free.pop_back();
+        hashes[id] = h;
+        refs[id] = 1;
+    } else {
+        id = u32(hashes.size());
+        if (id % BLOCK == 0)
+            blocks.emplace_back(new u8[BLOCK * 256]);
+        hashes.push_back(h);
+        refs.push_back(1);
+    }
+    memcpy(blocks[id / BLOCK].get() + id % BLOCK * 256, page, 256);
+    table[i] = id + 1;
+    used++;
+    return id;
+}
+
+void PageStore::release(u32 id) {
+    if (--refs[id])
+        return;
+    free.push_back(id);
+
+    // take it out of the table, moving up later entries of its probe run
+    size_t mask = table.size() - 1, i = slot_of(hashes[id], mask);
+    while (table[i] != id + 1)
+        i = (i + 1) & mask;
+    for (size_t j = (i + 1) & mask; table[j]; j = (j + 1) & mask) {
+        size_t home = slot_of(hashes[table[j] - 1], mask);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            table[i] = table[j];
+            i = j;
+        }
+    }
+    table[i] = 0;
+    used--;
+}
+
+size_t PageStore::bytes() const {
+    return blocks.size() * BLOCK * 256 + hashes.size() * (sizeof(u64) + sizeof(u32)) +
+           free.size() * sizeof(u32) + table.size() * sizeof(u32);
+}
+
+void snapshot_take(PageStore& s, Memory& mem, MemorySnapshot& snap) {
+    snap.root = mem.hash();
+    for (int p = 0; p < 256; p++)
+        snap.page[p] = s.put(mem.data + p * 256, mem.tree[256 + p]);
+}
+
+int snapshot_restore(const PageStore& s, const MemorySnapshot& snap, Memory& mem) {
+    if (mem.hash() == snap.root)
+        return 0;
+    int n = 0;
+    for (int p = 0; p < 256; p++)
+        if (mem.tree[256 + p] != s.hash_of(snap.page[p])) {
+            memcpy(mem.data + p * 256, s.get(snap.page[p]), 256);
+            mem.mark_written(p * 256, 256);
+            n++;
+        }
+    return n;
+}
+
+void snapshot_release(PageStore& s, MemorySnapshot& snap) {
+    for (int p = 0; p < 256; p++)
+        s.release(snap.page[p]);
+}
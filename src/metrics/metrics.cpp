@@ -0,0 +1,258 @@
+#include "metrics/metrics.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// Pushed once per thread, never removed.
+static std::atomic<MetricsShard*> shards{nullptr};
+
+static const auto process_start = std::chrono::steady_clock::now();
+
+__thread MetricsShard* metrics_shard = nullptr;
+
+MetricsShard& metrics_register() {
+    MetricsShard* s = new MetricsShard;
+    MetricsShard* head = shards.load(std::memory_order_relaxed);
+    do
+        s->next = head;
+    while (!shards.compare_exchange_weak(head, s, std::memory_order_release, std::memory_order_relaxed));
+    metrics_shard = s;
+    return *s;
+}
+
+void metrics_sum(MetricsTotals& t) {
+    memset(&t, 0, sizeof(t));
+    auto get = [](const std::atomic<u64>& c) { return c.load(std::memory_order_relaxed); };
+    for (MetricsShard* s = shards.load(std::memory_order_acquire); s; s = s->next) {
+        t.instructions += get(s->instructions);
+        t.cycles += get(s->cycles);
+        t.halt_cycles += get(s->halt_cycles);
+        t.faults += get(s->faults);
+        t.bios += get(s->bios);
+        for (int f = 0; f < 64; f++)
+            t.bdos[f] += get(s->bdos[f]);
+        for (int p = 0; p < 256; p++) {
+            t.port_in[p] += get(s->port_in[p]);
+            t.port_out[p] += get(s->port_out[p]);
+        }
+    }
+}
+
+static void family(std::string& out, const char* name, const char* type, const char* help) {
+    char line[256];
+    snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    out += line;
+}
+
+static void sample(std::string& out, const char* name, const char* labels, double v) {
+    char line[256];
+    snprintf(line, sizeof(line), "%s%s %.9g\n", name, labels, v);
+    out += line;
+}
+
+static void sample(std::string& out, const char* name, const char* labels, u64 v) {
+    char line[256];
+    snprintf(line, sizeof(line), "%s%s %llu\n", name, labels, (unsigned long long)v);
+    out += line;
+}
+
+void metrics_format(const MetricsTotals& t, double mips, double uptime, std::string& out) {
+    char labels[64];
+    family(out, "emu_instructions_total", "counter", "Emulated instructions executed.");
+    sample(out, "emu_instructions_total", "", t.instructions);
+    family(out, "emu_cycles_total", "counter", "Emulated 8080 cycles executed.");
+    sample(out, "emu_cycles_total", "", t.cycles);
+    family(out, "emu_mips", "gauge", "Emulated instructions per second over the last interval, in millions.");
+    sample(out, "emu_mips", "", mips);
+    family(out, "emu_halt_cycles_total", "counter", "Emulated cycles spent halted.");
+    sample(out, "emu_halt_cycles_total", "", t.halt_cycles);
+    family(out, "emu_unimplemented_opcodes_total", "counter", "Instructions the core had no handler for.");
+    sample(out, "emu_unimplemented_opcodes_total", "", t.faults);
+
+    family(out, "emu_bdos_calls_total", "counter", "BDOS traps handled, by function number.");
+    for (int f = 0; f < 64; f++)
+        if (t.bdos[f]) {
+            snprintf(labels, sizeof(labels), f < 63 ? "{function=\"%d\"}" : "{function=\"other\"}", f);
+            sample(out, "emu_bdos_calls_total", labels, t.bdos[f]);
+        }
+    family(out, "emu_bios_calls_total", "counter", "BIOS jump table traps handled.");
+    sample(out, "emu_bios_calls_total", "", t.bios);
+
+    family(out, "emu_port_reads_total", "counter", "IN instructions, by port.");
+    for (int p = 0; p < 256; p++)
+        if (t.port_in[p]) {
+            snprintf(labels, sizeof(labels), "{port=\"0x%02X\"}", p);
+            sample(out, "emu_port_reads_total", labels, t.port_in[p]);
+        }
+    family(out, "emu_port_writes_total", "counter", "OUT instructions, by port.");
+    for (int p = 0; p < 256; p++)
+        if (t.port_out[p]) {
+            snprintf(labels, sizeof(labels), "{port=\"0x%02X\"}", p);
+            sample(out, "emu_port_writes_total", labels, t.port_out[p]);
+        }
+
+    family(out, "emu_uptime_seconds", "gauge", "Seconds since the process started.");
+    sample(out, "emu_uptime_seconds", "", uptime);
+}
+
+struct MetricsExporter {
+    std::string file;
+    double interval;
+    int listen_fd = -1;
+    int wake[2] = {-1, -1};
+    std::thread thread;
+
+    // MIPS between two renders; the exporter thread only
+    u64 last_instructions = 0;
+    std::chrono::steady_clock::time_point last = process_start;
+    double mips = 0;
+};
+
+static double seconds(std::chrono::steady_clock::duration d) {
+    return std::chrono::duration<double>(d).count();
+}
+
+static void render(MetricsExporter* e, std::string& out, bool last = false) {
+    MetricsTotals t;
+    metrics_sum(t);
+    auto now = std::chrono::steady_clock::now();
+    double dt = seconds(now - e->last);
+    if (dt >= 0.1 || (last && dt > 0)) { // back-to-back scrapes keep the last rate
+        e->mips = (t.instructions - e->last_instructions) / dt / 1e6;
+        e->last_instructions = t.instructions;
+        e->last = now;
+    }
+    metrics_format(t, e->mips, seconds(now - process_start), out);
+}
+
+static void write_file(MetricsExporter* e, bool last = false) {
+    std::string text;
+    render(e, text, last);
+    std::string tmp = e->file + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f)
+        return;
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = fclose(f) == 0 && ok;
+    if (ok)
+        rename(tmp.c_str(), e->file.c_str());
+    else
+        unlink(tmp.c_str());
+}
+
+static void send_all(int fd, const std::string& s) {
+    for (size_t done = 0; done < s.size();) {
+        ssize_t n = send(fd, s.data() + done, s.size() - done, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        done += n;
+    }
+}
+
+// One request per connection, answered and closed.
+static void serve_one(MetricsExporter* e) {
+    int fd = accept(e->listen_fd, nullptr, nullptr);
+    if (fd < 0)
+        return;
+    timeval tv{1, 0}; // a client that never sends does not hold the thread
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    std::string req;
+    char buf[1024];
+    while (req.find("\r\n\r\n") == std::string::npos && req.size() < 8192) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+            break;
+        req.append(buf, n);
+    }
+
+    std::string body, reply;
+    if (!req.compare(0, 13, "GET /metrics ") || !req.compare(0, 6, "GET / ")) {
+        render(e, body);
+        reply = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n";
+    } else {
+        body = "not found\n";
+        reply = "HTTP/1.1 404 Not Found\r\nContent-Type: text/plain\r\n";
+    }
+    reply += "Content-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    send_all(fd, reply);
+    close(fd);
+}
+
+static void exporter_main(MetricsExporter* e) {
+    auto next_write = std::chrono::steady_clock::now();
+    for (;;) {
+        int timeout = -1;
+        if (!e->file.empty()) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= next_write) {
+                write_file(e);
+                next_write = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                       std::chrono::duration<double>(e->interval));
+            }
+            timeout = int(seconds(next_write - now) * 1000) + 1;
+        }
+        pollfd fds[2] = {{e->wake[0], POLLIN, 0}, {e->listen_fd, POLLIN, 0}};
+        if (poll(fds, e->listen_fd >= 0 ? 2 : 1, timeout) < 0)
+            continue;
+        if (fds[0].revents)
+            return;
+        if (e->listen_fd >= 0 && (fds[1].revents & POLLIN))
+            serve_one(e);
+    }
+}
+
+MetricsExporter* metrics_export_start(const char* file, int port, double interval) {
+    MetricsExporter* e = new MetricsExporter;
+    e->file = file ? file : "";
+    e->interval = interval > 0 ? interval : 5;
+    if (port) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(u16(port));
+        int one = 1;
+        e->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (e->listen_fd < 0 || setsockopt(e->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+            bind(e->listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(e->listen_fd, 16) < 0) {
+            perror("metrics endpoint");
+            if (e->listen_fd >= 0)
+                close(e->listen_fd);
+            delete e;
+            return nullptr;
+        }
+    }
+    if (pipe(e->wake) != 0) {
+        perror("metrics");
+        if (e->listen_fd >= 0)
+            close(e->listen_fd);
+        delete e;
+        return nullptr;
+    }
+    e->thread = std::thread(exporter_main, e);
+    return e;
+}
+
+void metrics_export_stop(MetricsExporter* e) {
+    if (!e)
+        return;
+    char c = 0;
+    ssize_t r = write(e->wake[1], &c, 1);
+    (void)r;
+    e->thread.join();
+    if (!e->file.empty())
+        write_file(e, true);
+    if (e->listen_fd >= 0)
+        close(e->listen_fd);
+    close(e->wake[0]);
+    close(e->wake[1]);
+    delete e;
+}
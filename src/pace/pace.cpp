@@ -0,0 +1,65 @@
+#include "pace/pace.h"
+#include <ctime>
+
+u64 monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return u64(ts.tv_sec) * 1000000000ull + u64(ts.tv_nsec);
+}
+
+static void sleep_until(u64 ns) {
+    timespec ts;
+    ts.tv_sec = time_t(ns / 1000000000ull);
+    ts.tv_nsec = long(ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) != 0) {
+        // EINTR: sleep again towards the same deadline
+    }
+}
+
+void Pacer::start(u64 cycles) {
+    stats = PaceStats{};
+    start_ns = monotonic_ns();
+    begin_ns = start_ns;
+    busy_from = start_ns;
+    base_cycle = cycles;
+    frame = 0;
+}
+
+u64 Pacer::frame_target() const {
+    if (cfg.speed <= 0)
+        return base_cycle + (frame + 1) * (cfg.clock_hz / cfg.frame_hz);
+    // computed from the frame number so fractional cycles per frame add up
+    double per_frame = double(cfg.clock_hz) * cfg.speed / cfg.frame_hz;
+    return base_cycle + u64(double(frame + 1) * per_frame);
+}
+
+void Pacer::end_frame(u64 cycles) {
+    u64 now = monotonic_ns();
+    stats.busy_seconds += (now - busy_from) * 1e-9;
+    stats.frames++;
+    frame++;
+
+    if (cfg.speed > 0) {
+        u64 period = 1000000000ull / cfg.frame_hz;
+        u64 deadline = start_ns + frame * period;
+        if (now > deadline) {
+            u64 lag = now - deadline;
+            stats.overruns++;
+            if (lag > stats.max_lag_ns)
+                stats.max_lag_ns = lag;
+            if (lag > cfg.max_lag_frames * period) {
+                // too far behind to catch up smoothly: restart the schedule
+                stats.resyncs++;
+                start_ns = now;
+                base_cycle = cycles;
+                frame = 0;
+            }
+        } else {
+            sleep_until(deadline);
+            now = monotonic_ns();
+        }
+    }
+
+    busy_from = now;
+    stats.wall_seconds = (now - begin_ns) * 1e-9;
+}
@@ -0,0 +1,250 @@
+#include "perf/perf.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+static const char* const event_names[PERF_EVENTS] = {
+    "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses",
+};
+
+const char* perf_event_name(int e) { return event_names[e]; }
+
+const char* op_class_name(int c) {
+    static const char* const names[OPC_CLASSES] = {"move", "ALU", "memory", "stack", "branch", "other"};
+    return names[c];
+}
+
+// Stand-in for host cycles when there is no cycle counter.
+static u64 host_ticks() {
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+                   .count());
+#endif
+}
+
+static const char* ticks_name() {
+#if defined(__x86_64__)
+    return "tsc";
+#else
+    return "ns";
+#endif
+}
+
+PerfCounters::PerfCounters() {
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        fd[e] = -1;
+        page[e] = nullptr;
+    }
+}
+
+PerfCounters::~PerfCounters() { close(); }
+
+#if defined(__linux__)
+
+static const struct {
+    u32 type;
+    u64 config;
+} event_attrs[PERF_EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                             PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                             PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+};
+
+bool PerfCounters::open() {
+    close();
+    long page_size = sysconf(_SC_PAGESIZE);
+    int opened = 0, user_readable = 0;
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = event_attrs[e].type;
+        attr.config = event_attrs[e].config;
+        attr.exclude_kernel = 1; // allowed at perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        fd[e] = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (fd[e] < 0)
+            continue;
+        opened++;
+        void* p = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fd[e], 0);
+        page[e] = p == MAP_FAILED ? nullptr : p;
+        if (page[e] && static_cast<perf_event_mmap_page*>(page[e])->cap_user_rdpmc)
+            user_readable++;
+    }
+#if defined(__x86_64__)
+    rdpmc = opened && user_readable == opened;
+#endif
+    tsc_cycles = fd[PERF_CYCLES] < 0;
+    return opened > 0;
+}
+
+void PerfCounters::close() {
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        if (page[e])
+            munmap(page[e], page_size);
+        if (fd[e] >= 0)
+            ::close(fd[e]);
+        fd[e] = -1;
+        page[e] = nullptr;
+    }
+    rdpmc = false;
+}
+
+// Count scaled up for the time the event was not on a hardware counter.
+static u64 read_fd(int fd) {
+    u64 v[3];
+    if (::read(fd, v, sizeof(v)) != sizeof(v))
+        return 0;
+    if (v[2] && v[2] < v[1])
+        return u64(double(v[0]) * v[1] / v[2]);
+    return v[0];
+}
+
+// The self-monitoring sequence from perf_event.h: retry while the kernel
+// updates the page; index 0 means the event is not on a counter right now.
+static bool read_pmc(const void* page, u64* out) {
+#if defined(__x86_64__)
+    auto* pg = static_cast<const volatile perf_event_mmap_page*>(page);
+    u32 seq;
+    u64 count;
+    do {
+        seq = pg->lock;
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+        u32 index = pg->index;
+        if (!index)
+            return false;
+        int width = pg->pmc_width;
+        int64_t pmc = int64_t(__rdpmc(int(index - 1)) << (64 - width)) >> (64 - width);
+        count = pg->offset + u64(pmc);
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    } while (pg->lock != seq);
+    *out = count;
+    return true;
+#else
+    (void)page;
+    (void)out;
+    return false;
+#endif
+}
+
+void PerfCounters::read(u64 out[PERF_EVENTS]) const {
+    for (int e = 0; e < PERF_EVENTS; e++)
+        out[e] = fd[e] >= 0 ? read_fd(fd[e]) : 0;
+    if (tsc_cycles)
+        out[PERF_CYCLES] = host_ticks();
+}
+
+void PerfCounters::read_fast(u64 out[PERF_EVENTS]) const {
+    if (!rdpmc) {
+        memset(out, 0, sizeof(u64) * PERF_EVENTS);
+        out[PERF_CYCLES] = host_ticks();
+        return;
+    }
+    for (int e = 0; e < PERF_EVENTS; e++)
+        if (fd[e] < 0 || !read_pmc(page[e], &out[e]))
+            out[e] = fd[e] >= 0 ? read_fd(fd[e]) : 0;
+    if (tsc_cycles)
+        out[PERF_CYCLES] = host_ticks();
+}
+
+#else
+
+bool PerfCounters::open() {
+    tsc_cycles = true;
+    return false;
+}
+
+void PerfCounters::close() {}
+
+void PerfCounters::read(u64 out[PERF_EVENTS]) const {
+    memset(out, 0, sizeof(u64) * PERF_EVENTS);
+    out[PERF_CYCLES] = host_ticks();
+}
+
+void PerfCounters::read_fast(u64 out[PERF_EVENTS]) const { read(out); }
+
+#endif
+
+void PerfProfile::begin() {
+    counters.open();
+    // cheapest of many back-to-back reads: what one sample costs itself
+    for (int e = 0; e < PERF_EVENTS; e++)
+        overhead[e] = ~0ull;
+    for (int i = 0; i < 1000; i++) {
+        u64 a[PERF_EVENTS], b[PERF_EVENTS];
+        counters.read_fast(a);
+        counters.read_fast(b);
+        for (int e = 0; e < PERF_EVENTS; e++)
+            overhead[e] = std::min(overhead[e], b[e] - a[e]);
+    }
+    counters.read(started);
+}
+
+void PerfProfile::end() {
+    u64 now[PERF_EVENTS];
+    counters.read(now);
+    for (int e = 0; e < PERF_EVENTS; e++)
+        total[e] += now[e] - started[e];
+}
+
+void perf_report(const PerfProfile& p, FILE* out) {
+    const PerfCounters& pc = p.counters;
+    u64 insns = 0;
+    for (int c = 0; c < OPC_CLASSES; c++)
+        insns += p.insns[c];
+    fprintf(out, "[perf] %llu emulated instructions; host events per emulated instruction:\n",
+            (unsigned long long)insns);
+    fprintf(out, "[perf]  ");
+    for (int e = 0; e < PERF_EVENTS; e++) {
+        const char* name = e == PERF_CYCLES && pc.tsc_cycles ? ticks_name() : perf_event_name(e);
+        if (pc.available(e))
+            fprintf(out, " %s %.3f", name, insns ? double(p.total[e]) / insns : 0.0);
+        else
+            fprintf(out, " %s n/a", name);
+    }
+    fprintf(out, "\n");
+    if (pc.available(PERF_INSTRUCTIONS) && !pc.tsc_cycles && p.total[PERF_CYCLES])
+        fprintf(out, "[perf]   host IPC %.2f\n", double(p.total[PERF_INSTRUCTIONS]) / p.total[PERF_CYCLES]);
+    if (!pc.available(PERF_INSTRUCTIONS))
+        fprintf(out, "[perf]   no hardware counters here (perf_event_paranoid, VM or no PMU); %s only\n",
+                pc.tsc_cycles ? ticks_name() : "cycles");
+    if (!p.per_class)
+        return;
+
+    // per class: rdpmc gives every open event, otherwise only host ticks
+    int columns[PERF_EVENTS], n = 0;
+    for (int e = 0; e < PERF_EVENTS; e++)
+        if (e == PERF_CYCLES || (pc.rdpmc && pc.available(e)))
+            columns[n++] = e;
+    const char* cycles_name = pc.rdpmc && !pc.tsc_cycles ? "cycles" : ticks_name();
+    fprintf(out, "[perf] by opcode class, per instruction, less the %llu %s of a read:\n",
+            (unsigned long long)p.overhead[PERF_CYCLES], cycles_name);
+    fprintf(out, "[perf]   %-8s %6s", "class", "share");
+    for (int i = 0; i < n; i++)
+        fprintf(out, " %14s", columns[i] == PERF_CYCLES ? cycles_name : perf_event_name(columns[i]));
+    fprintf(out, "\n");
+    for (int c = 0; c < OPC_CLASSES; c++) {
+        fprintf(out, "[perf]   %-8s %5.1f%%", op_class_name(c), insns ? 100.0 * p.insns[c] / insns : 0.0);
+        for (int i = 0; i < n; i++)
+            fprintf(out, " %14.3f", p.insns[c] ? double(p.by_class[c][columns[i]]) / p.insns[c] : 0.0);
+        fprintf(out, "\n");
+    }
+}
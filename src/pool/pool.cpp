@@ -0,0 +1,255 @@
+#include "pool/pool.h"
+#include "bulk/bulk.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Instances are carved from chunks of page-aligned slots; a slot's tail
+// pages stay untouched until a program writes there.
+static constexpr size_t SLOT = (sizeof(Instance) + 4095) & ~size_t(4095);
+static constexpr size_t CHUNK_SLOTS = 16;
+static constexpr int MAX_NODES = 1024;
+
+struct NumaNode {
+    int id;
+    std::vector<int> cpus;
+};
+
+// "0-3,8,10-11" -> 0 1 2 3 8 10 11
+static std::vector<int> parse_list(const char* s) {
+    std::vector<int> v;
+    while (*s >= '0' && *s <= '9') {
+        char* end;
+        int lo = int(strtol(s, &end, 10)), hi = lo;
+        if (*end == '-')
+            hi = int(strtol(end + 1, &end, 10));
+        for (int i = lo; i <= hi; i++)
+            v.push_back(i);
+        s = *end == ',' ? end + 1 : end;
+    }
+    return v;
+}
+
+static std::vector<int> read_list(const char* path) {
+    char buf[4096] = "";
+    if (FILE* f = fopen(path, "r")) {
+        if (!fgets(buf, sizeof(buf), f))
+            buf[0] = 0;
+        fclose(f);
+    }
+    return parse_list(buf);
+}
+
+static const std::vector<NumaNode>& topology() {
+    static const std::vector<NumaNode> nodes = [] {
+        std::vector<NumaNode> v;
+#if defined(__linux__)
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            CPU_ZERO(&allowed);
+        auto usable = [&](int c) { return c < CPU_SETSIZE && CPU_ISSET(c, &allowed); };
+
+        for (int id : read_list("/sys/devices/system/node/online")) {
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", id);
+            NumaNode n{id, {}};
+            for (int c : read_list(path))
+                if (usable(c))
+                    n.cpus.push_back(c);
+            if (!n.cpus.empty() && id < MAX_NODES)
+                v.push_back(n);
+        }
+        if (v.empty()) {
+            // no sysfs: one node with every CPU we may use
+            NumaNode n{0, {}};
+            for (int c = 0; c < CPU_SETSIZE; c++)
+                if (usable(c))
+                    n.cpus.push_back(c);
+            v.push_back(n);
+        }
+#else
+        v.push_back(NumaNode{0, {}});
+#endif
+        return v;
+    }();
+    return nodes;
+}
+
+int pool_nodes() {
+    return int(topology().size());
+}
+
+int pool_pin_worker(int worker) {
+    const std::vector<NumaNode>& nodes = topology();
+    const NumaNode& n = nodes[worker % nodes.size()];
+    if (n.cpus.empty())
+        return -1;
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(n.cpus[worker / nodes.size() % n.cpus.size()], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        return -1;
+    return n.id;
+#else
+    return -1;
+#endif
+}
+
+// Prefers the node rather than binding strictly, so a full node spills
+// over instead of failing the fault.
+static bool place_on_node(void* p, size_t n, int node) {
+#if defined(__linux__)
+    unsigned long mask[MAX_NODES / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] |= 1ul << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, p, n, MPOL_PREFERRED, mask, MAX_NODES + 1, 0) == 0;
+#else
+    (void)p, (void)n, (void)node;
+    return false;
+#endif
+}
+
+static u8* map_chunk(size_t n) {
+#if defined(__linux__)
+    void* p = mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? nullptr : (u8*)p;
+#else
+    return (u8*)calloc(1, n); // zeroed, as anonymous pages are
+#endif
+}
+
+static void unmap_chunk(u8* p, size_t n) {
+#if defined(__linux__)
+    munmap(p, n);
+#else
+    (void)n;
+    free(p);
+#endif
+}
+
+// Free list and the uncarved rest of the last chunk, for one node.
+struct Arena {
+    std::mutex mu;
+    std::vector<Instance*> free;
+    std::vector<u8*> chunks;
+    u8* next = nullptr;
+    u8* end = nullptr;
+    bool placed = false; // mbind() took for the current chunk
+};
+
+struct InstancePool {
+    bool numa;
+    int arenas; // node id + 1; arena 0 holds unplaced instances
+    std::unique_ptr<Arena[]> arena;
+    std::atomic<u64> created{0}, reused{0}, pages_cleared{0}, bytes_mapped{0}, bound{0};
+};
+
+InstancePool* pool_create(bool numa) {
+    InstancePool* p = new InstancePool;
+    p->numa = numa;
+    int top = 0;
+    for (const NumaNode& n : topology())
+        top = std::max(top, n.id);
+    p->arenas = numa ? top + 2 : 1;
+    p->arena.reset(new Arena[p->arenas]);
+    return p;
+}
+
+void pool_destroy(InstancePool* p) {
+    for (int a = 0; a < p->arenas; a++)
+        for (u8* c : p->arena[a].chunks)
+            unmap_chunk(c, SLOT * CHUNK_SLOTS);
+    delete p;
+}
+
+Instance* pool_acquire(InstancePool* p, int node) {
+    int a = p->numa && node >= 0 && node + 1 < p->arenas ? node + 1 : 0;
+    Arena& ar = p->arena[a];
+    std::lock_guard<std::mutex> lock(ar.mu);
+    if (!ar.free.empty()) {
+        Instance* inst = ar.free.back();
+        ar.free.pop_back();
+        p->reused++;
+        return inst;
+    }
+
+    if (ar.next == ar.end) {
+        u8* c = map_chunk(SLOT * CHUNK_SLOTS);
+        if (!c)
+            return nullptr;
+        // before the first touch, so every fault lands on the node
+        ar.placed = a > 0 && place_on_node(c, SLOT * CHUNK_SLOTS, a - 1);
+        ar.chunks.push_back(c);
+        ar.next = c;
+        ar.end = c + SLOT * CHUNK_SLOTS;
+        p->bytes_mapped += SLOT * CHUNK_SLOTS;
+    }
+    // default-initialized: mem.data keeps the zero pages it was mapped with
+    Instance* inst = new (ar.next) Instance;
+    ar.next += SLOT;
+    inst->node = a - 1;
+    inst->mem.clear_dirty();
+    inst->cpu.mem = &inst->mem;
+    inst->cpu.reset();
+    p->created++;
+    p->bound += ar.placed;
+    return inst;
+}
+
+void pool_load(Instance* inst, u16 addr, const u8* bytes, size_t n) {
+    n = std::min(n, size_t(0x10000 - addr));
+    if (!n)
+        return;
+    memcpy(inst->mem.data + addr, bytes, n);
+    inst->mem.mark_written(addr, u32(n));
+}
+
+int pool_recycle(Instance* inst) {
+    Memory& m = inst->mem;
+    int cleared = 0;
+    for (int page = 0; page < 256;) {
+        if (!m.is_dirty(page)) {
+            page++;
+            continue;
+        }
+        int run = page;
+        while (run < 256 && m.is_dirty(run))
+            run++;
+        bulk_clear(m.data + page * 256, size_t(run - page) * 256);
+        cleared += run - page;
+        page = run;
+    }
+    m.clear_dirty();
+    memset(m.watched, 0, sizeof(m.watched));
+    m.nhits = 0;
+
+    CPU& cpu = inst->cpu;
+    cpu.reset();
+    cpu.io = nullptr;
+    cpu.mem = &m;
+    return cleared;
+}
+
+void pool_release(InstancePool* p, Instance* inst) {
+    p->pages_cleared += pool_recycle(inst);
+    Arena& ar = p->arena[inst->node + 1];
+    std::lock_guard<std::mutex> lock(ar.mu);
+    ar.free.push_back(inst);
+}
+
+PoolStats pool_stats(InstancePool* p) {
+    return PoolStats{p->created, p->reused, p->pages_cleared, p->bytes_mapped, p->bound};
+}
@@ -0,0 +1,150 @@
+#include "replay/replay.h"
+#include <cstdio>
+#include <cstring>
+
+static const char magic[8] = {'8', '0', '8', '0', 'R', 'R', '0', '1'};
+
+void Recorder::begin() {
+    log.assign(magic, magic + sizeof(magic));
+    last_cycle = 0;
+    events = 0;
+}
+
+bool Recorder::save(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        printf("Failed to write replay log: %s\n", path);
+        return false;
+    }
+    log.push_back(EV_END);
+    bool ok = fwrite(log.data(), 1, log.size(), f) == log.size();
+    log.pop_back();
+    fclose(f);
+    return ok;
+}
+
+bool Replayer::load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        printf("Failed to open replay log: %s\n", path);
+        return false;
+    }
+    std::vector<u8> bytes;
+    u8 buf[65536];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0;)
+        bytes.insert(bytes.end(), buf, buf + n);
+    fclose(f);
+    return start(std::move(bytes));
+}
+
+bool Replayer::start(std::vector<u8> bytes) {
+    log = std::move(bytes);
+    if (log.size() < sizeof(magic) || memcmp(log.data(), magic, sizeof(magic)) != 0) {
+        printf("Not a replay log\n");
+        return false;
+    }
+    pos = sizeof(magic);
+    kind = EV_END;
+    cycle = 0;
+    events = 0;
+    diverged = false;
+    next();
+    return true;
+}
+
+void Replayer::next() {
+    if (kind != EV_END)
+        events++; // the current one was used
+    if (pos >= log.size()) {
+        kind = EV_END;
+        return;
+    }
+    kind = log[pos++];
+    if (kind == EV_END)
+        return;
+
+    u64 d = 0;
+    for (int shift = 0; pos < log.size(); shift += 7) {
+        u8 byte = log[pos++];
+        d |= u64(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            break;
+    }
+    cycle += d;
+    a = pos < log.size() ? log[pos++] : 0;
+    if (kind == EV_IN)
+        b = pos < log.size() ? log[pos++] : 0;
+}
+
+bool Replayer::expect(u8 k, u64 now) {
+    if (kind == k && cycle == now)
+        return true;
+    if (!diverged) {
+        diverged = true;
+        diverged_at = now;
+    }
+    return false;
+}
+
+u8 Replayer::in(u64 now, u8 port) {
+    if (!expect(EV_IN, now) || a != port)
+        return 0;
+    u8 v = b;
+    next();
+    return v;
+}
+
+u8 Replayer::console(u64 now) {
+    if (!expect(EV_CONSOLE, now))
+        return 0x1A;
+    u8 v = a;
+    next();
+    return v;
+}
+
+u8 Replayer::console_ready(u64 now) {
+    if (!expect(EV_CONSOLE_RDY, now))
+        return 0;
+    u8 v = a;
+    next();
+    return v;
+}
+
+static u8 tap_in(void* ctx, u8 port) {
+    PortTap& t = *static_cast<PortTap*>(ctx);
+    if (t.replay)
+        return t.replay->in(t.cpu->cycles, port);
+    u8 v = t.inner ? t.inner->in(t.inner->ctx, port) : 0;
+    if (t.record)
+        t.record->in(t.cpu->cycles, port, v);
+    return v;
+}
+
+static void tap_out(void* ctx, u8 port, u8 value) {
+    PortTap& t = *static_cast<PortTap*>(ctx);
+    if (t.inner)
+        t.inner->out(t.inner->ctx, port, value);
+}
+
+void PortTap::attach(CPU& c, Recorder* rec, Replayer* rep) {
+    cpu = &c;
+    record = rec;
+    replay = rep;
+    inner = c.io;
+    io = IOPorts{tap_in, tap_out, this};
+    c.io = &io;
+}
+
+void PortTap::detach() {
+    if (cpu && cpu->io == &io)
+        cpu->io = inner;
+    cpu = nullptr;
+}
+
+int raise_interrupt(CPU& cpu, u8 rst, Recorder* rec) {
+    u64 at = cpu.cycles;
+    int n = cpu.interrupt(rst);
+    if (n && rec)
+        rec->interrupt(at, rst);
+    return n;
+}
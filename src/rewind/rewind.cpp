@@ -0,0 +1,219 @@
+#include "rewind/rewind.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+static constexpr int PAGE = 256;
+
+static size_t cost(const Checkpoint& c) {
+    return sizeof(Checkpoint) + c.undo.size() + c.pages.size();
+}
+
+// Overwrites pages of dst with the undo record of c.
+static void apply_undo(const Checkpoint& c, u8* dst) {
+    for (size_t i = 0; i < c.pages.size(); i++)
+        memcpy(dst + c.pages[i] * PAGE, &c.undo[i * PAGE], PAGE);
+}
+
+// Registers of c, keeping the memory and port bindings of cpu.
+static void load_regs(CPU& cpu, const CPU& saved) {
+    Memory* mem = cpu.mem;
+    IOPorts* io = cpu.io;
+    cpu = saved;
+    cpu.mem = mem;
+    cpu.io = io;
+}
+
+void Rewind::attach(CPU& c) {
+    cpu = &c;
+    mem = c.mem;
+    checkpoints.clear();
+    checkpoints.push_back(Checkpoint{c, {}, {}, cursor ? *cursor : 0});
+    bytes = cost(checkpoints.back());
+    frontier = c.cycles;
+    memcpy(shadow, mem->data, sizeof(shadow));
+    mem->clear_dirty();
+}
+
+void Rewind::checkpoint() {
+    Checkpoint& last = checkpoints.back();
+    for (int w = 0; w < 4; w++) {
+        for (u64 bits = mem->dirty_bits(w); bits; bits &= bits - 1) {
+            int page = w * 64 + __builtin_ctzll(bits);
+            last.pages.push_back(u8(page));
+            last.undo.insert(last.undo.end(), shadow + page * PAGE, shadow + (page + 1) * PAGE);
+            memcpy(shadow + page * PAGE, mem->data + page * PAGE, PAGE);
+        }
+    }
+    mem->clear_dirty();
+    bytes += last.pages.size() * (PAGE + 1);
+
+    checkpoints.push_back(Checkpoint{*cpu, {}, {}, cursor ? *cursor : 0});
+    bytes += cost(checkpoints.back());
+    while (bytes > budget && checkpoints.size() > 1) {
+        bytes -= cost(checkpoints.front());
+        checkpoints.pop_front();
+    }
+}
+
+int Rewind::exec_one() {
+    return exec ? exec(exec_ctx, *cpu) : cpu->step();
+}
+
+int Rewind::step() {
+    int n = exec_one();
+    if (n && cpu->cycles >= checkpoints.back().regs.cycles + interval)
+        checkpoint();
+    return n;
+}
+
+// Puts the machine back at checkpoint `index` and forgets the later ones;
+// running forward again recreates them.
+void Rewind::restore(size_t index) {
+    frontier = std::max(frontier, cpu->cycles); // only needed once going back
+    // pages written since the newest checkpoint are still in the shadow
+    for (int w = 0; w < 4; w++) {
+        for (u64 bits = mem->dirty_bits(w); bits; bits &= bits - 1) {
+            int page = w * 64 + __builtin_ctzll(bits);
+            memcpy(mem->data + page * PAGE, shadow + page * PAGE, PAGE);
+        }
+    }
+
+    for (size_t k = checkpoints.size(); k-- > index;) {
+        Checkpoint& c = checkpoints[k];
+        apply_undo(c, mem->data);
+        apply_undo(c, shadow);
+        for (u8 page : c.pages)
+            mem->mark_written(page * PAGE, PAGE);
+        bytes -= cost(c);
+        if (k > index)
+            checkpoints.pop_back();
+    }
+    mem->clear_dirty(); // memory matches the shadow again; the hash catches up
+    Checkpoint& c = checkpoints[index];
+    c.pages.clear();
+    c.undo.clear();
+    bytes += cost(c);
+
+    load_regs(*cpu, c.regs);
+    if (cursor)
+        *cursor = c.cursor;
+    restores++;
+}
+
+bool Rewind::run_forward(u64 cycle) {
+    while (cpu->cycles < cycle)
+        if (step() == 0)
+            return false;
+    return true;
+}
+
+// Newest checkpoint at or before cycle (which must not precede the oldest).
+static size_t find(const std::deque<Checkpoint>& cps, u64 cycle) {
+    auto it = std::upper_bound(cps.begin(), cps.end(), cycle,
+                               [](u64 c, const Checkpoint& cp) { return c < cp.regs.cycles; });
+    return size_t(it - cps.begin()) - 1;
+}
+
+bool Rewind::run_to(u64 cycle) {
+    if (cycle < cpu->cycles) {
+        if (checkpoints.empty() || cycle < oldest())
+            return false;
+        restore(find(checkpoints, cycle));
+        replayed_cycles += cycle - cpu->cycles;
+    }
+    return run_forward(cycle);
+}
+
+bool Rewind::step_back() {
+    u64 now = cpu->cycles;
+    if (checkpoints.empty() || oldest() >= now)
+        return false;
+
+    // find where the instruction ending at `now` started, then go there
+    restore(find(checkpoints, now - 1));
+    replayed_cycles += now - cpu->cycles;
+    u64 start = cpu->cycles;
+    while (cpu->cycles < now) {
+        start = cpu->cycles;
+        if (step() == 0)
+            break;
+    }
+    return run_to(start);
+}
+
+bool Rewind::reverse_to_write(u16 addr) {
+    u64 now = cpu->cycles;
+    int page = addr >> 8;
+    if (checkpoints.empty())
+        return false;
+
+    // Intervals are searched newest first on a scratch machine, so a miss
+    // leaves the history alone. Only intervals whose undo record (or, for
+    // the open one, the dirty bits) shows a write to the page are run.
+    std::unique_ptr<Memory> scratch(new Memory);
+    std::unique_ptr<u8[]> base(new u8[0x10000]);
+    memcpy(base.get(), shadow, 0x10000);
+    CPU c = *cpu;
+    c.mem = scratch.get();
+
+    size_t keep = cursor ? *cursor : 0;
+    in_scratch = true;
+    u64 end = now, hit = ~0ull;
+    for (size_t i = checkpoints.size(); i-- > 0 && hit == ~0ull;) {
+        const Checkpoint& cp = checkpoints[i];
+        bool written = i + 1 == checkpoints.size()
+                           ? mem->is_dirty(page)
+                           : std::find(cp.pages.begin(), cp.pages.end(), u8(page)) != cp.pages.end();
+        if (i + 1 < checkpoints.size())
+            apply_undo(cp, base.get()); // base is now the state at cp
+
+        if (written && cp.regs.cycles < end) {
+            memcpy(scratch->data, base.get(), 0x10000);
+            scratch->watch_page(page, true);
+            load_regs(c, cp.regs);
+            if (cursor)
+                *cursor = cp.cursor;
+            while (c.cycles < end) {
+                u64 start = c.cycles;
+                scratch->nhits = 0;
+                if ((exec ? exec(exec_ctx, c) : c.step()) == 0)
+                    break;
+                if (scratch->nhits && scratch->was_written(addr))
+                    hit = start;
+            }
+            replayed_cycles += c.cycles - cp.regs.cycles;
+        }
+        end = cp.regs.cycles;
+    }
+    in_scratch = false;
+    if (cursor)
+        *cursor = keep;
+    return hit != ~0ull && run_to(hit);
+}
+
+bool Rewind::reverse_until(bool (*hit)(void* ctx, u16 pc), void* ctx) {
+    // Each interval, newest first, is replayed in full to find its last hit;
+    // a miss costs the history once over.
+    u64 end = cpu->cycles;
+    while (!checkpoints.empty() && oldest() < end) {
+        restore(find(checkpoints, end - 1));
+        u64 from = cpu->cycles, found = ~0ull;
+        while (cpu->cycles < end) {
+            u64 start = cpu->cycles;
+            u16 pc = cpu->pc;
+            mem->nhits = 0;
+            if (step() == 0)
+                break;
+            if (hit(ctx, pc))
+                found = start;
+        }
+        replayed_cycles += cpu->cycles - from;
+        if (found != ~0ull)
+            return run_to(found);
+        end = from;
+    }
+    if (!checkpoints.empty())
+        run_to(oldest());
+    return false;
+}
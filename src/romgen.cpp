@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gen/gen.h"
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --preset NAME   starting profile (default mixed)\n");
+    printf("  --set K=V,...   override it: class weights (");
+    for (int c = 0; c < GEN_CLASSES; c++)
+        printf(c ? " %s" : "%s", gen_class_name(c));
+    printf("),\n");
+    printf("                  taken, data, footprint, depth, smc, body, cycles\n");
+    printf("  --seed N        random seed (default 1)\n");
+    printf("  -o FILE         output (default <preset>.com)\n");
+    printf("  --list          print the presets\n");
+}
+
+static void print_profile(const GenProfile& p) {
+    printf("%-12s", p.name);
+    for (int c = 0; c < GEN_CLASSES; c++)
+        printf(" %s=%u", gen_class_name(c), p.weight[c]);
+    printf(" taken=%g data=%g footprint=%u depth=%d smc=%g body=%d cycles=%llu\n", p.taken_rate,
+           p.data_branches, p.footprint, p.call_depth, p.smc_rate, p.body, (unsigned long long)p.cycles);
+}
+
+int main(int argc, char** argv) {
+    const char* preset = "mixed";
+    std::vector<const char*> sets;
+    u64 seed = 1;
+    const char* out = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--preset") && i + 1 < argc)
+            preset = argv[++i];
+        else if (!strcmp(argv[i], "--set") && i + 1 < argc)
+            sets.push_back(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 0);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            out = argv[++i];
+        else if (!strcmp(argv[i], "--list")) {
+            int n;
+            const GenProfile* p = gen_presets(&n);
+            for (int k = 0; k < n; k++)
+                print_profile(p[k]);
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    const GenProfile* base = gen_preset(preset);
+    if (!base) {
+        printf("unknown preset %s (see --list)\n", preset);
+        return 1;
+    }
+    GenProfile p = *base;
+    for (const char* s : sets)
+        if (!gen_parse(p, s)) {
+            printf("bad --set %s\n", s);
+            return 1;
+        }
+
+    std::vector<u8> image = gen_rom(p, seed);
+    if (image.empty()) {
+        printf("profile out of range or code too large:\n");
+        print_profile(p);
+        return 1;
+    }
+    std::string path = out ? out : std::string(preset) + ".com";
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f || fwrite(image.data(), 1, image.size(), f) != image.size()) {
+        perror(path.c_str());
+        if (f)
+            fclose(f);
+        return 1;
+    }
+    fclose(f);
+    printf("%s: %zu bytes, seed %llu\n", path.c_str(), image.size(), (unsigned long long)seed);
+    print_profile(p);
+    return 0;
+}
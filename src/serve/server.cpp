@@ -0,0 +1,552 @@
+#include "serve/server.h"
+#include "cpm/bdos.h"
+#include "memo/memo.h"
+#include "pool/pool.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static u64 now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void LatencyHistogram::add(u64 ns) {
+    int b = ns ? 64 - __builtin_clzll(ns) : 0;
+    bucket[b < BUCKETS ? b : BUCKETS - 1].fetch_add(1, std::memory_order_relaxed);
+}
+
+u64 LatencyHistogram::count() const {
+    u64 n = 0;
+    for (const auto& b : bucket)
+        n += b.load(std::memory_order_relaxed);
+    return n;
+}
+
+u64 LatencyHistogram::percentile_ns(double p) const {
+    u64 total = count(), seen = 0;
+    if (!total)
+        return 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        seen += bucket[b].load(std::memory_order_relaxed);
+        if (seen >= total * p)
+            return 1ull << b;
+    }
+    return 1ull << (BUCKETS - 1);
+}
+
+void LatencyHistogram::format(const char* name, std::string& out) const {
+    char line[128];
+    snprintf(line, sizeof(line), "%s n=%llu p50<%.1fus p90<%.1fus p99<%.1fus\n", name,
+             (unsigned long long)count(), percentile_ns(0.5) / 1e3, percentile_ns(0.9) / 1e3,
+             percentile_ns(0.99) / 1e3);
+    out += line;
+    for (int b = 0; b < BUCKETS; b++) {
+        u64 n = bucket[b].load(std::memory_order_relaxed);
+        if (!n)
+            continue;
+        snprintf(line, sizeof(line), "  <%10.1fus %llu\n", (1ull << b) / 1e3, (unsigned long long)n);
+        out += line;
+    }
+}
+
+struct Job {
+    u64 conn;
+    u32 rom;
+    u64 max_cycles;
+    std::string input;
+    u64 received; // now_ns() when the request was parsed
+
+    MemoKey key;
+    bool verify;       // a cache hit run again to check it
+    MemoResult cached; // the entry being checked
+};
+
+struct Done {
+    u64 conn;
+    std::string reply;
+    u64 received;
+};
+
+struct Conn {
+    int fd;
+    std::string in, out;
+    bool busy;    // a RUN is with the workers; later lines wait
+    bool closing; // peer hung up, close once the reply is dropped
+};
+
+struct Server {
+    ServeConfig cfg;
+    std::vector<RomImage> roms;
+
+    int listen_fd = -1, epoll_fd = -1, wake_fd = -1;
+    std::atomic<bool> stopping{false};
+
+    std::mutex job_mu;
+    std::condition_variable job_cv;
+    std::deque<Job> jobs;
+    std::condition_variable start_cv;
+    int started = 0;          // workers done acquiring their instance
+    bool no_instance = false; // one of them got none
+
+    std::mutex done_mu;
+    std::vector<Done> done;
+
+    std::unordered_map<u64, Conn> conns; // event loop thread only
+    u64 next_conn = 1;
+    std::vector<std::thread> workers;
+    InstancePool* pool = nullptr;
+
+    MemoCache* memo = nullptr;
+    std::vector<MemoKey> rom_digest;
+    u64 memo_hits = 0; // event loop thread only
+    std::atomic<u64> verified{0}, stale{0};
+
+    LatencyHistogram latency, run_time;
+};
+
+// data.u64 values for the two non-connection fds
+constexpr u64 LISTEN_ID = 0;
+constexpr u64 WAKE_ID = ~0ull;
+
+static const char* status_name(RunStatus s) {
+    switch (s) {
+    case RUN_EXIT:
+        return "exit";
+    case RUN_BUDGET:
+        return "budget";
+    case RUN_HALT:
+        return "halt";
+    default:
+        return "fault";
+    }
+}
+
+static std::string run_reply(u8 status, u64 instructions, u64 cycles, u64 run_us, const std::string& output) {
+    char head[128];
+    snprintf(head, sizeof(head), "OK %zu %s %llu %llu %llu\n", output.size(), status_name(RunStatus(status)),
+             (unsigned long long)instructions, (unsigned long long)cycles, (unsigned long long)run_us);
+    return head + output;
+}
+
+static void wake(Server* s) {
+    u64 one = 1;
+    ssize_t r = write(s->wake_fd, &one, sizeof(one));
+    (void)r;
+}
+
+static void worker_main(Server* s, int index) {
+    // each worker keeps one instance, on its own node when pinned
+    int node = s->cfg.numa ? pool_pin_worker(index) : -1;
+    Instance* inst = pool_acquire(s->pool, node);
+    if (!inst && node >= 0) {
+        fprintf(stderr, "emud: worker %d: no memory on node %d, placing its instance anywhere\n", index, node);
+        inst = pool_acquire(s->pool, -1);
+    }
+    {
+        std::lock_guard<std::mutex> lock(s->job_mu);
+        s->started++;
+        s->no_instance |= !inst;
+    }
+    s->start_cv.notify_one();
+    if (!inst)
+        return;
+    std::string output;
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(s->job_mu);
+            s->job_cv.wait(lock, [&] { return !s->jobs.empty() || s->stopping; });
+            if (s->jobs.empty())
+                break;
+            job = std::move(s->jobs.front());
+            s->jobs.pop_front();
+        }
+
+        const RomImage& rom = s->roms[job.rom];
+        pool_load(inst, 0x100, rom.bytes.data(), rom.bytes.size());
+        CPU& cpu = inst->cpu;
+        cpu.pc = 0x100;
+
+        output.clear();
+        Console con{nullptr, &output, (const u8*)job.input.data(), job.input.size(), 0};
+        u64 t0 = now_ns();
+        RunResult r = run_com(cpu, con, job.max_cycles);
+        u64 run_ns = now_ns() - t0;
+        s->run_time.add(run_ns);
+
+        // stored before the reply goes out, so a repeat sent on receiving
+        // it finds the entry
+        if (s->memo) {
+            MemoResult res{u8(r.status), r.instructions, r.cycles, memo_state_digest(cpu), output};
+            if (job.verify) {
+                s->verified++;
+                if (!(res == job.cached)) {
+                    s->stale++;
+                    fprintf(stderr, "emud: stale memo entry for %s (%s %llu cycles before, %s %llu now), replaced\n",
+                            rom.name.c_str(), status_name(RunStatus(job.cached.status)),
+                            (unsigned long long)job.cached.cycles, status_name(r.status),
+                            (unsigned long long)r.cycles);
+                    memo_store(s->memo, job.key, res);
+                }
+            } else
+                memo_store(s->memo, job.key, res);
+        }
+
+        std::string reply = run_reply(r.status, r.instructions, r.cycles, run_ns / 1000, output);
+        {
+            std::lock_guard<std::mutex> lock(s->done_mu);
+            s->done.push_back(Done{job.conn, std::move(reply), job.received});
+        }
+        wake(s);
+
+        // ready for the next request before it arrives: only the pages
+        // this run wrote are cleared
+        pool_recycle(inst);
+    }
+    pool_release(s->pool, inst);
+}
+
+static void watch(Server* s, int fd, u64 id, u32 events, int op) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.u64 = id;
+    epoll_ctl(s->epoll_fd, op, fd, &ev);
+}
+
+static void close_conn(Server* s, u64 id) {
+    auto it = s->conns.find(id);
+    if (it == s->conns.end())
+        return;
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, it->second.fd, nullptr);
+    close(it->second.fd);
+    s->conns.erase(it);
+}
+
+static void flush(Server* s, u64 id, Conn& c) {
+    while (!c.out.empty()) {
+        ssize_t n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            c.out.clear();
+            c.closing = true;
+            break;
+        }
+        c.out.erase(0, n);
+    }
+    // after a hangup only pending replies are of interest
+    u32 events = (c.closing ? 0u : u32(EPOLLIN | EPOLLRDHUP)) | (c.out.empty() ? 0u : u32(EPOLLOUT));
+    watch(s, c.fd, id, events, EPOLL_CTL_MOD);
+}
+
+static void reply(Conn& c, const char* fmt_head, const std::string& payload) {
+    char head[64];
+    snprintf(head, sizeof(head), fmt_head, payload.size());
+    c.out += head;
+    c.out += payload;
+}
+
+// Splits a request line at spaces and tabs.
+static std::vector<std::string> words(const std::string& line) {
+    std::vector<std::string> out;
+    size_t at = 0;
+    while ((at = line.find_first_not_of(" \t", at)) != std::string::npos) {
+        size_t end = line.find_first_of(" \t", at);
+        out.push_back(line.substr(at, end - at));
+        at = end;
+    }
+    return out;
+}
+
+static bool parse_hex(const char* p, std::string& out) {
+    auto nibble = [](char ch) {
+        if (ch >= '0' && ch <= '9')
+            return ch - '0';
+        ch |= 0x20;
+        return ch >= 'a' && ch <= 'f' ? ch - 'a' + 10 : -1;
+    };
+    for (; p[0] && p[1]; p += 2) {
+        int hi = nibble(p[0]), lo = nibble(p[1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        out += char(hi << 4 | lo);
+    }
+    return !p[0];
+}
+
+// Whether the cache answers job; a sampled hit is left to run, with the
+// entry kept in job.cached for the worker to check.
+static bool cached(Server* s, Job& job) {
+    job.key = memo_key(s->rom_digest[job.rom], 0x100, 0x100, job.input.data(), job.input.size(), job.max_cycles);
+    if (!memo_lookup(s->memo, job.key, job.cached))
+        return false;
+    s->memo_hits++;
+    double rate = s->cfg.memo_verify;
+    job.verify = u64(s->memo_hits * rate) != u64((s->memo_hits - 1) * rate);
+    return !job.verify;
+}
+
+// Handles complete lines until one is handed to the workers.
+static void dispatch(Server* s, u64 id, Conn& c) {
+    while (!c.busy) {
+        size_t eol = c.in.find('\n');
+        if (eol == std::string::npos)
+            return;
+        std::string line = c.in.substr(0, eol);
+        c.in.erase(0, eol + 1);
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        std::vector<std::string> w = words(line);
+        std::string cmd = w.empty() ? "" : w[0];
+
+        if (cmd == "LIST") {
+            std::string names;
+            for (const RomImage& r : s->roms)
+                names += r.name + "\n";
+            reply(c, "OK %zu\n", names);
+        } else if (cmd == "STATS") {
+            std::string text;
+            s->latency.format("turnaround", text);
+            s->run_time.format("run", text);
+            if (s->memo) {
+                MemoStats m = memo_stats(s->memo);
+                char line[256];
+                snprintf(line, sizeof(line),
+                         "memo entries=%llu hits=%llu misses=%llu stored=%llu verified=%llu stale=%llu resets=%llu\n",
+                         (unsigned long long)m.entries, (unsigned long long)m.hits, (unsigned long long)m.misses,
+                         (unsigned long long)m.stored, (unsigned long long)s->verified.load(),
+                         (unsigned long long)s->stale.load(), (unsigned long long)m.resets);
+                text += line;
+            }
+            reply(c, "OK %zu\n", text);
+        } else if (cmd == "RUN" && w.size() >= 2) {
+            char* end = nullptr;
+            u64 cycles = w.size() >= 3 ? strtoull(w[2].c_str(), &end, 10) : s->cfg.default_cycles;
+            Job job{id, 0, cycles, {}, now_ns(), {}, false, {}};
+            while (job.rom < s->roms.size() && s->roms[job.rom].name != w[1])
+                job.rom++;
+            if (w.size() > 4)
+                c.out += "ERR too many arguments\n";
+            else if (job.rom == s->roms.size())
+                c.out += "ERR unknown rom\n";
+            else if (end && (*end || !(w[2][0] >= '0' && w[2][0] <= '9')))
+                c.out += "ERR bad cycle budget\n";
+            else if (job.max_cycles > s->cfg.max_cycles)
+                c.out += "ERR cycle budget too large\n";
+            else if (w.size() == 4 && w[3].size() > 2 * s->cfg.max_input)
+                c.out += "ERR input too long\n";
+            else if (w.size() == 4 && !parse_hex(w[3].c_str(), job.input))
+                c.out += "ERR bad input hex\n";
+            else if (s->memo && cached(s, job)) {
+                c.out += run_reply(job.cached.status, job.cached.instructions, job.cached.cycles, 0, job.cached.output);
+                s->latency.add(now_ns() - job.received);
+            } else {
+                c.busy = true;
+                {
+                    std::lock_guard<std::mutex> lock(s->job_mu);
+                    s->jobs.push_back(std::move(job));
+                }
+                s->job_cv.notify_one();
+            }
+        } else
+            c.out += "ERR unknown request\n";
+    }
+}
+
+static void accept_all(Server* s) {
+    for (;;) {
+        int fd = accept4(s->listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        u64 id = s->next_conn++;
+        s->conns.emplace(id, Conn{fd, {}, {}, false, false});
+        watch(s, fd, id, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+    }
+}
+
+static void read_conn(Server* s, u64 id, Conn& c) {
+    char buf[4096];
+    for (;;) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            c.in.append(buf, n);
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+            c.closing = true;
+        break;
+    }
+    if (c.in.size() > (1 << 20)) // no newline in sight
+        c.closing = true;
+    dispatch(s, id, c);
+}
+
+static void collect_done(Server* s) {
+    u64 count;
+    ssize_t r = read(s->wake_fd, &count, sizeof(count));
+    (void)r;
+
+    std::vector<Done> batch;
+    {
+        std::lock_guard<std::mutex> lock(s->done_mu);
+        batch.swap(s->done);
+    }
+    for (Done& d : batch) {
+        s->latency.add(now_ns() - d.received);
+        auto it = s->conns.find(d.conn);
+        if (it == s->conns.end())
+            continue;
+        Conn& c = it->second;
+        c.busy = false;
+        c.out += d.reply;
+        dispatch(s, d.conn, c);
+        flush(s, d.conn, c);
+        if (c.closing && !c.busy && c.out.empty())
+            close_conn(s, d.conn);
+    }
+}
+
+static bool open_socket(Server* s) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (s->cfg.socket_path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", s->cfg.socket_path.c_str());
+        return false;
+    }
+    strcpy(addr.sun_path, s->cfg.socket_path.c_str());
+    unlink(addr.sun_path);
+
+    s->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->listen_fd < 0 || bind(s->listen_fd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(s->listen_fd, 128) < 0) {
+        perror("emud socket");
+        return false;
+    }
+    s->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (s->epoll_fd < 0 || s->wake_fd < 0) {
+        perror("emud epoll");
+        return false;
+    }
+    watch(s, s->listen_fd, LISTEN_ID, EPOLLIN, EPOLL_CTL_ADD);
+    watch(s, s->wake_fd, WAKE_ID, EPOLLIN, EPOLL_CTL_ADD);
+    return true;
+}
+
+Server* server_create(const ServeConfig& cfg, std::vector<RomImage> roms) {
+    Server* s = new Server;
+    s->cfg = cfg;
+    s->roms = std::move(roms);
+    s->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return s;
+}
+
+int server_run(Server* s) {
+    if (!s->cfg.memo_path.empty()) {
+        s->memo = memo_open(s->cfg.memo_path.c_str(), s->cfg.memo_bytes);
+        if (!s->memo)
+            return -1;
+        for (const RomImage& r : s->roms)
+            s->rom_digest.push_back(memo_digest(r.bytes.data(), r.bytes.size()));
+    }
+    if (!open_socket(s)) {
+        memo_close(s->memo);
+        s->memo = nullptr;
+        return -1;
+    }
+    s->pool = pool_create(s->cfg.numa);
+    int nworkers = s->cfg.workers > 0 ? s->cfg.workers : 1;
+    for (int i = 0; i < nworkers; i++)
+        s->workers.emplace_back(worker_main, s, i);
+
+    // every worker holds its instance before the first request is taken
+    int rc = 0;
+    {
+        std::unique_lock<std::mutex> lock(s->job_mu);
+        s->start_cv.wait(lock, [&] { return s->started == nworkers; });
+        if (s->no_instance) {
+            fprintf(stderr, "emud: cannot allocate an instance for every worker\n");
+            s->stopping = true;
+            rc = -1;
+        }
+    }
+
+    epoll_event events[64];
+    while (!s->stopping) {
+        int n = epoll_wait(s->epoll_fd, events, 64, -1);
+        for (int i = 0; i < n; i++) {
+            u64 id = events[i].data.u64;
+            if (id == LISTEN_ID) {
+                accept_all(s);
+                continue;
+            }
+            if (id == WAKE_ID) {
+                collect_done(s);
+                continue;
+            }
+            auto it = s->conns.find(id);
+            if (it == s->conns.end())
+                continue;
+            Conn& c = it->second;
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                read_conn(s, id, c);
+            flush(s, id, c);
+            if (c.closing && !c.busy && c.out.empty())
+                close_conn(s, id);
+        }
+    }
+
+    {
+        // a worker between its predicate check and the wait must not miss this
+        std::lock_guard<std::mutex> lock(s->job_mu);
+    }
+    s->job_cv.notify_all();
+    for (std::thread& t : s->workers)
+        t.join();
+    s->workers.clear();
+    pool_destroy(s->pool);
+    s->pool = nullptr;
+    memo_close(s->memo);
+    s->memo = nullptr;
+    while (!s->conns.empty())
+        close_conn(s, s->conns.begin()->first);
+    close(s->listen_fd);
+    close(s->epoll_fd);
+    unlink(s->cfg.socket_path.c_str());
+    return rc;
+}
+
+void server_stop(Server* s) {
+    s->stopping = true;
+    wake(s);
+}
+
+void server_destroy(Server* s) {
+    close(s->wake_fd);
+    delete s;
+}
+
+const LatencyHistogram& server_latency(const Server* s) {
+    return s->latency;
+}
+
+const LatencyHistogram& server_run_time(const Server* s) {
+    return s->run_time;
+}
@@ -0,0 +1,129 @@
+#include "sim/link.h"
+#include <thread>
+
+static constexpr u8 RX_READY = 0x01;
+static constexpr u8 TX_READY = 0x02;
+
+// Spins briefly, then gives the core away; the peer may share it.
+static void back_off(SerialPort& p, int& spins) {
+    if (++spins < 64)
+        return;
+    p.host_waits++;
+    std::this_thread::yield();
+}
+
+// Front entry of rx, or nullptr when the ring is empty.
+static const SerialLink::Entry* front(SerialLink& l) {
+    u32 h = l.head.load(std::memory_order_relaxed);
+    if (h == l.tail_cache) {
+        l.tail_cache = l.tail.load(std::memory_order_acquire);
+        if (h == l.tail_cache)
+            return nullptr;
+    }
+    return &l.ring[h & (SerialLink::SIZE - 1)];
+}
+
+static void pop(SerialLink& l) {
+    l.head.store(l.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Whether a byte has arrived by cycle t; waits until that is decided.
+static bool rx_ready(SerialPort& p, u64 t) {
+    SerialLink& l = *p.rx;
+    for (int spins = 0;; back_off(p, spins)) {
+        // read the clock before the ring: a send it covers is then visible
+        u64 clock = l.clock.load(std::memory_order_acquire);
+        bool closed = l.closed.load(std::memory_order_acquire);
+        if (const SerialLink::Entry* e = front(l))
+            return e->arrival <= t;
+        if (closed || clock + l.latency > t)
+            return false;
+        p.publish(); // the sender may be waiting on us
+    }
+}
+
+static u8 port_in(void* ctx, u8 port) {
+    SerialPort& p = *static_cast<SerialPort*>(ctx);
+    CPU& cpu = *p.cpu;
+    if (port == u8(p.data_port + 1))
+        return TX_READY | (p.rx && rx_ready(p, cpu.cycles) ? RX_READY : 0);
+    if (port != p.data_port || !p.rx)
+        return 0;
+
+    SerialLink& l = *p.rx;
+    const SerialLink::Entry* e;
+    for (int spins = 0;; back_off(p, spins)) {
+        u64 clock = l.clock.load(std::memory_order_acquire);
+        bool closed = l.closed.load(std::memory_order_acquire);
+        if ((e = front(l)))
+            break;
+        if (closed) {
+            p.eof = true;
+            return 0xFF;
+        }
+        // nothing sent from now on arrives before clock + latency, so this
+        // CPU idles at least that long; saying so lets a peer polling our
+        // status move on
+        u64 bound = clock + l.latency;
+        if (p.tx && bound > cpu.cycles)
+            p.tx->clock.store(bound, std::memory_order_release);
+        else
+            p.publish();
+    }
+    if (e->arrival > cpu.cycles) {
+        // idle until the byte is on the wire
+        p.idle_cycles += e->arrival - cpu.cycles;
+        cpu.cycles = e->arrival;
+    }
+    u8 v = e->value;
+    pop(l);
+    p.received++;
+    return v;
+}
+
+static void port_out(void* ctx, u8 port, u8 value) {
+    SerialPort& p = *static_cast<SerialPort*>(ctx);
+    if (port != p.data_port || !p.tx)
+        return;
+
+    SerialLink& l = *p.tx;
+    u32 t = l.tail.load(std::memory_order_relaxed);
+    for (int spins = 0; t - l.head_cache >= SerialLink::SIZE; back_off(p, spins)) {
+        l.head_cache = l.head.load(std::memory_order_acquire);
+        p.publish();
+    }
+    l.ring[t & (SerialLink::SIZE - 1)] = SerialLink::Entry{p.cpu->cycles + l.latency, value};
+    l.tail.store(t + 1, std::memory_order_release);
+    p.sent++;
+}
+
+void SerialPort::attach(CPU& c, SerialLink* receive, SerialLink* transmit) {
+    cpu = &c;
+    rx = receive;
+    tx = transmit;
+    io = IOPorts{port_in, port_out, this};
+    c.io = &io;
+}
+
+void SerialPort::publish() {
+    if (tx)
+        tx->clock.store(cpu->cycles, std::memory_order_release);
+}
+
+void SerialPort::close() {
+    if (tx)
+        tx->closed.store(true, std::memory_order_release);
+}
+
+u64 run_linked(CPU& cpu, SerialPort& port, u64 max_cycles) {
+    u64 instructions = 0;
+    while (cpu.cycles < max_cycles && !port.eof) {
+        if (cpu.step() == 0)
+            break;
+        if ((++instructions & 255) == 0)
+            port.publish();
+    }
+    port.publish();
+    port.close();
+    return instructions;
+}
@@ -0,0 +1,129 @@
+#include "sim/node.h"
+
+static Pipe* link_pipe(Node& n, u8 port, bool write) {
+    int link = (port - NODE_PORT_BASE) >> 1;
+    if (port < NODE_PORT_BASE || link >= NODE_LINKS || (port & 1))
+        return nullptr; // not a data port
+    return write ? n.tx[link] : n.rx[link];
+}
+
+// Resumes n if it is suspended on the given kind of wait.
+static void wake_if(Node* n, u8 why) {
+    if (n && n->wait == why) {
+        n->wait = WAIT_NONE;
+        n->sched->wake(n->handle);
+    }
+}
+
+static u8 node_in(void* ctx, u8 port) {
+    Node& n = *static_cast<Node*>(ctx);
+    if (Pipe* p = link_pipe(n, port, false)) {
+        if (!p->can_read())
+            return 0; // only reached when the port is not connected
+        u8 v = p->buf[p->head++ % Pipe::SIZE];
+        n.received++;
+        wake_if(p->writer, WAIT_WRITE);
+        return v;
+    }
+    int link = (port - NODE_PORT_BASE) >> 1;
+    if (port < NODE_PORT_BASE || link >= NODE_LINKS)
+        return 0;
+    u8 status = 0;
+    if (n.rx[link] && n.rx[link]->can_read())
+        status |= LINK_RX_READY;
+    if (n.tx[link] && n.tx[link]->can_write())
+        status |= LINK_TX_READY;
+    return status;
+}
+
+static void node_out(void* ctx, u8 port, u8 value) {
+    Node& n = *static_cast<Node*>(ctx);
+    Pipe* p = link_pipe(n, port, true);
+    if (!p || !p->can_write())
+        return;
+    p->buf[p->tail++ % Pipe::SIZE] = value;
+    n.sent++;
+    wake_if(p->reader, WAIT_READ);
+    wake_if(p->reader, WAIT_HALT);
+}
+
+void Node::reset(Scheduler& s) {
+    mem.reset();
+    cpu.mem = &mem;
+    cpu.reset();
+    io = IOPorts{node_in, node_out, this};
+    cpu.io = &io;
+    sched = &s;
+    wait = WAIT_NONE;
+    sent = received = blocks = 0;
+    fault = false;
+}
+
+void connect(Node& a, int la, Node& b, int lb, Pipe& a_to_b, Pipe& b_to_a) {
+    a_to_b.writer = &a;
+    a_to_b.reader = &b;
+    b_to_a.writer = &b;
+    b_to_a.reader = &a;
+    a.tx[la] = &a_to_b;
+    b.rx[lb] = &a_to_b;
+    b.tx[lb] = &b_to_a;
+    a.rx[la] = &b_to_a;
+}
+
+// Suspends the machine until wake_if() sees the matching wait.
+struct LinkWait {
+    Node* n;
+    u8 why;
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        n->handle = h;
+        n->wait = why;
+        n->blocks++;
+    }
+    void await_resume() const noexcept {}
+};
+
+static bool any_rx(const Node& n) {
+    for (Pipe* p : n.rx)
+        if (p && p->can_read())
+            return true;
+    return false;
+}
+
+MachineTask run_node(Node& n, u64 max_cycles) {
+    CPU& cpu = n.cpu;
+    u64 slice_end = cpu.cycles + n.sched->quantum;
+
+    while (cpu.cycles < max_cycles) {
+        // IN/OUT on a link that cannot proceed waits before executing, so
+        // the instruction runs normally once resumed
+        u8 op = n.mem.data[cpu.pc];
+        if (op == 0xDB || op == 0xD3) {
+            bool write = op == 0xD3;
+            Pipe* p = link_pipe(n, n.mem.data[u16(cpu.pc + 1)], write);
+            if (p && !(write ? p->can_write() : p->can_read())) {
+                co_await LinkWait{&n, u8(write ? WAIT_WRITE : WAIT_READ)};
+                slice_end = cpu.cycles + n.sched->quantum;
+                continue;
+            }
+        }
+
+        if (cpu.step() == 0) {
+            n.fault = true;
+            break;
+        }
+
+        if (cpu.halted) {
+            if (!cpu.inte)
+                break; // nothing can resume it
+            if (!any_rx(n))
+                co_await LinkWait{&n, WAIT_HALT};
+            cpu.interrupt(0xFF); // RST 7
+        }
+
+        if (cpu.cycles >= slice_end) {
+            co_await n.sched->yield();
+            slice_end = cpu.cycles + n.sched->quantum;
+        }
+    }
+}
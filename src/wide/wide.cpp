@@ -0,0 +1,660 @@
+#include "wide/wide.h"
+#include "cpu/instructions.h"
+#include "cpu/opcodes.h"
+#include "util/isa.h"
+
+#define for_lanes(m, i) \
+    for (lane_mask _m = (m); _m; _m &= _m - 1) \
+        if (int i = __builtin_ctz(_m); true)
+
+void WideCPU::load(int i, const CPU& cpu) {
+    a[i] = cpu.a;
+    b[i] = cpu.b;
+    c[i] = cpu.c;
+    d[i] = cpu.d;
+    e[i] = cpu.e;
+    h[i] = cpu.h;
+    l[i] = cpu.l;
+    f[i] = cpu.flags.f;
+    inte[i] = cpu.inte;
+    halted[i] = cpu.halted;
+    sleep = cpu.halted ? sleep | 1u << i : sleep & ~(1u << i);
+    sp[i] = cpu.sp;
+    pc[i] = cpu.pc;
+    mem[i] = cpu.mem;
+    cycles[i] = cpu.cycles;
+}
+
+void WideCPU::store(int i, CPU& cpu) const {
+    cpu.a = a[i];
+    cpu.b = b[i];
+    cpu.c = c[i];
+    cpu.d = d[i];
+    cpu.e = e[i];
+    cpu.h = h[i];
+    cpu.l = l[i];
+    cpu.flags.f = f[i];
+    cpu.inte = inte[i];
+    cpu.halted = halted[i];
+    cpu.sp = sp[i];
+    cpu.pc = pc[i];
+    cpu.mem = mem[i];
+    cpu.cycles = cycles[i];
+}
+
+// Helpers that take or return lane vectors are always inlined: step() is
+// cloned per ISA, and a vector passed between a clone and an out-of-line
+// baseline function would not agree on registers vs memory.
+#define LANE_INLINE static inline __attribute__((always_inline))
+
+typedef signed char lane_s8 __attribute__((vector_size(WIDE_LANES)));
+typedef short lane_s16 __attribute__((vector_size(WIDE_LANES * 2)));
+typedef long long lane_s64 __attribute__((vector_size(WIDE_LANES * 8)));
+
+// 0xFF in every lane whose bit is set in m
+LANE_INLINE lane_u8 mask8(lane_mask m) {
+    lane_u8 bytes = {}, index, bit;
+    for (int i = 0; i < WIDE_LANES; i++) {
+        index[i] = i / 8;
+        bit[i] = 1 << (i % 8);
+    }
+    __builtin_memcpy(&bytes, &m, sizeof(m));
+    return (lane_u8)((__builtin_shuffle(bytes, index) & bit) != 0);
+}
+
+LANE_INLINE lane_u16 mask16(lane_u8 vm) {
+    return (lane_u16)__builtin_convertvector((lane_s8)vm, lane_s16);
+}
+
+LANE_INLINE lane_u64 mask64(lane_u8 vm) {
+    return (lane_u64)__builtin_convertvector((lane_s8)vm, lane_s64);
+}
+
+LANE_INLINE bool any(lane_u16 v) {
+    u64 words[sizeof(v) / 8], r = 0;
+    __builtin_memcpy(words, &v, sizeof(v));
+    for (u64 x : words)
+        r |= x;
+    return r != 0;
+}
+
+LANE_INLINE void blend(lane_u8& dst, lane_u8 v, lane_u8 m) {
+    dst = (v & m) | (dst & ~m);
+}
+
+LANE_INLINE void blend(lane_u16& dst, lane_u16 v, lane_u16 m) {
+    dst = (v & m) | (dst & ~m);
+}
+
+LANE_INLINE lane_u16 widen(lane_u8 v) {
+    return __builtin_convertvector(v, lane_u16);
+}
+
+LANE_INLINE lane_u8 narrow(lane_u16 v) {
+    return __builtin_convertvector(v, lane_u8);
+}
+
+LANE_INLINE lane_u16 pair(lane_u8 hi, lane_u8 lo) {
+    return (widen(hi) << 8) | widen(lo);
+}
+
+LANE_INLINE void split(lane_u16 v, lane_u8& hi, lane_u8& lo, lane_u8 m) {
+    blend(hi, narrow(v >> 8), m);
+    blend(lo, narrow(v), m);
+}
+
+// Z, S and P bits of the flags byte for each lane
+LANE_INLINE lane_u8 zsp(lane_u8 v) {
+    lane_u8 p = v ^ (v >> 4);
+    p ^= p >> 2;
+    p ^= p >> 1;
+    return ((lane_u8)(v == 0) & 0x40) | (v & 0x80) | ((~p & 1) << 2);
+}
+
+// true lanes (0xFF) for condition code cc of Jcc/Ccc/Rcc
+LANE_INLINE lane_u8 condition(lane_u8 f, u8 cc) {
+    static const u8 bit[8] = {0x40, 0x40, 0x01, 0x01, 0x04, 0x04, 0x80, 0x80};
+    lane_u8 set = (lane_u8)((f & bit[cc]) != 0);
+    return (cc & 1) ? set : ~set;
+}
+
+static lane_u8& reg(WideCPU& w, u8 code) {
+    switch (code) {
+    case 0:
+        return w.b;
+    case 1:
+        return w.c;
+    case 2:
+        return w.d;
+    case 3:
+        return w.e;
+    case 4:
+        return w.h;
+    case 5:
+        return w.l;
+    default:
+        return w.a; // 7; 6 (M) is handled by the callers
+    }
+}
+
+LANE_INLINE lane_u8 read8(WideCPU& w, lane_mask m, lane_u16 addr) {
+    lane_u8 v = {};
+    for_lanes(m, i) v[i] = w.mem[i]->data[addr[i]];
+    return v;
+}
+
+LANE_INLINE lane_u16 read16(WideCPU& w, lane_mask m, lane_u16 addr) {
+    lane_u16 v = {};
+    for_lanes(m, i) v[i] = w.mem[i]->data[addr[i]] | (w.mem[i]->data[u16(addr[i] + 1)] << 8);
+    return v;
+}
+
+LANE_INLINE void write8(WideCPU& w, lane_mask m, lane_u16 addr, lane_u8 v) {
+    for_lanes(m, i) {
+        w.mem[i]->write(addr[i], v[i]);
+        w.shared[addr[i] >> 8] = 0;
+    }
+}
+
+LANE_INLINE void write16(WideCPU& w, lane_mask m, lane_u16 addr, lane_u16 v) {
+    for_lanes(m, i) {
+        w.mem[i]->write(addr[i], v[i] & 0xFF);
+        w.mem[i]->write(addr[i] + 1, v[i] >> 8);
+        w.shared[addr[i] >> 8] = 0;
+        w.shared[u16(addr[i] + 1) >> 8] = 0;
+    }
+}
+
+LANE_INLINE void push(WideCPU& w, lane_mask m, lane_u16 v) {
+    for_lanes(m, i) {
+        w.mem[i]->write(--w.sp[i], v[i] >> 8);
+        w.shared[w.sp[i] >> 8] = 0;
+        w.mem[i]->write(--w.sp[i], v[i] & 0xFF);
+        w.shared[w.sp[i] >> 8] = 0;
+    }
+}
+
+LANE_INLINE lane_u16 pop(WideCPU& w, lane_mask m) {
+    lane_u16 v = {};
+    for_lanes(m, i) {
+        u8 lo = w.mem[i]->data[w.sp[i]++];
+        u8 hi = w.mem[i]->data[w.sp[i]++];
+        v[i] = (hi << 8) | lo;
+    }
+    return v;
+}
+
+// Same flag rules as add_to_a/sub_from_a/ana_a/xra_a/ora_a/cmp_a in
+// instructions.cpp; kind is the ALU field of the opcode (ADD..CMP).
+LANE_INLINE void alu(WideCPU& w, u8 kind, lane_u8 v, lane_u8 m) {
+    lane_u8 a = w.a;
+    lane_u8 cin = (kind == 1 || kind == 3) ? (w.f & 1) : (lane_u8){};
+    lane_u8 res, ac, cy = {};
+
+    switch (kind) {
+    case 0:
+    case 1: {
+        lane_u16 r = widen(a) + widen(v) + widen(cin);
+        ac = (lane_u8)(((a & 0x0F) + (v & 0x0F) + cin) > 0x0F) & 0x10;
+        cy = narrow(r >> 8) & 1;
+        res = narrow(r);
+        break;
+    }
+    case 2:
+    case 3:
+    case 7: {
+        lane_u16 r = widen(a) - widen(v) - widen(cin);
+        ac = (lane_u8)(((a & 0x0F) + (~v & 0x0F) + (cin ^ 1)) > 0x0F) & 0x10;
+        cy = narrow((lane_u16)(r > 0xFF)) & 1;
+        res = narrow(r);
+        break;
+    }
+    case 4:
+        ac = (lane_u8)(((a | v) & 0x08) != 0) & 0x10;
+        res = a & v;
+        break;
+    case 5:
+        ac = (lane_u8){};
+        res = a ^ v;
+        break;
+    default:
+        ac = (lane_u8){};
+        res = a | v;
+        break;
+    }
+
+    if (kind != 7)
+        blend(w.a, res, m);
+    blend(w.f, (w.f & 0x2A) | zsp(res) | ac | cy, m);
+}
+
+LANE_INLINE void add_cycles(WideCPU& w, lane_mask m, int n) {
+    w.cycles += mask64(mask8(m)) & (u64)n;
+}
+
+// Runs op through the scalar core one lane at a time.
+static lane_mask fallback(WideCPU& w, lane_mask m) {
+    for_lanes(m, i) {
+        CPU cpu;
+        w.store(i, cpu);
+        int n = execute_instruction(cpu);
+        w.shared[u16(cpu.sp - 1) >> 8] = 0;
+        w.shared[cpu.sp >> 8] = 0;
+        w.shared[u16(cpu.sp + 1) >> 8] = 0;
+        if (n == 0) {
+            w.live &= ~(1u << i);
+            w.fault |= 1u << i;
+            m &= ~(1u << i);
+            continue;
+        }
+        cpu.cycles += n;
+        w.load(i, cpu);
+    }
+    return m;
+}
+
+void WideCPU::share_page(u8 page) {
+    if (!live) {
+        shared[page] = 0;
+        return;
+    }
+    const u8* ref = mem[__builtin_ctz(live)]->data + page * 256;
+    shared[page] = 1;
+    for_lanes(live, i) if (__builtin_memcmp(mem[i]->data + page * 256, ref, 256) != 0) shared[page] = 0;
+}
+
+void WideCPU::share_pages() {
+    for (int page = 0; page < 256; page++)
+        share_page(page);
+}
+
+ISA_CLONES lane_mask WideCPU::step() {
+    if (!live)
+        return 0;
+
+    // Halted lanes idle for 4 cycles like CPU::step() and stay out of the
+    // group; nothing in the engine raises the interrupt that would wake them.
+    lane_mask idle = live & sleep;
+    lane_mask run = live & ~sleep;
+    if (idle) {
+        add_cycles(*this, idle, 4);
+        lane_steps += __builtin_popcount(idle);
+        if (!run) {
+            steps++;
+            return idle;
+        }
+    }
+
+    // Fast path: every running lane ended the last step on the same PC.
+    lane_mask m = 0;
+    u16 target;
+    if (group == run) {
+        target = pc[__builtin_ctz(run)];
+        m = run;
+    } else {
+        target = 0xFFFF;
+        for (int i = 0; i < WIDE_LANES; i++)
+            if ((run >> i & 1) && pc[i] < target)
+                target = pc[i];
+        for (int i = 0; i < WIDE_LANES; i++)
+            if ((run >> i & 1) && pc[i] == target)
+                m |= 1u << i;
+    }
+
+    // Opcode and operands come from one lane when the page is known to be
+    // identical everywhere; otherwise lanes holding a different opcode wait
+    // for the next step and operands are gathered per lane.
+    const u8* code = mem[__builtin_ctz(m)]->data;
+    u8 op = code[target];
+    u8 lo = code[u16(target + 1)], hi = code[u16(target + 2)];
+    bool uniform = shared[target >> 8] && shared[u16(target + 2) >> 8];
+
+    if (!uniform) {
+        if (++stale[target >> 8] == 0)
+            share_page(target >> 8);
+
+        for_lanes(m, i) if (mem[i]->data[target] != op) m &= ~(1u << i);
+        uniform = true;
+        if (opcode_table[op].bytes > 1)
+            for_lanes(m, i) if (mem[i]->data[u16(target + 1)] != lo ||
+                                (opcode_table[op].bytes == 3 && mem[i]->data[u16(target + 2)] != hi))
+                uniform = false;
+    }
+
+    steps++;
+    lane_u8 vm = mask8(m);
+    lane_u16 vm16 = mask16(vm);
+    int cyc = timing_table[op].not_taken;
+    int len = opcode_table[op].bytes;
+
+    // undocumented aliases behave exactly like the documented opcodes
+    if (op == 0xCB)
+        op = 0xC3;
+    else if (op == 0xD9)
+        op = 0xC9;
+    else if (op == 0xDD || op == 0xED || op == 0xFD)
+        op = 0xCD;
+
+    auto imm8 = [&]() __attribute__((always_inline)) { return uniform ? (lane_u8){} + lo : read8(*this, m, pc + 1); };
+    auto imm16 = [&](lane_mask lanes) __attribute__((always_inline)) {
+        return uniform ? (lane_u16){} + u16(lo | hi << 8) : read16(*this, lanes, pc + 1);
+    };
+
+    // MOV r1,r2 / MOV r,M / MOV M,r
+    if ((op & 0xC0) == 0x40 && op != 0x76) {
+        u8 dst = (op >> 3) & 7, src = op & 7;
+        lane_u8 v = src == 6 ? read8(*this, m, pair(h, l)) : reg(*this, src);
+        if (dst == 6)
+            write8(*this, m, pair(h, l), v);
+        else
+            blend(reg(*this, dst), v, vm);
+    }
+    // ALU A,r / A,M
+    else if ((op & 0xC0) == 0x80) {
+        u8 src = op & 7;
+        lane_u8 v = src == 6 ? read8(*this, m, pair(h, l)) : reg(*this, src);
+        alu(*this, (op >> 3) & 7, v, vm);
+    }
+    // ALU A,d8
+    else if ((op & 0xC7) == 0xC6) {
+        alu(*this, (op >> 3) & 7, imm8(), vm);
+    }
+    // INR r / INR M
+    else if ((op & 0xC7) == 0x04) {
+        u8 dst = (op >> 3) & 7;
+        lane_u8 v = dst == 6 ? read8(*this, m, pair(h, l)) : reg(*this, dst);
+        lane_u8 ac = (lane_u8)((v & 0x0F) == 0x0F) & 0x10;
+        v += 1;
+        if (dst == 6)
+            write8(*this, m, pair(h, l), v);
+        else
+            blend(reg(*this, dst), v, vm);
+        blend(f, (f & 0x2B) | zsp(v) | ac, vm);
+    }
+    // DCR r / DCR M
+    else if ((op & 0xC7) == 0x05) {
+        u8 dst = (op >> 3) & 7;
+        lane_u8 v = dst == 6 ? read8(*this, m, pair(h, l)) : reg(*this, dst);
+        lane_u8 ac = (lane_u8)((v & 0x0F) != 0x00) & 0x10;
+        v -= 1;
+        if (dst == 6)
+            write8(*this, m, pair(h, l), v);
+        else
+            blend(reg(*this, dst), v, vm);
+        blend(f, (f & 0x2B) | zsp(v) | ac, vm);
+    }
+    // MVI r,d8 / MVI M,d8
+    else if ((op & 0xC7) == 0x06) {
+        u8 dst = (op >> 3) & 7;
+        lane_u8 v = imm8();
+        if (dst == 6)
+            write8(*this, m, pair(h, l), v);
+        else
+            blend(reg(*this, dst), v, vm);
+    }
+    // LXI / INX / DAD / DCX on BC, DE, HL, SP
+    else if ((op & 0xC0) == 0x00 && ((op & 0x0F) == 0x01 || (op & 0x0F) == 0x03 ||
+                                     (op & 0x0F) == 0x09 || (op & 0x0F) == 0x0B)) {
+        u8 rp = (op >> 4) & 3;
+        lane_u16 v = rp == 0 ? pair(b, c) : rp == 1 ? pair(d, e) : rp == 2 ? pair(h, l) : sp;
+
+        switch (op & 0x0F) {
+        case 0x01:
+            v = imm16(m);
+            break;
+        case 0x03:
+            v += 1;
+            break;
+        case 0x0B:
+            v -= 1;
+            break;
+        case 0x09: {
+            lane_u16 hl = pair(h, l);
+            lane_u16 sum = hl + v;
+            blend(f, (f & 0xFE) | (narrow((lane_u16)(sum < hl)) & 1), vm);
+            split(sum, h, l, vm);
+            break;
+        }
+        }
+
+        if ((op & 0x0F) != 0x09) {
+            if (rp == 0)
+                split(v, b, c, vm);
+            else if (rp == 1)
+                split(v, d, e, vm);
+            else if (rp == 2)
+                split(v, h, l, vm);
+            else
+                blend(sp, v, vm16);
+        }
+    }
+    // Jcc / JMP
+    else if ((op & 0xC7) == 0xC2 || op == 0xC3) {
+        lane_u8 taken = op == 0xC3 ? vm : condition(f, (op >> 3) & 7) & vm;
+        blend(pc, imm16(m), widen(taken) * 0x0101);
+        blend(pc, pc + 3, widen(~taken & vm) * 0x0101);
+        len = 0;
+    }
+    // Ccc / CALL
+    else if ((op & 0xC7) == 0xC4 || op == 0xCD) {
+        lane_u8 taken = op == 0xCD ? vm : condition(f, (op >> 3) & 7) & vm;
+        lane_mask tm = 0;
+        for_lanes(m, i) if (taken[i]) tm |= 1u << i;
+
+        lane_u16 target16 = imm16(tm);
+        push(*this, tm, pc + 3);
+        blend(pc, target16, widen(taken) * 0x0101);
+        blend(pc, pc + 3, widen(~taken & vm) * 0x0101);
+        if (op != 0xCD)
+            add_cycles(*this, tm, timing_table[op].taken - cyc);
+        len = 0;
+    }
+    // Rcc / RET
+    else if ((op & 0xC7) == 0xC0 || op == 0xC9) {
+        lane_u8 taken = op == 0xC9 ? vm : condition(f, (op >> 3) & 7) & vm;
+        lane_mask tm = 0;
+        for_lanes(m, i) if (taken[i]) tm |= 1u << i;
+
+        lane_u16 ret = pop(*this, tm);
+        blend(pc, ret, widen(taken) * 0x0101);
+        blend(pc, pc + 1, widen(~taken & vm) * 0x0101);
+        if (op != 0xC9)
+            add_cycles(*this, tm, timing_table[op].taken - cyc);
+        len = 0;
+    }
+    // RST n
+    else if ((op & 0xC7) == 0xC7) {
+        push(*this, m, pc + 1);
+        blend(pc, (lane_u16){} + (op & 0x38), vm16);
+        len = 0;
+    }
+    // PUSH rp / POP rp
+    else if ((op & 0xCB) == 0xC1) {
+        u8 rp = (op >> 4) & 3;
+        if (op & 0x04) {
+            lane_u16 v = rp == 0 ? pair(b, c) : rp == 1 ? pair(d, e) : rp == 2 ? pair(h, l) : pair(a, f | 0x02);
+            push(*this, m, v);
+        } else {
+            lane_u16 v = pop(*this, m);
+            if (rp == 0)
+                split(v, b, c, vm);
+            else if (rp == 1)
+                split(v, d, e, vm);
+            else if (rp == 2)
+                split(v, h, l, vm);
+            else {
+                split(v, a, f, vm);
+                f = (f & ~(vm & 0x28)) | (vm & 0x02);
+            }
+        }
+    } else {
+        switch (op) {
+        case 0x00:
+        case 0x08:
+        case 0x10:
+        case 0x18:
+        case 0x20:
+        case 0x28:
+        case 0x30:
+        case 0x38: // NOP
+            break;
+
+        case 0x02: // STAX B
+            write8(*this, m, pair(b, c), a);
+            break;
+        case 0x12: // STAX D
+            write8(*this, m, pair(d, e), a);
+            break;
+        case 0x0A: // LDAX B
+            blend(a, read8(*this, m, pair(b, c)), vm);
+            break;
+        case 0x1A: // LDAX D
+            blend(a, read8(*this, m, pair(d, e)), vm);
+            break;
+
+        case 0x22: // SHLD adr
+            write16(*this, m, imm16(m), pair(h, l));
+            break;
+        case 0x2A: // LHLD adr
+            split(read16(*this, m, imm16(m)), h, l, vm);
+            break;
+        case 0x32: // STA adr
+            write8(*this, m, imm16(m), a);
+            break;
+        case 0x3A: // LDA adr
+            blend(a, read8(*this, m, imm16(m)), vm);
+            break;
+
+        case 0x07: { // RLC
+            lane_u8 msb = a >> 7;
+            blend(a, (a << 1) | msb, vm);
+            blend(f, (f & 0xFE) | msb, vm);
+            break;
+        }
+        case 0x0F: { // RRC
+            lane_u8 lsb = a & 1;
+            blend(a, (a >> 1) | (lsb << 7), vm);
+            blend(f, (f & 0xFE) | lsb, vm);
+            break;
+        }
+        case 0x17: { // RAL
+            lane_u8 msb = a >> 7;
+            blend(a, (a << 1) | (f & 1), vm);
+            blend(f, (f & 0xFE) | msb, vm);
+            break;
+        }
+        case 0x1F: { // RAR
+            lane_u8 lsb = a & 1;
+            blend(a, (a >> 1) | ((f & 1) << 7), vm);
+            blend(f, (f & 0xFE) | lsb, vm);
+            break;
+        }
+
+        case 0x2F: // CMA
+            blend(a, ~a, vm);
+            break;
+        case 0x37: // STC
+            f |= vm & 0x01;
+            break;
+        case 0x3F: // CMC
+            f ^= vm & 0x01;
+            break;
+
+        case 0xE3: // XTHL
+            for_lanes(m, i) {
+                u8 lo = mem[i]->read(sp[i]);
+                u8 hi = mem[i]->read(sp[i] + 1);
+                mem[i]->write(sp[i], l[i]);
+                mem[i]->write(sp[i] + 1, h[i]);
+                shared[sp[i] >> 8] = 0;
+                shared[u16(sp[i] + 1) >> 8] = 0;
+                l[i] = lo;
+                h[i] = hi;
+            }
+            break;
+        case 0xE9: // PCHL
+            blend(pc, pair(h, l), vm16);
+            len = 0;
+            break;
+        case 0xEB: { // XCHG
+            lane_u8 td = d, te = e;
+            blend(d, h, vm);
+            blend(e, l, vm);
+            blend(h, td, vm);
+            blend(l, te, vm);
+            break;
+        }
+        case 0xF9: // SPHL
+            blend(sp, pair(h, l), vm16);
+            break;
+
+        case 0xF3: // DI
+            inte &= ~vm;
+            break;
+        case 0xFB: // EI
+            inte |= vm & 0x01;
+            break;
+
+        default: // DAA, IN, OUT, HLT
+            m = fallback(*this, m);
+            len = 0;
+            cyc = 0;
+            break;
+        }
+    }
+
+    pc += vm16 & (u16)len;
+    add_cycles(*this, m, cyc);
+    lane_steps += __builtin_popcount(m);
+
+    // straight-line code keeps the group together; branches may split it
+    group = 0;
+    if (m && m == run) {
+        u16 next = pc[__builtin_ctz(m)];
+        group = m;
+        if (len == 0)
+            for_lanes(m, i) if (pc[i] != next) group = 0;
+    }
+    return m | idle;
+}
+
+ISA_CLONES void run_com(WideCPU& w, Console& con, u64 max_cycles) {
+    // No instruction takes more than 24 cycles, so no lane can reach the
+    // budget within `safe` more steps; until then only traps are checked.
+    u64 safe = 0;
+
+    w.share_pages();
+    while (w.live) {
+        lane_mask m = w.step();
+        lane_u16 trap = (lane_u16)(w.pc == BDOS_ENTRY) | (lane_u16)(w.pc == WARM_BOOT);
+        trap |= widen(w.halted & ~w.inte & 1);
+        if (safe) {
+            safe--;
+            if (!any(trap & mask16(mask8(m))))
+                continue;
+        }
+
+        for_lanes(m, i) {
+            if (w.pc[i] == BDOS_ENTRY) {
+                CPU cpu;
+                w.store(i, cpu);
+                if (bdos_call(cpu, con) == BDOS_EXIT) {
+                    w.live &= ~(1u << i);
+                    continue;
+                }
+                w.load(i, cpu);
+                w.group = 0;
+            }
+            if (w.pc[i] == WARM_BOOT || w.cycles[i] >= max_cycles)
+                w.live &= ~(1u << i);
+            if (w.halted[i] && !w.inte[i]) { // RUN_HALT
+                w.live &= ~(1u << i);
+                w.hang |= 1u << i;
+            }
+        }
+
+        u64 most = 0;
+        for_lanes(w.live, i) most = w.cycles[i] > most ? w.cycles[i] : most;
+        safe = most < max_cycles ? (max_cycles - most) / 24 : 0;
+    }
+}